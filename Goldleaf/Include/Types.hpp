@@ -52,6 +52,9 @@ namespace consts
     static const std::string Settings = Root + "/settings.json";
     static const std::string TempUpdatedNro = Root + "/update_tmp.nro";
     static const std::string AmiiboCache = Root + "/amiibocache";
+    static const std::string InstallJournal = Root + "/install_journal.json";
+    static const std::string InstallStats = Root + "/installstats";
+    static const std::string USBBenchmarks = Root + "/usbbenchmarks";
 }
 
 enum class ExecutableMode
@@ -44,6 +44,8 @@ namespace cfg
         SET_OPTIONAL_VALUE(u32, menu_item_size)
 
         bool ignore_required_fw_ver;
+        bool verify_content_hashes;
+        bool reuse_other_storage_contents;
         std::vector<WebBookmark> bookmarks;
 
         void Save();
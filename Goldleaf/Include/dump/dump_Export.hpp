@@ -33,7 +33,24 @@ namespace dump
         Data,
     };
 
+    enum class ExportFormat
+    {
+        NSP,
+        NSZ, // Block-compressed NCZs, installed in parallel
+        NSZSolid,
+    };
+
+    enum class CompressResult
+    {
+        Compressed,
+        // Without the titlekey (which only the console's keys can unwrap) there's no way to decrypt the NCA, so it's left as it is
+        TitlekeyCrypto,
+        Failed,
+    };
+
     void DecryptCopyNAX0ToNCA(NcmContentStorage *ncst, NcmContentId NCAId, String Path, std::function<void(double Done, double Total)> Callback);
+    // Writes an NCZ of the NCA, which NSZ exports pack instead of it. Nothing is written unless it succeeds
+    CompressResult CompressNCAToNCZ(fs::StorageRef Input, String Output, bool Solid, std::function<void(double Done, double Total)> Callback);
     bool GetMetaRecord(NcmContentMetaDatabase *metadb, u64 ApplicationId, NcmContentMetaKey *out);
     NcmStorageId GetApplicationLocation(u64 ApplicationId);
     void GenerateTicketCert(u64 ApplicationId);
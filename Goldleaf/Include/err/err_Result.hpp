@@ -60,6 +60,9 @@ namespace err
         _ERR_RC_DEFINE(Goldleaf, CouldNotBuildNSP, 7)
         _ERR_RC_DEFINE(Goldleaf, KeyGenMismatch, 8)
         _ERR_RC_DEFINE(Goldleaf, InvalidNSP, 9)
+        _ERR_RC_DEFINE(Goldleaf, ContentReadFailed, 10)
+        _ERR_RC_DEFINE(Goldleaf, ContentHashMismatch, 11)
+        _ERR_RC_DEFINE(Goldleaf, PCFeatureNotSupported, 12)
 
         #undef _ERR_RC_DEFINE
 
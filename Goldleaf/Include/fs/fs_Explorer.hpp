@@ -32,6 +32,15 @@ namespace fs
         Append,
     };
 
+    struct DirectoryEntry
+    {
+        String Name;
+        bool IsDirectory;
+        // Only filled by explorers which get them along with the listing, zero otherwise
+        u64 Size;
+        u64 ModificationTime;
+    };
+
     class Explorer
     {
         protected:
@@ -39,6 +48,8 @@ namespace fs
             String mntname;
             String ecwd;
             bool warn_write;
+            Mutex shared_lock = {};
+            String shared_path;
 
         public:
             virtual ~Explorer()
@@ -49,6 +60,7 @@ namespace fs
             bool NavigateBack();
             bool NavigateForward(String Path);
             std::vector<String> GetContents();
+            std::vector<DirectoryEntry> GetContentEntries();
             String GetMountName();
             String GetCwd();
             String GetPresentableCwd();
@@ -104,6 +116,12 @@ namespace fs
             std::vector<String> ReadFileFormatHex(String Path, u32 LineOffset, u32 LineCount);
             u64 GetDirectorySize(String Path);
 
+            // Reading from several threads (like a batch install preparing the next package while the current one is written)
+            // Calls are serialized, and the file is reopened whenever the last shared read was for a different one
+            u64 ReadFileBlockShared(String Path, u64 Offset, u64 Size, void *Out);
+            u64 GetFileSizeShared(String Path);
+            void EndFileShared();
+
             inline void SetShouldWarnOnWriteAccess(bool should_warn)
             {
                 this->warn_write = should_warn;
@@ -116,6 +134,7 @@ namespace fs
 
             virtual std::vector<String> GetDirectories(String Path) = 0;
             virtual std::vector<String> GetFiles(String Path) = 0;
+            virtual std::vector<DirectoryEntry> GetEntries(String Path);
             virtual bool Exists(String Path) = 0;
             virtual bool IsFile(String Path) = 0;
             virtual bool IsDirectory(String Path) = 0;
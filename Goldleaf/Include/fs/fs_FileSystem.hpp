@@ -26,6 +26,7 @@
 #include <fs/fs_FspExplorers.hpp>
 #include <fs/fs_DriveExplorer.hpp>
 #include <fs/fs_RemotePCExplorer.hpp>
+#include <fs/fs_Storage.hpp>
 
 namespace fs
 {
@@ -21,15 +21,48 @@
 
 #pragma once
 #include <fs/fs_Explorer.hpp>
+#include <unordered_map>
 
 namespace fs
 {
+    // Files on the PC might also be changed by other programs, so nothing is trusted for longer than this
+    static constexpr u64 RemotePCCacheLifetimeNs = 2000000000; // 2s
+
     class RemotePCExplorer final : public Explorer
     {
+        private:
+            struct StatCacheEntry
+            {
+                u32 type;
+                u64 size;
+                u64 tick;
+            };
+
+            struct ListingCacheEntry
+            {
+                std::vector<DirectoryEntry> entries;
+                u64 tick;
+            };
+
+            // Keyed by full path, filled by listings and stats and dropped by our own writes
+            std::unordered_map<std::string, StatCacheEntry> stat_cache;
+            std::unordered_map<std::string, ListingCacheEntry> listing_cache;
+            Mutex cache_lock = {};
+            // A big read right after the previous one starts streaming the file
+            String last_read_path;
+            u64 last_read_end;
+            // Payload encodings the host supports, asked for once
+            u32 compression_codecs;
+
+            bool ListDirectory(String Path, std::vector<DirectoryEntry> &Out);
+            u32 StatPath(String Path, u64 &Size);
+            void InvalidateCache(String Path);
+
         public:
             RemotePCExplorer(String MountName);
             virtual std::vector<String> GetDirectories(String Path) override;
             virtual std::vector<String> GetFiles(String Path) override;
+            virtual std::vector<DirectoryEntry> GetEntries(String Path) override;
             virtual bool Exists(String Path) override;
             virtual bool IsFile(String Path) override;
             virtual bool IsDirectory(String Path) override;
@@ -0,0 +1,110 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <fs/fs_Explorer.hpp>
+#include <memory>
+
+namespace fs
+{
+    // Random access to some data (a file, an installed content, a buffer...), so container parsers don't care where it comes from
+    class Storage
+    {
+        public:
+            virtual ~Storage() {}
+            virtual u64 Read(u64 Offset, u64 Size, void *Out) = 0;
+            virtual u64 GetSize() = 0;
+
+            // Direct access for data which is already in memory, so nested views can be parsed without copying; nullptr otherwise
+            virtual const u8 *GetBufferView(u64 Offset, u64 Size)
+            {
+                return nullptr;
+            }
+
+            // Views report the storage and offset they map to, so that views of them can point straight there
+            virtual bool GetBaseRange(std::shared_ptr<Storage> &OutBase, u64 &OutOffset)
+            {
+                return false;
+            }
+    };
+
+    using StorageRef = std::shared_ptr<Storage>;
+
+    // Files on any explorer, through its shared reads (EndFileShared must still be called on the explorer once done)
+    class FileStorage : public Storage
+    {
+        public:
+            FileStorage(Explorer *Exp, String Path);
+            virtual u64 Read(u64 Offset, u64 Size, void *Out) override;
+            virtual u64 GetSize() override;
+            Explorer *GetExplorer();
+            String GetPath();
+        private:
+            Explorer *exp;
+            String path;
+            u64 size;
+            bool has_size;
+    };
+
+    // Contents registered in a ncm content storage, which must stay open while this is used
+    class ContentStorage : public Storage
+    {
+        public:
+            ContentStorage(NcmContentStorage *Storage, NcmContentId Id);
+            virtual u64 Read(u64 Offset, u64 Size, void *Out) override;
+            virtual u64 GetSize() override;
+        private:
+            NcmContentStorage *cnt_storage;
+            NcmContentId cnt_id;
+            u64 size;
+    };
+
+    class MemoryStorage : public Storage
+    {
+        public:
+            // Keeps its own copy of the data
+            MemoryStorage(std::vector<u8> Data);
+            // Just points to the data, which must outlive this
+            MemoryStorage(const void *Data, u64 Size);
+            virtual u64 Read(u64 Offset, u64 Size, void *Out) override;
+            virtual u64 GetSize() override;
+            virtual const u8 *GetBufferView(u64 Offset, u64 Size) override;
+        private:
+            std::vector<u8> own_data;
+            const u8 *data;
+            u64 size;
+    };
+
+    // A range of another storage; views of views point straight to the innermost storage
+    class SubStorage : public Storage
+    {
+        public:
+            SubStorage(StorageRef Base, u64 Offset, u64 Size);
+            virtual u64 Read(u64 Offset, u64 Size, void *Out) override;
+            virtual u64 GetSize() override;
+            virtual const u8 *GetBufferView(u64 Offset, u64 Size) override;
+            virtual bool GetBaseRange(StorageRef &OutBase, u64 &OutOffset) override;
+        private:
+            StorageRef base;
+            u64 offset;
+            u64 size;
+    };
+}
@@ -0,0 +1,61 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <switch.h>
+#include <functional>
+
+namespace hos
+{
+    static constexpr size_t WorkerThreadStackSize = 0x20000;
+    static constexpr int WorkerThreadPriority = 0x2C;
+
+    u64 GetAvailableCoreMask();
+    u32 GetAvailableCoreCount();
+
+    // Picks a core for the Nth worker, skipping the one the caller (UI) thread is running on when possible
+    int GetWorkerCore(u32 WorkerIndex);
+
+    class WorkerThread
+    {
+        private:
+            ::Thread thread;
+            std::function<void()> fn;
+            bool created;
+            bool running;
+
+            static void ThreadEntry(void *Arg);
+
+        public:
+            WorkerThread();
+            WorkerThread(const WorkerThread&) = delete;
+            WorkerThread &operator=(const WorkerThread&) = delete;
+            ~WorkerThread();
+
+            Result Start(std::function<void()> Fn, int CpuId = -2);
+            void Join();
+
+            inline bool IsRunning()
+            {
+                return this->running;
+            }
+    };
+}
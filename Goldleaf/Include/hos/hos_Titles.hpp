@@ -206,6 +206,7 @@ namespace hos
 
     ApplicationIdMask IsValidApplicationId(u64 ApplicationId);
     TicketFile ReadTicket(String Path);
+    TicketFile ReadTicket(const u8 *Data, u64 Size);
     String GetNACPName(NacpStruct *NACP);
     String GetNACPAuthor(NacpStruct *NACP);
     String GetNACPVersion(NacpStruct *NACP);
@@ -35,6 +35,7 @@ namespace ncm
             ~ContentMeta();
             ContentMetaHeader GetContentMetaHeader();
             NcmContentMetaKey GetContentMetaKey();
+            std::vector<HashedContentRecord> GetHashedContentRecords();
             std::vector<ContentRecord> GetContentRecords();
             void GetInstallContentMeta(ByteBuffer &CNMTBuffer, ContentRecord &CNMTRecord, bool IgnoreVersion);
         private:
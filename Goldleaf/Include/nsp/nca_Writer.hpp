@@ -1,8 +1,11 @@
 #pragma once
 #include <switch.h>
 #include <hos/hos_Common.hpp>
+#include <nsp/nsp_Telemetry.hpp>
 #include <vector>
+#include <string>
 #include <memory>
+#include <functional>
 
 #define NCA_HEADER_SIZE 0x4000
 #define MAGIC_NCA3 0x3341434E /* "NCA3" */
@@ -72,18 +75,74 @@ public:
         NcaFsHeader fs_headers[4]; /* FS section headers. */
 } PACKED;
 
+/* Fixed-capacity, page-aligned byte buffer: data is appended (or produced in place at end()) and consumed from the front. */
+class NcaBuffer
+{
+public:
+        NcaBuffer(u64 capacity);
+        ~NcaBuffer();
+        NcaBuffer(const NcaBuffer&) = delete;
+        NcaBuffer& operator=(const NcaBuffer&) = delete;
+
+        u8* data() { return m_data; }
+        u8* end() { return m_data + m_size; }
+        u64 size() const { return m_size; }
+        u64 capacity() const { return m_capacity; }
+        u64 available() const { return m_capacity - m_size; }
+
+        u64 append(const u8* ptr, u64 sz);
+        void commit(u64 sz);
+        void consume(u64 sz);
+        void clear() { m_size = 0; }
+
+protected:
+        u8* m_data;
+        u64 m_capacity;
+        u64 m_size;
+};
+
+/* Buffers shared by every NcaWriter of an install, so memory stays flat no matter how many contents get written. */
+class NcaBufferPool
+{
+public:
+        NcaBufferPool();
+
+        NcaBuffer header;
+        NcaBuffer input;
+        NcaBuffer output;
+};
+
+/* Optional sink for placeholder data; when set, writers hand their output here instead of writing the placeholder themselves. */
+using NcaWriteFunction = std::function<void(u64 offset, const u8* ptr, u64 sz)>;
+
+/* Optional room in the sink's own buffers for at least minSize bytes at offset, so data can be decoded in place and then passed to
+   NcaWriteFunction without a copy. Returns NULL (the writer then uses its own buffers) if there's no room that big. */
+using NcaOutputFunction = std::function<u8*(u64 offset, u64 minSize, u64& size)>;
+
+/* Random access to the source content, only needed to resume partially written placeholders. */
+using NcaReadFunction = std::function<u64(u64 offset, u64 sz, u8* ptr)>;
+
 class NcaBodyWriter
 {
 public:
-        NcaBodyWriter(const NcmPlaceHolderId& placeHoldId, u64 offset, NcmContentStorage* contentStorage);
+        NcaBodyWriter(const NcmPlaceHolderId& placeHoldId, u64 offset, NcmContentStorage* contentStorage, const NcaWriteFunction& writeFunc, NcaBufferPool& pool);
         virtual ~NcaBodyWriter();
         virtual u64 write(const  u8* ptr, u64 sz);
+        virtual bool close();
         
         bool isOpen() const;
+        void setTelemetry(nsp::InstallTelemetry* telemetry);
+        void setOutput(const NcaOutputFunction& outputFunc);
 
 protected:
+        void writePlaceHolder(u64 offset, const void* ptr, u64 sz);
+
         NcmContentStorage* m_contentStorage;
         NcmPlaceHolderId m_placeHoldId;
+        NcaWriteFunction m_writeFunc;
+        NcaOutputFunction m_outputFunc;
+        NcaBufferPool& m_pool;
+        nsp::InstallTelemetry* m_telemetry;
 
         u64 m_offset;
 };
@@ -91,17 +150,95 @@ protected:
 class NcaWriter
 {
 public:
-        NcaWriter(const NcmContentId& contentId, NcmPlaceHolderId& placeHoldId, NcmContentStorage* contentStorage);
+        NcaWriter(const NcmContentId& contentId, NcmPlaceHolderId& placeHoldId, NcmContentStorage* contentStorage, const NcaWriteFunction& writeFunc = NcaWriteFunction(), NcaBufferPool* pool = NULL);
         virtual ~NcaWriter();
 
         bool isOpen() const;
         bool close();
         u64 write(const  u8* ptr, u64 sz);
+        u64 resume(u64 writtenSize, const NcaReadFunction& read);
+
+        /* Optional, gets the time spent re-encrypting NCZ data. */
+        void setTelemetry(nsp::InstallTelemetry* telemetry);
+        /* Optional, only used along with a write function. */
+        void setOutput(const NcaOutputFunction& outputFunc);
 
 protected:
+        void setWriter(const std::shared_ptr<NcaBodyWriter>& writer);
+
         NcmContentId m_contentId;
         NcmPlaceHolderId m_placeHoldId;
         NcmContentStorage* m_contentStorage;
-        std::vector<u8> m_buffer;
+        NcaWriteFunction m_writeFunc;
+        NcaOutputFunction m_outputFunc;
+        std::unique_ptr<NcaBufferPool> m_ownPool;
+        NcaBufferPool* m_pool;
+        NcaBuffer& m_buffer;
         std::shared_ptr<NcaBodyWriter> m_writer;
+        nsp::InstallTelemetry* m_telemetry;
+};
+
+/* Reads the files of an NCA's PFS0/RomFS sections straight from the source, without installing or staging it anywhere.
+   Only standard crypto is supported: titlekey-encrypted NCAs just report their rights ID and no files. */
+class NcaReader
+{
+public:
+        NcaReader(const NcaReadFunction& read);
+
+        bool isOk() const;
+        bool hasRightsId() const;
+        u8 keyGeneration() const;
+
+        std::vector<std::string> files() const;
+        u64 fileSize(const std::string& name) const;
+        bool readFile(const std::string& name, std::vector<u8>& out, u64 maxSize = UINT64_MAX);
+
+protected:
+        struct Section
+        {
+                u64 offset;
+                u64 size;
+                u8 cryptType;
+                u64 ctr;
+        };
+
+        struct File
+        {
+                std::string name;
+                u32 section;
+                u64 offset; /* Absolute, within the NCA. */
+                u64 size;
+        };
+
+        u64 read(const Section& section, u64 offset, u64 sz, u8* ptr);
+        void parsePfs0(u32 index, u64 offset);
+        void parseRomfs(u32 index, u64 offset);
+
+        NcaReadFunction m_read;
+        NcaHeader m_header;
+        u8 m_key[0x10];
+        bool m_ok;
+        std::vector<Section> m_sections;
+        std::vector<File> m_files;
+};
+
+/* Turns a standard crypto NCA back into the NCZ format NczBodyWriter installs: the header is kept as it is, CTR sections are decrypted
+   and everything past the header is zstd compressed, either as one solid stream or as independent blocks compressed on every core. */
+class NczCompressor : public NcaReader
+{
+public:
+        NczCompressor(const NcaReadFunction& read, u64 ncaSize, const NcaWriteFunction& write, bool solid);
+
+        /* The progress callback is always called from the calling thread. */
+        bool compress(const std::function<void(u64 done, u64 total)>& progress);
+
+protected:
+        u64 readDecrypted(u64 offset, u64 sz, u8* ptr);
+        u64 writeSectionHeader();
+        void compressSolid(u64 offset, const std::function<void(u64 done, u64 total)>& progress);
+        void compressBlocks(u64 offset, const std::function<void(u64 done, u64 total)>& progress);
+
+        u64 m_ncaSize;
+        NcaWriteFunction m_write;
+        bool m_solid;
 };
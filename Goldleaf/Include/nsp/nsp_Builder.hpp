@@ -23,8 +23,17 @@
 #include <string>
 #include <functional>
 #include <nsp/nsp_Types.hpp>
+#include <fs/fs_Storage.hpp>
 
 namespace nsp
 {
+    struct BuildEntry
+    {
+        String Name;
+        fs::StorageRef Source;
+    };
+
+    // Writes the PFS0 header and then streams every entry straight from its source, nothing gets staged
+    bool Build(std::vector<BuildEntry> Entries, String Out, std::function<void(u64, u64)> Callback);
     bool GenerateFrom(String Input, String Out, std::function<void(u64, u64)> Callback);
 }
\ No newline at end of file
@@ -26,6 +26,9 @@
 #include <memory>
 #include <Types.hpp>
 #include <nsp/nsp_PFS0.hpp>
+#include <nsp/nsp_XCI.hpp>
+#include <nsp/nsp_Journal.hpp>
+#include <nsp/nsp_Telemetry.hpp>
 #include <ncm/ncm_ContentMeta.hpp>
 #include <es/es_Service.hpp>
 #include <ns/ns_Service.hpp>
@@ -37,6 +40,9 @@ namespace nsp
 {
     using OnContentsWriteFunction = std::function<void(ncm::ContentRecord, u32, u32, double, double, u64)>;
 
+    // Meta NCAs are a few KB, ones up to this size are read whole instead of once per header/table the NCA reader goes through
+    static constexpr u64 MaxBufferedMetaSize = 0x100000; // 1MB
+
     class Installer
     {
         private:
@@ -49,15 +55,27 @@ namespace nsp
             ByteBuffer cnmt_buf;
             NcmContentMetaKey cnt_meta_key;
             NcmContentStorage cnt_storage;
+            NcmContentStorage other_cnt_storage;
+            bool has_other_cnt_storage;
             NcmContentMetaDatabase cnt_meta_db;
             u64 base_app_id;
             u64 tik_file_size;
-            String tik_file_name;
             std::vector<ncm::ContentRecord> ncas;
+            std::vector<ncm::HashedContentRecord> nca_hashes;
             String icon;
+            std::vector<u8> tik_data;
+            InstallJournal journal;
+            InstallTelemetry telemetry;
+            bool resuming;
+            u64 skipped_size;
+
+            Result DoWriteContents(OnContentsWriteFunction OnContentWrite);
+            const u8 *FindContentHash(NcmContentId Id);
+            bool IsInstalledContentValid(NcmContentStorage *Storage, NcmContentId Id);
 
         public:
-            Installer(String Path, fs::Explorer *Exp, Storage Location) : pfs0_file(Exp, Path), storage_id(static_cast<NcmStorageId>(Location)) {}
+            // Gamecard images get their secure partition installed, which is laid out just like an NSP
+            Installer(String Path, fs::Explorer *Exp, Storage Location) : pfs0_file(Exp, Path, IsGamecardImage(Path) ? LocateSecurePartition(Exp, Path) : 0), storage_id(static_cast<NcmStorageId>(Location)), has_other_cnt_storage(false), resuming(false), skipped_size(0) {}
             ~Installer();
     
             Result PrepareInstallation();
@@ -69,7 +87,11 @@ namespace nsp
             bool HasTicket();
             hos::TicketFile GetTicketFile();
             u8 GetKeyGeneration();
+            bool IsResuming();
             std::vector<ncm::ContentRecord> GetNCAs();
+            InstallTelemetry *GetTelemetry();
+            // Package bytes not written because those contents were already installed
+            u64 GetSkippedSize();
             Result WriteContents(OnContentsWriteFunction OnContentWrite);
             void FinalizeInstallation();
         
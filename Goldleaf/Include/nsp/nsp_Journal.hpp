@@ -0,0 +1,67 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+#pragma once
+#include <vector>
+#include <Types.hpp>
+
+namespace nsp
+{
+    // Placeholder data is checkpointed every time this much more has been written
+    static constexpr u64 JournalCheckpointSize = 0x2000000; // 32MB
+
+    struct JournalContent
+    {
+        NcmContentId ContentId;
+        NcmPlaceHolderId PlaceHolderId;
+        u64 WrittenSize;
+        bool Registered;
+    };
+
+    // Small record on the SD card of how far the last install got, so that an interrupted install of the same package can be resumed
+    class InstallJournal
+    {
+        private:
+            std::string package_path;
+            u64 package_size;
+            NcmContentMetaKey meta_key;
+            NcmStorageId storage_id;
+            std::vector<JournalContent> contents;
+
+        public:
+            InstallJournal();
+
+            bool Load();
+            void Save();
+            void Delete();
+
+            inline String GetPackagePath()
+            {
+                return this->package_path;
+            }
+
+            bool Matches(String PackagePath, u64 PackageSize, NcmContentMetaKey MetaKey, NcmStorageId StorageId);
+            void Begin(String PackagePath, u64 PackageSize, NcmContentMetaKey MetaKey, NcmStorageId StorageId);
+
+            JournalContent *Find(NcmContentId ContentId);
+            void Update(NcmContentId ContentId, NcmPlaceHolderId PlaceHolderId, u64 WrittenSize);
+            void MarkRegistered(NcmContentId ContentId);
+    };
+}
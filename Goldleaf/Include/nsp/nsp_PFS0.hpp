@@ -22,6 +22,7 @@
 #pragma once
 #include <fs/fs_FileSystem.hpp>
 #include <nsp/nsp_Types.hpp>
+#include <unordered_map>
 
 namespace nsp
 {
@@ -29,6 +30,8 @@ namespace nsp
     {
         public:
             static constexpr u32 InvalidFileIndex = UINT32_MAX;
+            // Entry and string tables are read at once, anything bigger than this can only be a corrupted header
+            static constexpr u64 MaxHeaderSize = 0x400000;
 
             NX_CONSTEXPR bool IsValidFileIndex(u32 idx)
             {
@@ -37,10 +40,12 @@ namespace nsp
             
             NX_CONSTEXPR bool IsInvalidFileIndex(u32 idx)
             {
-                return !IsValidFileIndex;
+                return !IsValidFileIndex(idx);
             }
 
-            PFS0(fs::Explorer *Exp, String Path);
+            PFS0(fs::Explorer *Exp, String Path, u64 Offset = 0);
+            // Nested containers (a partition of a gamecard image, a PFS0 inside an NCA...) are just views of their parent's storage
+            PFS0(fs::StorageRef Storage, u64 Offset = 0);
             ~PFS0();
             u32 GetCount();
             String GetFile(u32 Index);
@@ -50,15 +55,23 @@ namespace nsp
             bool IsOk();
             fs::Explorer *GetExplorer();
             u64 GetFileSize(u32 Index);
+            u64 GetFileOffset(u32 Index);
+            fs::StorageRef GetStorage();
+            fs::StorageRef GetFileStorage(u32 Index);
             void SaveFile(u32 Index, fs::Explorer *Exp, String Path);
             u32 GetFileIndexByName(String File);
         private:
             String path;
             fs::Explorer *gexp;
-            u8 *stringtable;
-            u32 headersize;
+            fs::StorageRef storage;
+            u64 headersize;
             PFS0Header header;
             std::vector<PFS0File> files;
+            // Lowercase name -> index, names are matched case-insensitively
+            std::unordered_map<std::string, u32> name_index;
             bool ok;
+
+            void Parse(u64 Offset);
+            static std::string NormalizeName(const std::string &Name);
     };
 }
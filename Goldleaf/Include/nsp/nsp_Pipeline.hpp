@@ -0,0 +1,154 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <switch.h>
+#include <functional>
+#include <hos/hos_Threads.hpp>
+#include <nsp/nsp_Telemetry.hpp>
+
+namespace nsp
+{
+    static constexpr size_t PipelineBlockSize = 0x400000; // 4MB
+    static constexpr size_t PipelineBlockCount = 4;
+    static constexpr size_t PipelineBlockAlignment = 0x1000;
+    static constexpr size_t PipelineMaxConsumers = 2;
+
+    struct PipelineBlock
+    {
+        u8 *Data;
+        u64 Size;
+        u64 Offset;
+    };
+
+    // Bounded ring of pre-allocated, page-aligned blocks with a single producer and one or more consumers
+    // Every consumer sees every block, and a block is only reused once all of them released it
+    class BlockRing
+    {
+        private:
+            Mutex lock;
+            CondVar cv;
+            u8 *block_data;
+            PipelineBlock *blocks;
+            size_t block_count;
+            size_t block_size;
+            size_t consumer_count;
+            u64 written_count;
+            u64 read_count[PipelineMaxConsumers];
+            bool finished;
+            bool aborted;
+
+            u64 GetSlowestReadCount();
+
+        public:
+            BlockRing(size_t Count, size_t BlockSize);
+            BlockRing(const BlockRing&) = delete;
+            BlockRing &operator=(const BlockRing&) = delete;
+            ~BlockRing();
+
+            void Reset(size_t Consumers = 1);
+
+            // Producer side: wait for an empty block, fill it and commit it
+            PipelineBlock *AcquireWrite();
+            void CommitWrite();
+            void Finish();
+
+            // Consumer side: wait for a filled block, consume it and release it (nullptr once finished and drained)
+            PipelineBlock *AcquireRead(size_t Consumer = 0);
+            void CommitRead(size_t Consumer = 0);
+
+            // Wakes every waiter up, making both sides return nullptr
+            void Abort();
+            bool IsAborted();
+
+            inline size_t GetBlockSize()
+            {
+                return this->block_size;
+            }
+    };
+
+    using PipelineReadFunction = std::function<u64(u64 Offset, u64 Size, u8 *Out)>;
+
+    // Install pipeline for a single content: a reader thread fills the input ring from the source,
+    // the caller decodes/re-encrypts input blocks and pushes the output here, and a writer thread
+    // drains the output ring into the placeholder
+    // Optionally, a hasher thread reads the output ring alongside the writer and checks the content's SHA-256
+    // Both rings have the same block size, since whole input blocks are moved to the output ring by swapping their memory
+    class ContentPipeline
+    {
+        private:
+            BlockRing input_ring;
+            BlockRing output_ring;
+            hos::WorkerThread reader_thread;
+            hos::WorkerThread writer_thread;
+            hos::WorkerThread hasher_thread;
+            NcmContentStorage *cnt_storage;
+            InstallTelemetry *telemetry;
+            NcmPlaceHolderId placehld_id;
+            PipelineReadFunction read_fn;
+            u64 content_offset;
+            u64 content_size;
+            u64 written_size;
+            PipelineBlock *cur_input;
+            PipelineBlock *cur_output;
+            bool verify_hash;
+            u8 expected_hash[SHA256_HASH_SIZE];
+            u8 hash[SHA256_HASH_SIZE];
+            Mutex rc_lock;
+            Result rc;
+
+            void SetResult(Result Res);
+            void ReaderMain();
+            void WriterMain();
+            void HasherMain();
+            void FlushOutput();
+            bool NextOutput(u64 Offset);
+            void AddBusy(InstallStage Stage, u64 Bytes, u64 StartTick);
+            void AddStall(InstallStage Stage, u64 StartTick);
+
+        public:
+            // Telemetry gets the read/write/hash stages, plus the time the caller (decompress stage) waits on them
+            ContentPipeline(NcmContentStorage *Storage, InstallTelemetry *Telemetry = nullptr);
+            ~ContentPipeline();
+
+            // The source is read from Offset up to Size
+            // When ExpectedHash is set, Finish() fails with ResultContentHashMismatch unless the written data matches it
+            Result Start(NcmPlaceHolderId PlaceHolderId, u64 Offset, u64 Size, PipelineReadFunction Read, const u8 *ExpectedHash = nullptr);
+
+            PipelineBlock *ReadBlock();
+            void ReleaseBlock();
+
+            // Used as the sink of NcaWriter, copying (and coalescing) decoded data into the output ring
+            // The current input block passed as a whole (plain NCAs) and data produced in AcquireOutput()'s room aren't copied at all
+            void Write(u64 Offset, const u8 *Data, u64 Size);
+
+            // Room in the output ring for at least MinSize bytes at Offset, so that writers can decode in place before passing it to Write()
+            // Returns nullptr if the pipeline was aborted, or if MinSize is more than a block can hold
+            u8 *AcquireOutput(u64 Offset, u64 MinSize, u64 &Size);
+
+            void Abort(Result Res);
+            Result Finish();
+            Result GetResult();
+
+            // End of the data written to the placeholder so far (writes are always sequential)
+            u64 GetWrittenSize();
+    };
+}
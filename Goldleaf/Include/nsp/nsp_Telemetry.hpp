@@ -0,0 +1,97 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <switch.h>
+#include <string>
+
+namespace nsp
+{
+    enum class InstallStage : u32
+    {
+        Read,
+        Decompress,
+        Encrypt,
+        Write,
+        Hash,
+
+        Count
+    };
+
+    // Throughput is computed over the last ~2 seconds of samples, so it neither jumps with every block nor lags behind for the whole install
+    static constexpr u64 TelemetrySampleIntervalNs = 100000000; // 100ms
+    static constexpr size_t TelemetrySampleCount = 20;
+
+    struct StageStats
+    {
+        u64 Bytes;
+        u64 BusyNs;
+        u64 StallNs;
+        double BytesPerSec;
+    };
+
+    // Per-stage counters of an install: how much data went through each stage, how long it spent working and how long it waited on the others
+    // Busy time of a stage never includes time spent in another one (like encryption done within decompression), so stages can be compared directly
+    class InstallTelemetry
+    {
+        private:
+            struct StageSample
+            {
+                u64 Tick;
+                u64 Bytes;
+            };
+
+            struct StageCounters
+            {
+                u64 bytes;
+                u64 busy_ticks;
+                u64 stall_ticks;
+                StageSample samples[TelemetrySampleCount];
+                size_t sample_count;
+                size_t sample_idx;
+            };
+
+            Mutex lock;
+            StageCounters stages[static_cast<u32>(InstallStage::Count)];
+            u64 start_tick;
+            u64 end_tick;
+
+            void AddSample(StageCounters &Counters, u64 Tick);
+
+        public:
+            InstallTelemetry();
+
+            void Start();
+            void Stop();
+
+            void AddBusy(InstallStage Stage, u64 Bytes, u64 Ticks);
+            void AddStall(InstallStage Stage, u64 Ticks);
+            u64 GetBusyTicks(InstallStage Stage);
+            u64 GetStallTicks(InstallStage Stage);
+
+            StageStats GetStats(InstallStage Stage);
+            u64 GetElapsedNs();
+
+            void SaveSummary(std::string Path, u64 ApplicationId, Result Res);
+    };
+
+    const char *GetInstallStageName(InstallStage Stage);
+}
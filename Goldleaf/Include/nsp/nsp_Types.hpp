@@ -40,6 +40,17 @@ namespace nsp
         u32 Pad;
     } PACKED;
 
+    // Gamecard (HFS0) entries are the PFS0 ones plus a hash of the start of the file, both formats are parsed by PFS0
+    struct HFS0FileEntry
+    {
+        u64 Offset;
+        u64 Size;
+        u32 StringTableOffset;
+        u32 HashedSize;
+        u64 Reserved;
+        u8 Hash[0x20];
+    } PACKED;
+
     struct PFS0File
     {
         PFS0FileEntry Entry;
@@ -47,4 +58,5 @@ namespace nsp
     };
 
     static constexpr u32 Magic = 0x30534650;
+    static constexpr u32 HFS0Magic = 0x30534648;
 }
\ No newline at end of file
@@ -0,0 +1,38 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <fs/fs_FileSystem.hpp>
+
+namespace nsp
+{
+    // Gamecard images (XCI, or XCZ with compressed NCZs) start with a header pointing to the root HFS0
+    // The root holds the update/normal/secure/logo partitions (HFS0s as well), the installable contents live in the secure one
+    static constexpr u32 XCIHeaderMagic = 0x44414548; // "HEAD"
+    static constexpr u64 XCIHeaderMagicOffset = 0x100;
+    static constexpr u64 XCIRootPartitionOffsetOffset = 0x130;
+
+    // Some dumps keep the gamecard key area in front of the header
+    static constexpr u64 XCIKeyAreaSize = 0x1000;
+
+    bool IsGamecardImage(String Path);
+    u64 LocateSecurePartition(fs::Explorer *Exp, String Path);
+}
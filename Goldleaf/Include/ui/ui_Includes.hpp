@@ -36,4 +36,5 @@
 #include <nsp/nsp_Builder.hpp>
 #include <cfg/cfg_Strings.hpp>
 #include <ui/ui_Utils.hpp>
-#include <usb/usb_Commands.hpp>
\ No newline at end of file
+#include <usb/usb_Commands.hpp>
+#include <usb/usb_Benchmark.hpp>
\ No newline at end of file
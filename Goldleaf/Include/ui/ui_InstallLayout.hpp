@@ -32,8 +32,14 @@ namespace ui
             PU_SMART_CTOR(InstallLayout)
 
             void StartInstall(String Path, fs::Explorer *Exp, Storage Location, bool OmitConfirmation = false);
+            void StartInstallBatch(std::vector<String> Paths, fs::Explorer *Exp, Storage Location, bool OmitConfirmation = false);
         private:
+            bool ConfirmInstall(nsp::Installer &Inst, Result PrepareResult, bool OmitConfirmation);
+
             pu::ui::elm::TextBlock::Ref installText;
             pu::ui::elm::ProgressBar::Ref installBar;
+            pu::ui::elm::TextBlock::Ref statsText;
+
+            String FormatTelemetry(nsp::InstallTelemetry *Telemetry);
     };
 }
\ No newline at end of file
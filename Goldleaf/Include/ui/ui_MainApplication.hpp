@@ -36,6 +36,7 @@
 #include <ui/ui_SettingsLayout.hpp>
 #include <ui/ui_StorageContentsLayout.hpp>
 #include <ui/ui_UnusedTicketsLayout.hpp>
+#include <ui/ui_USBBenchmarkLayout.hpp>
 #include <ui/ui_TitleDumperLayout.hpp>
 #include <ui/ui_UpdateLayout.hpp>
 #include <ui/ui_UpdateInstallLayout.hpp>
@@ -62,6 +63,7 @@ namespace ui
             void browser_Input(u64 down, u64 up, u64 held);
             void exploreMenu_Input(u64 down, u64 up, u64 held);
             void pcExplore_Input(u64 down, u64 up, u64 held);
+            void usbBenchmark_Input(u64 down, u64 up, u64 held);
             void fileContent_Input(u64 down, u64 up, u64 held);
             void contentInformation_Input(u64 down, u64 up, u64 held);
             void storageContents_Input(u64 down, u64 up, u64 held);
@@ -83,6 +85,7 @@ namespace ui
             CopyLayout::Ref &GetCopyLayout();
             ExploreMenuLayout::Ref &GetExploreMenuLayout();
             PCExploreLayout::Ref &GetPCExploreLayout();
+            USBBenchmarkLayout::Ref &GetUSBBenchmarkLayout();
             InstallLayout::Ref &GetInstallLayout();
             ContentInformationLayout::Ref &GetContentInformationLayout();
             StorageContentsLayout::Ref &GetStorageContentsLayout();
@@ -112,6 +115,7 @@ namespace ui
             CopyLayout::Ref copy;
             ExploreMenuLayout::Ref exploreMenu;
             PCExploreLayout::Ref pcExplore;
+            USBBenchmarkLayout::Ref usbBenchmark;
             InstallLayout::Ref nspInstall;
             ContentInformationLayout::Ref contentInformation;
             StorageContentsLayout::Ref storageContents;
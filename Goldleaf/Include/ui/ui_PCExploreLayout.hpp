@@ -34,6 +34,7 @@ namespace ui
             void UpdatePaths();
             void path_Click();
             void fileSelect_Click();
+            void benchmark_Click();
         private:
             std::vector<String> names;
             std::vector<String> paths;
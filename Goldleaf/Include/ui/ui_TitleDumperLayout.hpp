@@ -31,7 +31,7 @@ namespace ui
             TitleDumperLayout();
             PU_SMART_CTOR(TitleDumperLayout)
 
-            void StartDump(hos::Title &Target, bool HasTicket);
+            void StartDump(hos::Title &Target, bool HasTicket, dump::ExportFormat Format = dump::ExportFormat::NSP);
         private:
             pu::ui::elm::TextBlock::Ref dumpText;
             pu::ui::elm::ProgressBar::Ref ncaBar;
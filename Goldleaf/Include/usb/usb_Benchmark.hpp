@@ -0,0 +1,86 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include <usb/usb_Commands.hpp>
+
+namespace usb
+{
+    // Transfer sizes go from 4KB to 16MB, 4x bigger each time
+    static constexpr u64 BenchmarkMinTransferSize = 0x1000;
+    static constexpr u64 BenchmarkMaxTransferSize = 0x1000000;
+    // Every run moves at least this much, so that small transfers are averaged over thousands of them
+    static constexpr u64 BenchmarkRunSize = 0x2000000; // 32MB
+    static constexpr u32 BenchmarkLatencySamples = 500;
+    // Latencies are also counted in 50us buckets, anything slower than the last one goes into it
+    static constexpr u64 BenchmarkHistogramBucketNs = 50000;
+    static constexpr size_t BenchmarkHistogramBuckets = 40;
+    // Sizes at which every queue depth (1, 2, 4...) is compared, below and at the transfer chunk size
+    static constexpr u64 BenchmarkQueueDepthSizes[] = { 0x10000, 0x100000 };
+
+    enum class BenchmarkDirection : u32
+    {
+        ConsoleToPC, // Quark sinks what Goldleaf sends
+        PCToConsole // Quark sources what Goldleaf receives
+    };
+
+    struct LatencyStats
+    {
+        u32 Samples;
+        u64 MinNs;
+        u64 P50Ns;
+        u64 P99Ns;
+        u64 MaxNs;
+        u32 Histogram[BenchmarkHistogramBuckets];
+    };
+
+    struct ThroughputRun
+    {
+        BenchmarkDirection Direction;
+        u64 TransferSize;
+        u32 QueueDepth;
+        u64 Bytes;
+        u64 Ns;
+
+        double GetBytesPerSec() const
+        {
+            return (this->Ns > 0) ? ((double)this->Bytes * 1000000000.0 / (double)this->Ns) : 0;
+        }
+    };
+
+    struct BenchmarkResults
+    {
+        HostInfo Host;
+        LatencyStats Latency;
+        std::vector<ThroughputRun> SizeSweep;
+        std::vector<ThroughputRun> DepthSweep;
+    };
+
+    // Measures the link itself through the transfer layer: Quark only echoes commands and sinks or sources raw data, nothing is read or written on either end
+    // Done and Total count measurements (the latency one and each throughput run)
+    Result RunBenchmark(BenchmarkResults &Out, std::function<void(u32 Done, u32 Total)> Callback);
+    void SaveBenchmarkResults(BenchmarkResults &Results, std::string Path);
+
+    const char *GetBenchmarkDirectionName(BenchmarkDirection Direction);
+}
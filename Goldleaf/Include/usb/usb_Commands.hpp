@@ -20,6 +20,7 @@
 */
 
 #pragma once
+#include <vector>
 #include <Types.hpp>
 #include <usb/usb_Detail.hpp>
 
@@ -43,30 +44,94 @@ namespace usb
         Rename,
         GetSpecialPathCount,
         GetSpecialPath,
-        SelectFile
+        SelectFile,
+        ListDirectory,
+        StreamFile,
+        StreamCredit,
+        StreamCancel,
+        Hello,
+        Echo,
+        Sink,
+        Source
     };
 
+    // Revision of the command set, exchanged with Hello (hosts which don't know Hello are revision 1)
+    static constexpr u32 ProtocolVersion = 2;
+    // Largest payload Goldleaf sends or receives in a single transfer
+    static constexpr u32 MaxPayloadSize = 0x1000000; // 16MB
+    static constexpr u64 PreferredTransferSize = 0x400000; // 4MB
+
+    // Optional parts of the protocol, only used when both ends support them
+    static constexpr u32 FeatureBulkListing = BIT(0); // ListDirectory
+    static constexpr u32 FeatureStreaming = BIT(1); // StreamFile, StreamCredit, StreamCancel
+    static constexpr u32 FeatureCompression = BIT(2); // zstd payloads
+    static constexpr u32 FeatureHandles = BIT(3); // Reserved for handle-based file access, not used yet
+    static constexpr u32 FeatureControlInterface = BIT(4); // Commands without payloads go through the second interface
+    static constexpr u32 FeatureBenchmark = BIT(5); // Echo, Sink, Source
+    static constexpr u32 SupportedFeatures = FeatureBulkListing | FeatureStreaming | FeatureCompression | FeatureControlInterface | FeatureBenchmark;
+
+    struct HostInfo
+    {
+        u32 protocol_version;
+        u32 max_payload_size;
+        u32 features;
+        u64 preferred_transfer_size;
+    };
+
+    // How a file payload is sent, compressed ones are preceded by their size on the wire
+    enum class PayloadEncoding : u32
+    {
+        Raw,
+        Zstd
+    };
+
+    // Encodings accepted in a request, a host with FeatureCompression supports all of them
+    static constexpr u32 CompressionZstd = BIT(0);
+    static constexpr int PayloadCompressionLevel = 1;
+    // The start of a payload is tried first, so that data which won't compress (like encrypted NCAs) is sent raw right away
+    static constexpr size_t PayloadCompressionProbeSize = 0x10000;
+
     static constexpr u32 InputMagic = 0x49434C47; // GLCI
     static constexpr u32 OutputMagic = 0x4F434C47; // GLCO
 
     static constexpr size_t BlockSize = 0x1000;
 
+    // Blocks the PC may push ahead of the ones already received, each one dropped if the stream is cancelled
+    // A credit goes back for every received block, so the window never drains while the stream goes on
+    static constexpr u32 StreamCredits = 2;
+    // Smaller reads aren't worth streaming
+    static constexpr u64 StreamMinBlockSize = 0x100000;
+
+    // Hosts from before Hello don't answer commands they don't know, so its response isn't waited for forever
+    static constexpr u64 HelloResponseTimeout = 2'000'000'000; // 2s
+
+    inline constexpr u64 GetResponseTimeout(CommandId Id)
+    {
+        return (Id == CommandId::Hello) ? HelloResponseTimeout : UINT64_MAX;
+    }
+
     struct BlockBase
     {
         u64 position;
         u8 *blockbuf;
+        size_t bufsize;
+        u32 interface;
     };
 
     struct InCommandBlock
     {
         BlockBase base;
+        u32 urb_id;
 
-        InCommandBlock(CommandId CmdId);
+        InCommandBlock(CommandId CmdId, u32 Interface = detail::DataInterface);
         void Write32(u32 Value);
         void Write64(u64 Value);
         void WriteString(String Value);
         void WriteBuffer(void *Buf, size_t Size);
         Result Send();
+        // Like Send, but without waiting for the host to read the block. Nothing else may be sent through the interface until it's reaped
+        Result Post();
+        Result Reap();
     };
 
     struct OutCommandBlock
@@ -75,7 +140,7 @@ namespace usb
         u32 magic;
         Result res;
 
-        OutCommandBlock();
+        OutCommandBlock(u32 Interface = detail::DataInterface, u64 Timeout = UINT64_MAX);
         void Cleanup();
         bool IsValid();
         u32 Read32();
@@ -165,6 +230,32 @@ namespace usb
             String &val;
     };
 
+    // Aligned buffers for command blocks and payload copies are reused instead of allocated for every transfer.
+    // Size is rounded up to what the returned buffer can actually hold, which must be passed back on release
+    u8 *AcquireTransferBuffer(size_t &Size);
+    void ReleaseTransferBuffer(u8 *Buf, size_t Size);
+
+    inline bool IsTransferAligned(void *Buf)
+    {
+        return (reinterpret_cast<uintptr_t>(Buf) & (BlockSize - 1)) == 0;
+    }
+
+    // Ring of aligned slots used to stream an unaligned buffer through a transfer queue
+    struct BounceBuffer
+    {
+        u8 *buf;
+        size_t buf_size;
+        size_t slot_size;
+        size_t aligned_slot_size;
+        size_t slot_count;
+
+        BounceBuffer(size_t Size);
+        BounceBuffer(const BounceBuffer&) = delete;
+        BounceBuffer &operator=(const BounceBuffer&) = delete;
+        ~BounceBuffer();
+        u8 *GetSlot(size_t Offset);
+    };
+
     class InBuffer : public CommandArgument
     {
         public:
@@ -176,6 +267,7 @@ namespace usb
         private:
             void *buf;
             size_t sz;
+            u32 interface;
     };
 
     class OutBuffer : public CommandArgument
@@ -189,23 +281,101 @@ namespace usb
         private:
             void *buf;
             size_t sz;
+            u32 interface;
     };
 
+    // Size (u64) in the response block, followed by that many bytes sent after it
+    class OutVariableBuffer : public CommandArgument
+    {
+        public:
+            OutVariableBuffer(std::vector<u8> &Buf);
+            void ProcessIn(InCommandBlock &block);
+            void ProcessAfterIn();
+            void ProcessOut(OutCommandBlock &block);
+            void ProcessAfterOut();
+        private:
+            std::vector<u8> &buf;
+            u32 interface;
+    };
+
+    // Sequential reads of a file can be streamed: the PC pushes consecutive blocks as long as it has credits, without a command per block.
+    // Only one stream can be active, and it's cancelled before any other command is sent through the data interface
+    bool StartFileStream(String Path, u64 Offset, u64 BlockSize, u32 Codecs);
+    bool IsFileStreamAt(String Path, u64 Offset);
+    u64 ReadFileStream(void *Out, u64 Size);
+    void CancelFileStream();
+
+    // Payload of a write, compressed when the host supports it and it's worth it
+    class InCompressedBuffer : public CommandArgument
+    {
+        public:
+            InCompressedBuffer(void *Buf, size_t Sz, u32 Codecs);
+            ~InCompressedBuffer();
+            void ProcessIn(InCommandBlock &block);
+            void ProcessAfterIn();
+            void ProcessOut(OutCommandBlock &block);
+            void ProcessAfterOut();
+        private:
+            void *buf;
+            size_t sz;
+            u32 codecs;
+            u8 *wire_buf;
+            size_t wire_bufsize;
+            u64 wire_size;
+            u32 interface;
+    };
+
+    // Payload of a read, which the host may send compressed if the request allowed it
+    class OutCompressedBuffer : public CommandArgument
+    {
+        public:
+            OutCompressedBuffer(void *Buf, size_t Sz, u32 Codecs);
+            void ProcessIn(InCommandBlock &block);
+            void ProcessAfterIn();
+            void ProcessOut(OutCommandBlock &block);
+            void ProcessAfterOut();
+            // Whether the payload arrived whole and decoded to the expected size
+            bool IsReceived();
+        private:
+            void *buf;
+            size_t sz;
+            u32 codecs;
+            u32 encoding;
+            u64 wire_size;
+            u32 interface;
+            bool received;
+    };
+
+    // Hosts which fail it, or don't answer it in time, are treated as revision 1 with no optional features
+    HostInfo Hello();
+    HostInfo GetHostInfo();
+
+    inline bool HostSupports(u32 Feature)
+    {
+        return (GetHostInfo().features & Feature) == Feature;
+    }
+
+    // Picks the interface a command goes through, and keeps other threads from mixing their blocks with it until EndCommand
+    u32 BeginCommand(CommandId Id);
+    void EndCommand(u32 Interface);
+
     template<CommandId id, typename ...Args>
     Result ProcessCommand(Args &&...args)
     {
-        InCommandBlock block(id);
+        auto intf = BeginCommand(id);
+        InCommandBlock block(id, intf);
         (args.ProcessIn(block), ...);
         auto rc = block.Send();
         if(R_SUCCEEDED(rc))
         {
             (args.ProcessAfterIn(), ...);
-            OutCommandBlock outblock;
+            OutCommandBlock outblock(intf, GetResponseTimeout(id));
             if(outblock.IsValid()) (args.ProcessOut(outblock), ...);
             outblock.Cleanup();
             if(outblock.IsValid()) (args.ProcessAfterOut(), ...);
             rc = outblock.res;
         }
+        EndCommand(intf);
         return rc;
     }
 }
\ No newline at end of file
@@ -28,11 +28,65 @@ namespace usb::detail
 {
     static constexpr size_t TotalInterfaces = 4;
 
+    // File payloads (and every command, for hosts which only know about the first interface) go through the data interface
+    // Other commands go through the control one, so that they don't wait behind big transfers
+    static constexpr u32 DataInterface = 0;
+    static constexpr u32 ControlInterface = 1;
+    static constexpr u32 UsedInterfaces = 2;
+
     Result Initialize(void);
     void Exit(void);
 
     bool IsStateOk();
 
-    Result Read(void *buf, size_t size);
-    Result Write(void *buf, size_t size);
+    // Transfers bigger than this are split in several URBs, so that the endpoint always has the next one queued when one completes
+    static constexpr size_t TransferChunkSize = 0x100000;
+    // usb:ds reports up to 8 URBs per endpoint, stay well below that
+    static constexpr u32 MaxTransferQueueDepth = 4;
+
+    // Keeps several URBs in flight on one endpoint, completions are reaped in the order they were posted.
+    // The endpoint is owned by the queue for its lifetime, so transfers from other threads can't interleave with it
+    class TransferQueue
+    {
+        private:
+            struct PendingTransfer
+            {
+                u32 urb_id;
+                size_t size;
+            };
+
+            UsbDsEndpoint *endpoint;
+            RwLock *lock;
+            PendingTransfer pending[MaxTransferQueueDepth];
+            u32 pending_head;
+            u32 pending_count;
+            u64 timeout;
+            Result rc;
+
+        public:
+            // Write = device to host (the IN endpoint), otherwise host to device
+            // Transfers still pending after Timeout (in ns) are cancelled, and the queue fails
+            TransferQueue(bool Write, u32 Interface = DataInterface, u64 Timeout = UINT64_MAX);
+            TransferQueue(const TransferQueue&) = delete;
+            TransferQueue &operator=(const TransferQueue&) = delete;
+            ~TransferQueue();
+
+            // Buf must be 0x1000-aligned and stay valid until its completion is reaped. Waits for the oldest transfer first if the queue is full
+            Result Post(void *Buf, size_t Size);
+            Result WaitNext();
+            Result WaitAll();
+
+            inline u32 GetPendingCount()
+            {
+                return this->pending_count;
+            }
+    };
+
+    Result Read(void *buf, size_t size, u32 interface = DataInterface, u64 timeout = UINT64_MAX);
+    Result Write(void *buf, size_t size, u32 interface = DataInterface);
+
+    // A single write which returns as soon as it's queued, for blocks the host only reads once it's done with something else.
+    // Unlike TransferQueue it doesn't hold the endpoint, so nothing else may write to the interface until the write is reaped
+    Result PostWrite(void *buf, size_t size, u32 &urb_id, u32 interface = DataInterface);
+    Result WaitWrite(u32 urb_id, size_t size, u32 interface = DataInterface);
 }
\ No newline at end of file
@@ -167,13 +167,15 @@ void EnsureDirectories()
 {
     auto nsys = fs::GetNANDSystemExplorer();
     auto sd = fs::GetSdCardExplorer();
+    // Installs don't stage anything on NAND anymore, just clean what older versions might have left behind
     nsys->DeleteDirectory("Contents/temp");
-    nsys->CreateDirectory("Contents/temp");
     sd->CreateDirectory(consts::Root);
     sd->CreateDirectory(consts::Root + "/meta");
     sd->CreateDirectory(consts::Root + "/title");
     sd->CreateDirectory(consts::Root + "/dump");
     sd->CreateDirectory(consts::Root + "/reports");
+    sd->CreateDirectory(consts::InstallStats);
+    sd->CreateDirectory(consts::USBBenchmarks);
     sd->CreateDirectory(consts::Root + "/amiibocache");
     sd->CreateDirectory(consts::Root + "/userdata");
     sd->CreateDirectory(consts::Root + "/dump/temp");
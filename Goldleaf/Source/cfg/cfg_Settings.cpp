@@ -48,6 +48,8 @@ namespace cfg
         if(this->has_scrollbar_color) json["ui"]["scrollBar"] = ColorToHex(this->scrollbar_color);
         if(this->has_progressbar_color) json["ui"]["progressBar"] = ColorToHex(this->progressbar_color);
         json["installs"]["ignoreRequiredFwVersion"] = this->ignore_required_fw_ver;
+        json["installs"]["verifyContentHashes"] = this->verify_content_hashes;
+        json["installs"]["reuseOtherStorageContents"] = this->reuse_other_storage_contents;
         for(u32 i = 0; i < this->bookmarks.size(); i++)
         {
             auto bmk = this->bookmarks[i];
@@ -126,6 +128,8 @@ namespace cfg
 
         gset.menu_item_size = 80;
         gset.ignore_required_fw_ver = true;
+        gset.verify_content_hashes = false;
+        gset.reuse_other_storage_contents = true;
 
         gset.custom_scheme = ui::GenerateRandomScheme();
 
@@ -203,6 +207,8 @@ namespace cfg
             if(settings.count("installs"))
             {
                 gset.ignore_required_fw_ver = settings["installs"].value("ignoreRequiredFwVersion", true);
+                gset.verify_content_hashes = settings["installs"].value("verifyContentHashes", false);
+                gset.reuse_other_storage_contents = settings["installs"].value("reuseOtherStorageContents", true);
             }
             if(settings.count("web"))
             {
@@ -23,6 +23,7 @@
 #include <hos/hos_Titles.hpp>
 #include <fatfs/fatfs.hpp>
 #include <es/es_Service.hpp>
+#include <nsp/nca_Writer.hpp>
 #include <sstream>
 #include <iomanip>
 
@@ -32,19 +33,19 @@ namespace dump
 {
     void DecryptCopyNAX0ToNCA(NcmContentStorage *ncst, NcmContentId NCAId, String Path, std::function<void(double Done, double Total)> Callback)
     {
-        s64 ncasize = 0;
-        ncmContentStorageGetSizeFromContentId(ncst, &ncasize, &NCAId);
+        fs::ContentStorage cnt(ncst, NCAId);
+        u64 ncasize = cnt.GetSize();
         u64 szrem = ncasize;
         FILE *f = fopen(Path.AsUTF8().c_str(), "wb");
         if(f)
         {
-            s64 off = 0;
+            u64 off = 0;
             u64 rmax = fs::WorkBufferSize;
             u8 *data = fs::GetWorkBuffer();
             while(szrem)
             {
                 u64 rsize = std::min(rmax, szrem);
-                if(ncmContentStorageReadContentIdFile(ncst, data, rsize, &NCAId, off) != 0) break;
+                if(cnt.Read(off, rsize, data) != rsize) break;
                 fwrite(data, 1, rsize, f);
                 szrem -= rsize;
                 off += rsize;
@@ -54,6 +55,43 @@ namespace dump
         }
     }
 
+    CompressResult CompressNCAToNCZ(fs::StorageRef Input, String Output, bool Solid, std::function<void(double Done, double Total)> Callback)
+    {
+        auto sd_exp = fs::GetSdCardExplorer();
+        u64 ncasize = Input->GetSize();
+        if(ncasize == 0) return CompressResult::Failed;
+        FILE *out = nullptr;
+        bool ok = true;
+        NczCompressor compressor([&](u64 Offset, u64 Size, u8 *Out) -> u64
+        {
+            return Input->Read(Offset, Size, Out);
+        }, ncasize, [&](u64 Offset, const u8 *Data, u64 Size)
+        {
+            if(fseeko(out, Offset, SEEK_SET) != 0) ok = false;
+            else if(fwrite(Data, 1, Size, out) != Size) ok = false;
+        }, Solid);
+        if(compressor.hasRightsId()) return CompressResult::TitlekeyCrypto;
+
+        fs::CreateConcatenationFile(Output);
+        out = fopen(Output.AsUTF8().c_str(), "wb");
+        if(!out)
+        {
+            sd_exp->DeleteFile(Output);
+            return CompressResult::Failed;
+        }
+        ok = compressor.compress([&](u64 Done, u64 Total)
+        {
+            Callback((double)Done, (double)Total);
+        }) && ok;
+        fclose(out);
+        if(!ok)
+        {
+            sd_exp->DeleteFile(Output);
+            return CompressResult::Failed;
+        }
+        return CompressResult::Compressed;
+    }
+
     bool GetMetaRecord(NcmContentMetaDatabase *metadb, u64 ApplicationId, NcmContentMetaKey *out)
     {
         NcmContentMetaKey *metas = new NcmContentMetaKey[hos::MaxTitleCount]();
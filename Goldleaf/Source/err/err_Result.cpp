@@ -57,6 +57,9 @@ namespace err
         { result::ResultCouldNotBuildNSP, 11 },
         { result::ResultKeyGenMismatch, 12 },
         { result::ResultInvalidNSP, 3 },
+        { result::ResultContentReadFailed, 13 },
+        { result::ResultContentHashMismatch, 14 },
+        { result::ResultPCFeatureNotSupported, 15 },
     };
 
     static std::map<u32, u32> ModuleStringTable =
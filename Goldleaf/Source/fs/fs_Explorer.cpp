@@ -66,17 +66,29 @@ namespace fs
 
     std::vector<String> Explorer::GetContents()
     {
-        auto dirs = this->GetDirectories(this->ecwd);
-        auto files = this->GetFiles(this->ecwd);
+        std::vector<String> contents;
+        for(auto &entry: this->GetContentEntries()) contents.push_back(entry.Name);
+        return contents;
+    }
 
-        if(!dirs.empty()) std::sort(dirs.begin(), dirs.end(), InternalCaseCompare);
-        if(!files.empty())
+    std::vector<DirectoryEntry> Explorer::GetContentEntries()
+    {
+        auto entries = this->GetEntries(this->ecwd);
+        // Directories first, then files, both sorted by name
+        std::sort(entries.begin(), entries.end(), [](const DirectoryEntry &a, const DirectoryEntry &b)
         {
-            std::sort(files.begin(), files.end(), InternalCaseCompare);
-            dirs.insert(dirs.end(), files.begin(), files.end());
-        }
+            if(a.IsDirectory != b.IsDirectory) return a.IsDirectory;
+            return InternalCaseCompare(a.Name, b.Name);
+        });
+        return entries;
+    }
 
-        return dirs;
+    std::vector<DirectoryEntry> Explorer::GetEntries(String Path)
+    {
+        std::vector<DirectoryEntry> entries;
+        for(auto &dir: this->GetDirectories(Path)) entries.push_back({ dir, true, 0, 0 });
+        for(auto &file: this->GetFiles(Path)) entries.push_back({ file, false, 0, 0 });
+        return entries;
     }
 
     String Explorer::GetMountName()
@@ -97,6 +109,38 @@ namespace fs
         return this->dspname + ":/" + cwdnoroot;
     }
 
+    u64 Explorer::ReadFileBlockShared(String Path, u64 Offset, u64 Size, void *Out)
+    {
+        mutexLock(&this->shared_lock);
+        if(this->shared_path != Path)
+        {
+            this->StartFile(Path, fs::FileMode::Read);
+            this->shared_path = Path;
+        }
+        auto rsize = this->ReadFileBlock(Path, Offset, Size, Out);
+        mutexUnlock(&this->shared_lock);
+        return rsize;
+    }
+
+    u64 Explorer::GetFileSizeShared(String Path)
+    {
+        mutexLock(&this->shared_lock);
+        auto fsize = this->GetFileSize(Path);
+        mutexUnlock(&this->shared_lock);
+        return fsize;
+    }
+
+    void Explorer::EndFileShared()
+    {
+        mutexLock(&this->shared_lock);
+        if(!this->shared_path.empty())
+        {
+            this->EndFile(fs::FileMode::Read);
+            this->shared_path = "";
+        }
+        mutexUnlock(&this->shared_lock);
+    }
+
     void Explorer::CopyFile(String Path, String NewPath)
     {
         String path = this->MakeFull(Path);
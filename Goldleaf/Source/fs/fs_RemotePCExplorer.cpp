@@ -28,17 +28,168 @@
 #include <algorithm>
 #include <iomanip>
 #include <cctype>
+#include <cstring>
 
 namespace fs
 {
-    RemotePCExplorer::RemotePCExplorer(String MountName)
+    static inline bool IsCacheEntryFresh(u64 Tick)
+    {
+        return armTicksToNs(armGetSystemTick() - Tick) < RemotePCCacheLifetimeNs;
+    }
+
+    static inline std::string MakeChildPath(const std::string &Parent, const std::string &Name)
+    {
+        auto path = Parent;
+        if(path.back() != '/') path += "/";
+        return path + Name;
+    }
+
+    static inline bool IsPathOrChild(const std::string &Path, const std::string &Base)
+    {
+        if(Path.compare(0, Base.length(), Base) != 0) return false;
+        return (Path.length() == Base.length()) || (Path[Base.length()] == '/') || (Base.back() == '/');
+    }
+
+    RemotePCExplorer::RemotePCExplorer(String MountName) : last_read_end(0)
     {
         this->SetNames(MountName, MountName);
+        // Done whenever the PC drive is opened again, Quark might have been restarted (or updated) meanwhile
+        usb::Hello();
+        this->compression_codecs = usb::HostSupports(usb::FeatureCompression) ? usb::CompressionZstd : 0;
+    }
+
+    bool RemotePCExplorer::ListDirectory(String Path, std::vector<DirectoryEntry> &Out)
+    {
+        if(!usb::HostSupports(usb::FeatureBulkListing)) return false;
+        String path = this->MakeFull(Path);
+        auto key = path.AsUTF8();
+        mutexLock(&this->cache_lock);
+        auto it = this->listing_cache.find(key);
+        if((it != this->listing_cache.end()) && IsCacheEntryFresh(it->second.tick))
+        {
+            Out = it->second.entries;
+            mutexUnlock(&this->cache_lock);
+            return true;
+        }
+        mutexUnlock(&this->cache_lock);
+
+        std::vector<DirectoryEntry> entries;
+        u32 total = 0;
+        do
+        {
+            // Each page is a response block with the count and size, followed by the entries as a single buffer
+            u32 count = 0;
+            std::vector<u8> page;
+            auto rc = usb::ProcessCommand<usb::CommandId::ListDirectory>(usb::InString(path), usb::In32(entries.size()), usb::Out32(total), usb::Out32(count), usb::OutVariableBuffer(page));
+            if(R_FAILED(rc)) return false;
+            if(count == 0) break;
+
+            size_t offset = 0;
+            for(u32 i = 0; i < count; i++)
+            {
+                // Type (u32), size (u64), modification time (u64), name length (u32) and the UTF-16 name
+                if((offset + 24) > page.size()) return false;
+                u32 type = 0;
+                u64 size = 0;
+                u64 mtime = 0;
+                u32 namelen = 0;
+                memcpy(&type, page.data() + offset, sizeof(u32));
+                memcpy(&size, page.data() + offset + 4, sizeof(u64));
+                memcpy(&mtime, page.data() + offset + 12, sizeof(u64));
+                memcpy(&namelen, page.data() + offset + 20, sizeof(u32));
+                offset += 24;
+                if((offset + (namelen * sizeof(char16_t))) > page.size()) return false;
+                auto name = new char16_t[namelen + 1]();
+                memcpy(name, page.data() + offset, namelen * sizeof(char16_t));
+                offset += namelen * sizeof(char16_t);
+                entries.push_back({ String(name), (type == 2), size, mtime });
+                delete[] name;
+            }
+        } while(entries.size() < total);
+
+        // The listing already has everything a stat would return for its entries
+        auto tick = armGetSystemTick();
+        mutexLock(&this->cache_lock);
+        for(auto &entry: entries) this->stat_cache[MakeChildPath(key, entry.Name.AsUTF8())] = { entry.IsDirectory ? 2u : 1u, entry.Size, tick };
+        this->listing_cache[key] = { entries, tick };
+        mutexUnlock(&this->cache_lock);
+        Out = std::move(entries);
+        return true;
+    }
+
+    u32 RemotePCExplorer::StatPath(String Path, u64 &Size)
+    {
+        String path = this->MakeFull(Path);
+        auto key = path.AsUTF8();
+        mutexLock(&this->cache_lock);
+        auto it = this->stat_cache.find(key);
+        if((it != this->stat_cache.end()) && IsCacheEntryFresh(it->second.tick))
+        {
+            auto type = it->second.type;
+            Size = it->second.size;
+            mutexUnlock(&this->cache_lock);
+            return type;
+        }
+        mutexUnlock(&this->cache_lock);
+
+        u32 type = 0;
+        u64 size = 0;
+        auto rc = usb::ProcessCommand<usb::CommandId::StatPath>(usb::InString(path), usb::Out32(type), usb::Out64(size));
+        // Failures aren't cached, a broken transfer would otherwise look like a missing path for a while
+        if(R_SUCCEEDED(rc))
+        {
+            mutexLock(&this->cache_lock);
+            this->stat_cache[key] = { type, size, armGetSystemTick() };
+            mutexUnlock(&this->cache_lock);
+        }
+        else
+        {
+            type = 0;
+            size = 0;
+        }
+        Size = size;
+        return type;
+    }
+
+    void RemotePCExplorer::InvalidateCache(String Path)
+    {
+        auto key = this->MakeFull(Path).AsUTF8();
+        auto parent = key.substr(0, key.find_last_of('/'));
+        mutexLock(&this->cache_lock);
+        for(auto it = this->stat_cache.begin(); it != this->stat_cache.end();)
+        {
+            if(IsPathOrChild(it->first, key)) it = this->stat_cache.erase(it);
+            else it++;
+        }
+        for(auto it = this->listing_cache.begin(); it != this->listing_cache.end();)
+        {
+            // The parent listing changes too, whether it's kept with a trailing slash (drive roots) or not
+            if(IsPathOrChild(it->first, key) || (it->first == parent) || (it->first == (parent + "/"))) it = this->listing_cache.erase(it);
+            else it++;
+        }
+        mutexUnlock(&this->cache_lock);
+    }
+
+    std::vector<DirectoryEntry> RemotePCExplorer::GetEntries(String Path)
+    {
+        std::vector<DirectoryEntry> entries;
+        // Older hosts don't know the command, fall back to listing entry by entry
+        if(this->ListDirectory(Path, entries)) return entries;
+        return Explorer::GetEntries(Path);
     }
 
     std::vector<String> RemotePCExplorer::GetDirectories(String Path)
     {
         std::vector<String> dirs;
+        std::vector<DirectoryEntry> entries;
+        if(this->ListDirectory(Path, entries))
+        {
+            for(auto &entry: entries)
+            {
+                if(entry.IsDirectory) dirs.push_back(entry.Name);
+            }
+            return dirs;
+        }
         String path = this->MakeFull(Path);
         u32 dircount = 0;
         auto rc = usb::ProcessCommand<usb::CommandId::GetDirectoryCount>(usb::InString(path), usb::Out32(dircount));
@@ -57,6 +208,15 @@ namespace fs
     std::vector<String> RemotePCExplorer::GetFiles(String Path)
     {
         std::vector<String> files;
+        std::vector<DirectoryEntry> entries;
+        if(this->ListDirectory(Path, entries))
+        {
+            for(auto &entry: entries)
+            {
+                if(!entry.IsDirectory) files.push_back(entry.Name);
+            }
+            return files;
+        }
         String path = this->MakeFull(Path);
         u32 filecount = 0;
         auto rc = usb::ProcessCommand<usb::CommandId::GetFileCount>(usb::InString(path), usb::Out32(filecount));
@@ -74,76 +234,75 @@ namespace fs
 
     bool RemotePCExplorer::Exists(String Path)
     {
-        bool ex = false;
-        String path = this->MakeFull(Path);
-        u32 type = 0;
         u64 tmpfsz = 0;
-        usb::ProcessCommand<usb::CommandId::StatPath>(usb::InString(path), usb::Out32(type), usb::Out64(tmpfsz));
-        ex = ((type == 1) || (type == 2));
-        return ex;
+        auto type = this->StatPath(Path, tmpfsz);
+        return ((type == 1) || (type == 2));
     }
 
     bool RemotePCExplorer::IsFile(String Path)
     {
-        bool ex = false;
-        String path = this->MakeFull(Path);
-        u32 type = 0;
         u64 tmpfsz = 0;
-        usb::ProcessCommand<usb::CommandId::StatPath>(usb::InString(path), usb::Out32(type), usb::Out64(tmpfsz));
-        ex = (type == 1);
-        return ex;
+        auto type = this->StatPath(Path, tmpfsz);
+        return (type == 1);
     }
 
     bool RemotePCExplorer::IsDirectory(String Path)
     {
-        bool ex = false;
-        String path = this->MakeFull(Path);
-        u32 type = 0;
         u64 tmpfsz = 0;
-        usb::ProcessCommand<usb::CommandId::StatPath>(usb::InString(path), usb::Out32(type), usb::Out64(tmpfsz));
-        ex = (type == 2);
-        return ex;
+        auto type = this->StatPath(Path, tmpfsz);
+        return (type == 2);
     }
 
     void RemotePCExplorer::CreateFile(String Path)
     {
         String path = this->MakeFull(Path);
+        this->InvalidateCache(path);
         usb::ProcessCommand<usb::CommandId::Create>(usb::In32(1), usb::InString(path));
     }
 
     void RemotePCExplorer::CreateDirectory(String Path)
     {
         String path = this->MakeFull(Path);
+        this->InvalidateCache(path);
         usb::ProcessCommand<usb::CommandId::Create>(usb::In32(2), usb::InString(path));
     }
 
     void RemotePCExplorer::RenameFile(String Path, String NewName)
     {
         String path = this->MakeFull(Path);
+        this->InvalidateCache(path);
+        // The new name is relative to the same directory
+        this->InvalidateCache(MakeChildPath(path.AsUTF8().substr(0, path.AsUTF8().find_last_of('/')), NewName.AsUTF8()));
         usb::ProcessCommand<usb::CommandId::Rename>(usb::In32(1), usb::InString(path), usb::InString(NewName));
     }
 
     void RemotePCExplorer::RenameDirectory(String Path, String NewName)
     {
         String path = this->MakeFull(Path);
+        this->InvalidateCache(path);
+        // The new name is relative to the same directory
+        this->InvalidateCache(MakeChildPath(path.AsUTF8().substr(0, path.AsUTF8().find_last_of('/')), NewName.AsUTF8()));
         usb::ProcessCommand<usb::CommandId::Rename>(usb::In32(2), usb::InString(path), usb::InString(NewName));
     }
 
     void RemotePCExplorer::DeleteFile(String Path)
     {
         String path = this->MakeFull(Path);
+        this->InvalidateCache(path);
         usb::ProcessCommand<usb::CommandId::Delete>(usb::In32(1), usb::InString(path));
     }
 
     void RemotePCExplorer::DeleteDirectory(String Path)
     {
         String path = this->MakeFull(Path);
+        this->InvalidateCache(path);
         usb::ProcessCommand<usb::CommandId::Delete>(usb::In32(2), usb::InString(path));
     }
 
     void RemotePCExplorer::StartFile(String path, FileMode mode)
     {
         String npath = this->MakeFull(path);
+        if(mode != FileMode::Read) this->InvalidateCache(npath);
         usb::ProcessCommand<usb::CommandId::StartFile>(usb::InString(npath), usb::In32((u32)mode));
     }
 
@@ -151,14 +310,32 @@ namespace fs
     {
         u64 rsize = 0;
         String path = this->MakeFull(Path);
-        usb::ProcessCommand<usb::CommandId::ReadFile>(usb::InString(path), usb::In64(Offset), usb::In64(Size), usb::Out64(rsize), usb::OutBuffer(Out, Size));
+        if(usb::IsFileStreamAt(path, Offset)) return usb::ReadFileStream(Out, Size);
+        if(usb::HostSupports(usb::FeatureStreaming) && (Size >= usb::StreamMinBlockSize) && (path == this->last_read_path) && (Offset == this->last_read_end))
+        {
+            // Blocks are pushed in the size the host prefers, reads of a different size are split or joined from them
+            auto host_info = usb::GetHostInfo();
+            u64 block_size = Size;
+            if(host_info.preferred_transfer_size > 0) block_size = std::max(host_info.preferred_transfer_size, usb::StreamMinBlockSize);
+            u64 max_size = usb::MaxPayloadSize;
+            if(host_info.max_payload_size > 0) max_size = std::min(max_size, (u64)host_info.max_payload_size);
+            block_size = std::min(block_size, max_size);
+            if(usb::StartFileStream(path, Offset, block_size, this->compression_codecs)) return usb::ReadFileStream(Out, Size);
+        }
+        usb::OutCompressedBuffer out_buf(Out, Size, this->compression_codecs);
+        auto rc = usb::ProcessCommand<usb::CommandId::ReadFile>(usb::InString(path), usb::In64(Offset), usb::In64(Size), usb::Out64(rsize), out_buf);
+        // A payload which failed to decode leaves the buffer with garbage, that can't be reported as read
+        if(R_FAILED(rc) || !out_buf.IsReceived()) rsize = 0;
+        this->last_read_path = path;
+        this->last_read_end = Offset + rsize;
         return rsize;
     }
 
     u64 RemotePCExplorer::WriteFileBlock(String Path, void *Data, u64 Size)
     {
         String path = this->MakeFull(Path);
-        usb::ProcessCommand<usb::CommandId::WriteFile>(usb::InString(path), usb::In64(Size), usb::InBuffer(Data, Size));
+        this->InvalidateCache(path);
+        usb::ProcessCommand<usb::CommandId::WriteFile>(usb::InString(path), usb::In64(Size), usb::InCompressedBuffer(Data, Size, this->compression_codecs));
         return Size;
     }
 
@@ -170,9 +347,7 @@ namespace fs
     u64 RemotePCExplorer::GetFileSize(String Path)
     {
         u64 sz = 0;
-        String path = this->MakeFull(Path);
-        u32 tmptype = 0;
-        usb::ProcessCommand<usb::CommandId::StatPath>(usb::InString(path), usb::Out32(tmptype), usb::Out64(sz));
+        this->StatPath(Path, sz);
         return sz;
     }
 
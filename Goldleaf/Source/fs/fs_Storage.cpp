@@ -0,0 +1,140 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <fs/fs_Storage.hpp>
+#include <cstring>
+#include <algorithm>
+
+namespace fs
+{
+    FileStorage::FileStorage(Explorer *Exp, String Path) : exp(Exp), path(Path), size(0), has_size(false)
+    {
+    }
+
+    u64 FileStorage::Read(u64 Offset, u64 Size, void *Out)
+    {
+        return this->exp->ReadFileBlockShared(this->path, Offset, Size, Out);
+    }
+
+    u64 FileStorage::GetSize()
+    {
+        // Only asked for once, it's a whole round trip for remote files
+        if(!this->has_size)
+        {
+            this->size = this->exp->GetFileSizeShared(this->path);
+            this->has_size = true;
+        }
+        return this->size;
+    }
+
+    Explorer *FileStorage::GetExplorer()
+    {
+        return this->exp;
+    }
+
+    String FileStorage::GetPath()
+    {
+        return this->path;
+    }
+
+    ContentStorage::ContentStorage(NcmContentStorage *Storage, NcmContentId Id) : cnt_storage(Storage), cnt_id(Id), size(0)
+    {
+        s64 cnt_size = 0;
+        if(R_SUCCEEDED(ncmContentStorageGetSizeFromContentId(this->cnt_storage, &cnt_size, &this->cnt_id))) this->size = cnt_size;
+    }
+
+    u64 ContentStorage::Read(u64 Offset, u64 Size, void *Out)
+    {
+        if(Offset >= this->size) return 0;
+        auto read_size = std::min(Size, this->size - Offset);
+        if(R_FAILED(ncmContentStorageReadContentIdFile(this->cnt_storage, Out, read_size, &this->cnt_id, Offset))) return 0;
+        return read_size;
+    }
+
+    u64 ContentStorage::GetSize()
+    {
+        return this->size;
+    }
+
+    MemoryStorage::MemoryStorage(std::vector<u8> Data) : own_data(std::move(Data))
+    {
+        this->data = this->own_data.data();
+        this->size = this->own_data.size();
+    }
+
+    MemoryStorage::MemoryStorage(const void *Data, u64 Size) : data(reinterpret_cast<const u8*>(Data)), size(Size)
+    {
+    }
+
+    u64 MemoryStorage::Read(u64 Offset, u64 Size, void *Out)
+    {
+        if(Offset >= this->size) return 0;
+        auto read_size = std::min(Size, this->size - Offset);
+        memcpy(Out, this->data + Offset, read_size);
+        return read_size;
+    }
+
+    u64 MemoryStorage::GetSize()
+    {
+        return this->size;
+    }
+
+    const u8 *MemoryStorage::GetBufferView(u64 Offset, u64 Size)
+    {
+        if((Offset > this->size) || (Size > (this->size - Offset))) return nullptr;
+        return this->data + Offset;
+    }
+
+    SubStorage::SubStorage(StorageRef Base, u64 Offset, u64 Size) : base(Base), offset(Offset), size(Size)
+    {
+        StorageRef base_base;
+        u64 base_offset = 0;
+        if(Base->GetBaseRange(base_base, base_offset))
+        {
+            this->base = base_base;
+            this->offset += base_offset;
+        }
+    }
+
+    u64 SubStorage::Read(u64 Offset, u64 Size, void *Out)
+    {
+        if(Offset >= this->size) return 0;
+        return this->base->Read(this->offset + Offset, std::min(Size, this->size - Offset), Out);
+    }
+
+    u64 SubStorage::GetSize()
+    {
+        return this->size;
+    }
+
+    const u8 *SubStorage::GetBufferView(u64 Offset, u64 Size)
+    {
+        if((Offset > this->size) || (Size > (this->size - Offset))) return nullptr;
+        return this->base->GetBufferView(this->offset + Offset, Size);
+    }
+
+    bool SubStorage::GetBaseRange(StorageRef &OutBase, u64 &OutOffset)
+    {
+        OutBase = this->base;
+        OutOffset = this->offset;
+        return true;
+    }
+}
@@ -0,0 +1,106 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <hos/hos_Threads.hpp>
+
+namespace hos
+{
+    u64 GetAvailableCoreMask()
+    {
+        u64 mask = 0;
+        auto rc = svcGetInfo(&mask, InfoType_CoreMask, CUR_PROCESS_HANDLE, 0);
+        if(R_FAILED(rc) || (mask == 0)) mask = BIT(svcGetCurrentProcessorNumber());
+        return mask;
+    }
+
+    u32 GetAvailableCoreCount()
+    {
+        return __builtin_popcountll(GetAvailableCoreMask());
+    }
+
+    int GetWorkerCore(u32 WorkerIndex)
+    {
+        auto mask = GetAvailableCoreMask();
+        auto cur_core = svcGetCurrentProcessorNumber();
+        // Prefer cores other than the current one, but fall back to every core if that's the only one we're given
+        auto worker_mask = mask & ~BIT(cur_core);
+        if(worker_mask == 0) worker_mask = mask;
+        auto worker_count = __builtin_popcountll(worker_mask);
+        auto target = WorkerIndex % worker_count;
+        for(int i = 0; i < 64; i++)
+        {
+            if(worker_mask & BIT(i))
+            {
+                if(target == 0) return i;
+                target--;
+            }
+        }
+        return -2;
+    }
+
+    void WorkerThread::ThreadEntry(void *Arg)
+    {
+        auto self = reinterpret_cast<WorkerThread*>(Arg);
+        self->fn();
+    }
+
+    WorkerThread::WorkerThread() : thread(), created(false), running(false)
+    {
+    }
+
+    WorkerThread::~WorkerThread()
+    {
+        this->Join();
+    }
+
+    Result WorkerThread::Start(std::function<void()> Fn, int CpuId)
+    {
+        this->Join();
+        this->fn = Fn;
+        auto rc = threadCreate(&this->thread, &WorkerThread::ThreadEntry, this, nullptr, WorkerThreadStackSize, WorkerThreadPriority, CpuId);
+        if(R_SUCCEEDED(rc))
+        {
+            this->created = true;
+            rc = threadStart(&this->thread);
+            if(R_SUCCEEDED(rc)) this->running = true;
+            else
+            {
+                threadClose(&this->thread);
+                this->created = false;
+            }
+        }
+        return rc;
+    }
+
+    void WorkerThread::Join()
+    {
+        if(this->running)
+        {
+            threadWaitForExit(&this->thread);
+            this->running = false;
+        }
+        if(this->created)
+        {
+            threadClose(&this->thread);
+            this->created = false;
+        }
+    }
+}
@@ -406,13 +406,23 @@ namespace hos
         TicketFile tik = {};
 
         auto fexp = fs::GetExplorerForPath(Path);
-        fexp->StartFile(Path, fs::FileMode::Read);
-        fexp->ReadFileBlock(Path, 0, sizeof(tik.signature), &tik.signature);
+        fexp->ReadFileBlockShared(Path, 0, sizeof(tik.signature), &tik.signature);
 
         auto ticket_data_offset = GetTicketSignatureSize(tik.signature);
-        fexp->ReadFileBlock(Path, ticket_data_offset, sizeof(tik.data), &tik.data);
+        fexp->ReadFileBlockShared(Path, ticket_data_offset, sizeof(tik.data), &tik.data);
         
-        fexp->EndFile(fs::FileMode::Read);
+        fexp->EndFileShared();
+        return tik;
+    }
+
+    TicketFile ReadTicket(const u8 *Data, u64 Size)
+    {
+        TicketFile tik = {};
+        if(Size < sizeof(tik.signature)) return tik;
+        memcpy(&tik.signature, Data, sizeof(tik.signature));
+
+        auto ticket_data_offset = GetTicketSignatureSize(tik.signature);
+        if(Size >= (ticket_data_offset + sizeof(tik.data))) memcpy(&tik.data, Data + ticket_data_offset, sizeof(tik.data));
         return tik;
     }
 
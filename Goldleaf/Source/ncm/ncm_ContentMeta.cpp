@@ -53,16 +53,23 @@ namespace ncm
         return metaRecord;
     }
 
-    std::vector<ContentRecord> ContentMeta::GetContentRecords()
+    std::vector<HashedContentRecord> ContentMeta::GetHashedContentRecords()
     {
         auto contentMetaHeader = this->GetContentMetaHeader();
-        std::vector<ContentRecord> contentRecords;
-        auto hashedContentRecords = reinterpret_cast<HashedContentRecord*>(buf.GetData() + sizeof(ContentMetaHeader) + contentMetaHeader.ExtendedHeaderSize);
+        std::vector<HashedContentRecord> hashedContentRecords;
+        auto hashedContentRecordsData = reinterpret_cast<HashedContentRecord*>(buf.GetData() + sizeof(ContentMetaHeader) + contentMetaHeader.ExtendedHeaderSize);
         for(u32 i = 0; i < contentMetaHeader.ContentCount; i++)
         {
-            auto hashedContentRecord = hashedContentRecords[i];
-            if(hashedContentRecord.Record.Type != ContentType::DeltaFragment) contentRecords.push_back(hashedContentRecord.Record); 
+            auto hashedContentRecord = hashedContentRecordsData[i];
+            if(hashedContentRecord.Record.Type != ContentType::DeltaFragment) hashedContentRecords.push_back(hashedContentRecord); 
         }
+        return hashedContentRecords;
+    }
+
+    std::vector<ContentRecord> ContentMeta::GetContentRecords()
+    {
+        std::vector<ContentRecord> contentRecords;
+        for(auto &hashedContentRecord : this->GetHashedContentRecords()) contentRecords.push_back(hashedContentRecord.Record);
         return contentRecords;
     }
 
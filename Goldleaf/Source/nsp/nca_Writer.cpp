@@ -1,11 +1,26 @@
 #include <nsp/nca_Writer.hpp>
 #include <err/err_Result.hpp>
+#include <hos/hos_Threads.hpp>
 #include <zstd.h>
 #include <string.h>
+#include <algorithm>
+#include <atomic>
 
 // 4MB Buffer
 #define NSZ_BUFFER_SZ 0x400000
 
+// Capacity of each of the pooled input/output buffers (16MB), also bounds every batch of NCZ blocks decompressed in parallel
+#define NCA_BUFFER_POOL_SZ 0x1000000
+
+// Largest NCZ block size we accept (16MB), nsz uses 1MB blocks by default
+#define NCZ_BLOCK_MAX_SIZE_EXPONENT 24
+
+// Block size we export block compressed NCZs with (1MB), same as nsz
+#define NCZ_BLOCK_SIZE_EXPONENT 20
+
+// zstd level used when exporting, higher levels barely shrink NCAs any further and are far too slow for the console's CPU
+#define NCZ_COMPRESSION_LEVEL 8
+
 class Keys
 {
 public:
@@ -21,6 +36,13 @@ public:
      u8 headerKekSource[0x10] = { 0x1F, 0x12, 0x91, 0x3A, 0x4A, 0xCB, 0xF0, 0x0D, 0x4C, 0xDE, 0x3A, 0xF6, 0xD5, 0x23, 0x88, 0x2A };
      u8 headerKeySource[0x20] = { 0x5A, 0x3E, 0xD8, 0x4F, 0xDE, 0xC0, 0xD8, 0x26, 0x31, 0xF7, 0xE2, 0x5D, 0x19, 0x7B, 0xF5, 0xD0, 0x1C, 0x9B, 0x7B, 0xFA, 0xF6, 0x28, 0x18, 0x3D, 0x71, 0xF6, 0x4D, 0x73, 0xF1, 0x50, 0xB9, 0xD2 };
 
+     /* Key area encryption key sources: application, ocean and system */
+     u8 keyAreaKeySources[3][0x10] = {
+          { 0x7F, 0x59, 0x97, 0x1E, 0x62, 0x9F, 0x36, 0xA1, 0x30, 0x98, 0x06, 0x6F, 0x21, 0x44, 0xC3, 0x0D },
+          { 0x32, 0x7D, 0x36, 0x08, 0x5A, 0xD1, 0x75, 0x8D, 0xAB, 0x4E, 0x6F, 0xBA, 0xA5, 0x55, 0xD8, 0x82 },
+          { 0x87, 0x45, 0xF1, 0xBB, 0xA6, 0xBE, 0x79, 0x64, 0x7D, 0x04, 0x8B, 0xA6, 0x7B, 0x5F, 0xDA, 0x4A },
+     };
+
      u8 headerKey[0x20] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
 };
 
@@ -48,11 +70,45 @@ T swapEndian(T s)
      return result;
 }
 
-void append(std::vector<u8>& buffer, const u8* ptr, u64 sz)
+NcaBuffer::NcaBuffer(u64 capacity) : m_data(new (std::align_val_t(0x1000)) u8[capacity]), m_capacity(capacity), m_size(0)
+{
+}
+
+NcaBuffer::~NcaBuffer()
+{
+     operator delete[](m_data, std::align_val_t(0x1000));
+}
+
+/* Copies as much as fits and returns how much that was */
+u64 NcaBuffer::append(const u8* ptr, u64 sz)
+{
+     u64 chunk = std::min(sz, available());
+     memcpy(end(), ptr, chunk);
+     m_size += chunk;
+     return chunk;
+}
+
+/* Accounts for data produced directly at end() */
+void NcaBuffer::commit(u64 sz)
+{
+     m_size += std::min(sz, available());
+}
+
+/* Drops data from the front, the (small) unconsumed tail is moved back to the start */
+void NcaBuffer::consume(u64 sz)
+{
+     if (sz >= m_size)
+     {
+          m_size = 0;
+          return;
+     }
+
+     memmove(m_data, m_data + sz, m_size - sz);
+     m_size -= sz;
+}
+
+NcaBufferPool::NcaBufferPool() : header(NCA_HEADER_SIZE), input(NCA_BUFFER_POOL_SZ), output(NCA_BUFFER_POOL_SZ)
 {
-     u64 offset = buffer.size();
-     buffer.resize(offset + sz);
-     memcpy(buffer.data() + offset, ptr, sz);
 }
 
 class AesCtr
@@ -92,6 +148,14 @@ public:
      {
           counter.low() = swapEndian(offset >> 4);
           aes128CtrContextResetCtr(&ctx, &counter);
+
+          /* Consume the keystream up to an offset which is not block aligned */
+          const u64 skip = offset & 0xF;
+          if (skip)
+          {
+               u8 dummy[0x10] = {};
+               aes128CtrCrypt(&ctx, dummy, dummy, skip);
+          }
      }
 
      void encrypt(void *dst, const void *src, size_t l)
@@ -149,7 +213,7 @@ protected:
 };
 
 
-NcaBodyWriter::NcaBodyWriter(const NcmPlaceHolderId& placeHoldId, u64 offset, NcmContentStorage* contentStorage) : m_contentStorage(contentStorage), m_placeHoldId(placeHoldId), m_offset(offset)
+NcaBodyWriter::NcaBodyWriter(const NcmPlaceHolderId& placeHoldId, u64 offset, NcmContentStorage* contentStorage, const NcaWriteFunction& writeFunc, NcaBufferPool& pool) : m_contentStorage(contentStorage), m_placeHoldId(placeHoldId), m_writeFunc(writeFunc), m_pool(pool), m_telemetry(NULL), m_offset(offset)
 {
 }
 
@@ -161,7 +225,7 @@ u64 NcaBodyWriter::write(const  u8* ptr, u64 sz)
 {
      if(isOpen())
      {
-          ncmContentStorageWritePlaceHolder(m_contentStorage, &m_placeHoldId, m_offset, (void*)ptr, sz);
+          writePlaceHolder(m_offset, ptr, sz);
           m_offset += sz;
           return sz;
      }
@@ -169,11 +233,38 @@ u64 NcaBodyWriter::write(const  u8* ptr, u64 sz)
      return 0;
 }
 
+bool NcaBodyWriter::close()
+{
+     return true;
+}
+
 bool NcaBodyWriter::isOpen() const
 {
      return m_contentStorage != NULL;
 }
 
+void NcaBodyWriter::setTelemetry(nsp::InstallTelemetry* telemetry)
+{
+     m_telemetry = telemetry;
+}
+
+void NcaBodyWriter::setOutput(const NcaOutputFunction& outputFunc)
+{
+     m_outputFunc = outputFunc;
+}
+
+void NcaBodyWriter::writePlaceHolder(u64 offset, const void* ptr, u64 sz)
+{
+     if (m_writeFunc)
+     {
+          m_writeFunc(offset, (const u8*)ptr, sz);
+     }
+     else
+     {
+          ncmContentStorageWritePlaceHolder(m_contentStorage, &m_placeHoldId, offset, (void*)ptr, sz);
+     }
+}
+
 
 class NczHeader
 {
@@ -221,11 +312,22 @@ public:
                     return;
                }
 
-               crypto.seek(offset);
+               /* The counter keeps running across consecutive chunks, only seek when the caller jumps */
+               if (offset != position)
+               {
+                    crypto.seek(offset);
+               }
                crypto.encrypt(p, p, sz);
+               position = offset + sz;
+          }
+
+          const u64 end() const
+          {
+               return this->offset + this->size;
           }
 
           Aes128Ctr crypto;
+          u64 position = 0;
      };
 
      const bool isValid()
@@ -254,20 +356,183 @@ protected:
      Section m_sections[1];
 } PACKED;
 
+/* Re-encrypts NCZ body data, finding the section of each offset through an index sorted by section start */
+class NczCtrEngine
+{
+public:
+     void add(NczHeader::SectionContext* s)
+     {
+          if (s->size)
+          {
+               m_index.push_back(s);
+          }
+     }
+
+     void build()
+     {
+          std::sort(m_index.begin(), m_index.end(), [](const NczHeader::SectionContext* a, const NczHeader::SectionContext* b)
+          {
+               return a->offset < b->offset;
+          });
+          m_last = 0;
+     }
+
+     /* Encrypts in place, one AES-CTR call per section the range spans; bytes outside every section are left untouched */
+     void encrypt(u8* ptr, u64 sz, u64 offset)
+     {
+          while (sz)
+          {
+               u64 chunk = sz;
+               auto s = find(offset);
+               if (s)
+               {
+                    chunk = std::min(chunk, s->end() - offset);
+                    s->encrypt(ptr, chunk, offset);
+               }
+               else if (m_last < m_index.size() && m_index[m_last]->offset > offset)
+               {
+                    chunk = std::min(chunk, m_index[m_last]->offset - offset);
+               }
+
+               offset += chunk;
+               ptr += chunk;
+               sz -= chunk;
+          }
+     }
+
+private:
+     /* Returns the section containing the offset, or NULL leaving m_last on the next section after it */
+     NczHeader::SectionContext* find(u64 offset)
+     {
+          /* Chunks arrive in order, so the last section hit (or the one after it) almost always matches */
+          for (u64 i = m_last; i < m_index.size() && i < m_last + 2; i++)
+          {
+               if (offset < m_index[i]->offset)
+               {
+                    break;
+               }
+               if (offset < m_index[i]->end())
+               {
+                    m_last = i;
+                    return m_index[i];
+               }
+          }
+
+          auto it = std::upper_bound(m_index.begin(), m_index.end(), offset, [](u64 o, const NczHeader::SectionContext* s)
+          {
+               return o < s->offset;
+          });
+          if (it != m_index.begin() && offset < (*(it - 1))->end())
+          {
+               m_last = (it - 1) - m_index.begin();
+               return *(it - 1);
+          }
+          m_last = it - m_index.begin();
+          return NULL;
+     }
+
+     std::vector<NczHeader::SectionContext*> m_index;
+     u64 m_last = 0;
+};
+
+class NczBlockHeader
+{
+public:
+     static const u64 MAGIC = 0x4B434F4C425A434E;
+
+     const bool isValid() const
+     {
+          return m_magic == MAGIC && m_version == 2 && m_type == 1 && m_blockSizeExponent >= 14 && m_blockSizeExponent <= NCZ_BLOCK_MAX_SIZE_EXPONENT;
+     }
+
+     const u64 size() const
+     {
+          return sizeof(NczBlockHeader) - sizeof(m_compressedBlockSizes) + sizeof(u32) * m_blockCount;
+     }
+
+     const u64 blockSize() const
+     {
+          return 1ull << m_blockSizeExponent;
+     }
+
+     const u32 blockCount() const
+     {
+          return m_blockCount;
+     }
+
+     const u64 decompressedSize() const
+     {
+          return m_decompressedSize;
+     }
+
+     void init(u8 blockSizeExponent, u32 blockCount, u64 decompressedSize)
+     {
+          m_magic = MAGIC;
+          m_version = 2;
+          m_type = 1;
+          m_unused = 0;
+          m_blockSizeExponent = blockSizeExponent;
+          m_blockCount = blockCount;
+          m_decompressedSize = decompressedSize;
+     }
+
+     void setCompressedBlockSize(u32 i, u32 sz)
+     {
+          m_compressedBlockSizes[i] = sz;
+     }
+
+     const u32 compressedBlockSize(u32 i) const
+     {
+          return m_compressedBlockSizes[i];
+     }
+
+     const u64 decompressedBlockSize(u32 i) const
+     {
+          if (i + 1 < m_blockCount)
+          {
+               return blockSize();
+          }
+          return m_decompressedSize - blockSize() * (m_blockCount - 1);
+     }
+
+     /* Blocks which wouldn't get any smaller are stored as they are */
+     const bool isBlockCompressed(u32 i) const
+     {
+          return compressedBlockSize(i) < decompressedBlockSize(i);
+     }
+
+protected:
+     u64 m_magic;
+     u8 m_version;
+     u8 m_type;
+     u8 m_unused;
+     u8 m_blockSizeExponent;
+     u32 m_blockCount;
+     u64 m_decompressedSize;
+     u32 m_compressedBlockSizes[1];
+} PACKED;
+
 class NczBodyWriter : public NcaBodyWriter
 {
 public:
-     NczBodyWriter(const NcmPlaceHolderId& placeHoldId, u64 offset, NcmContentStorage* contentStorage) : NcaBodyWriter(placeHoldId, offset, contentStorage)
+     NczBodyWriter(const NcmPlaceHolderId& placeHoldId, u64 offset, NcmContentStorage* contentStorage, const NcaWriteFunction& writeFunc, NcaBufferPool& pool) : NcaBodyWriter(placeHoldId, offset, contentStorage, writeFunc, pool), m_buffer(pool.input), m_deflateBuffer(pool.output)
      {
-          buffIn = malloc(buffInSize);
-          buffOut = malloc(buffOutSize);
+          m_buffer.clear();
+          m_deflateBuffer.clear();
 
           dctx = ZSTD_createDCtx();
      }
 
      virtual ~NczBodyWriter()
      {
-          close();
+          /* Errors must be caught by calling close() explicitly, destructors can't throw */
+          try
+          {
+               close();
+          }
+          catch (...)
+          {
+          }
 
           for (auto& i : sections)
           {
@@ -283,13 +548,31 @@ public:
                ZSTD_freeDCtx(dctx);
                dctx = NULL;
           }
+
+          for (auto& i : m_blockDctxs)
+          {
+               ZSTD_freeDCtx(i);
+          }
+          m_blockDctxs.clear();
      }
 
-     bool close()
+     bool close() override
      {
-          if (this->m_buffer.size())
+          if (m_closed)
+          {
+               return true;
+          }
+          m_closed = true;
+
+          if (m_blockMode)
+          {
+               processBlocks(true);
+          }
+          else if (m_sectionsInitialized && m_buffer.size())
           {
+               /* Too short to hold a block header, so it's a solid stream */
                processChunk(m_buffer.data(), m_buffer.size());
+               m_buffer.clear();
           }
 
           flush();
@@ -306,200 +589,589 @@ public:
 
           if (m_deflateBuffer.size())
           {
-               ncmContentStorageWritePlaceHolder(m_contentStorage, &m_placeHoldId, m_offset, m_deflateBuffer.data(), m_deflateBuffer.size());
-               m_offset += m_deflateBuffer.size();
-               m_deflateBuffer.resize(0);
+               writeDecompressed(m_deflateBuffer.data(), m_deflateBuffer.size());
+               m_deflateBuffer.clear();
           }
           return true;
      }
 
-     NczHeader::SectionContext& section(u64 offset)
+     /* Re-encrypts decompressed data in place and writes it at the current offset */
+     void writeDecompressed(u8* ptr, u64 sz)
      {
-          for (u64 i = 0; i < sections.size(); i++)
-          {
-               if (offset >= sections[i]->offset && offset < sections[i]->offset + sections[i]->size)
-               {
-                    return *sections[i];
-               }
-          }
-          return *sections[0];
+          encrypt(ptr, sz, m_offset);
+          writePlaceHolder(m_offset, ptr, sz);
+          m_offset += sz;
      }
 
      bool encrypt(const void* ptr, u64 sz, u64 offset)
      {
-          const u8* start = (u8*)ptr;
-          const u8* end = start + sz;
-
-          while (start < end)
+          u64 startTick = armGetSystemTick();
+          m_ctr.encrypt((u8*)ptr, sz, offset);
+          if (m_telemetry)
           {
-               auto& s = section(offset);
-
-               u64 sectionEnd = s.offset + s.size;
-
-               u64 chunk = offset + sz > sectionEnd ? sectionEnd - offset : sz;
-
-               s.encrypt((void*)start, chunk, offset);
-
-               offset += chunk;
-               start += chunk;
-               sz -= chunk;
+               m_telemetry->AddBusy(nsp::InstallStage::Encrypt, sz, armGetSystemTick() - startTick);
           }
-
           return true;
      }
 
-     u64 processChunk(const  u8* ptr, u64 sz)
+     void processChunk(const  u8* ptr, u64 sz)
      {
           ZSTD_inBuffer input = { ptr, sz, 0 };
-          m_deflateBuffer.resize(sz);
-          m_deflateBuffer.resize(0);
+          bool outputFull = false;
 
-          while (input.pos < input.size)
+          /* zstd may still hold data after consuming all the input if it ran out of room */
+          while (input.pos < input.size || outputFull)
           {
-               ZSTD_outBuffer output = { buffOut, buffOutSize, 0 };
+               /* Decompress straight into the sink's buffer if it has one, otherwise into ours which gets encrypted and written once it's big enough */
+               u64 room = 0;
+               u8* direct = (m_outputFunc && !m_deflateBuffer.size()) ? m_outputFunc(m_offset, 1, room) : NULL;
+               ZSTD_outBuffer output = { direct ? direct : m_deflateBuffer.end(), direct ? room : m_deflateBuffer.available(), 0 };
                size_t const ret = ZSTD_decompressStream(dctx, &output, &input);
 
                if (ZSTD_isError(ret))
                {
-                    printf("%s\n", ZSTD_getErrorName(ret));
-                    return false;
+                    throw "failed to decompress NCZ data";
                }
 
-               append(m_deflateBuffer, (const u8*)buffOut, output.pos);
+               outputFull = output.pos == output.size;
 
-               if (m_deflateBuffer.size() >= NSZ_BUFFER_SZ)
+               if (direct)
                {
-                    encrypt(m_deflateBuffer.data(), m_deflateBuffer.size(), m_offset);
+                    if (output.pos)
+                    {
+                         writeDecompressed(direct, output.pos);
+                    }
+                    continue;
+               }
 
+               m_deflateBuffer.commit(output.pos);
+               if (m_deflateBuffer.size() >= NSZ_BUFFER_SZ)
+               {
                     flush();
                }
-
           }
+     }
 
-          if (m_deflateBuffer.size())
+     /* Sets up the crypto of every section from the complete NCZ section header held in m_buffer */
+     void initSections()
+     {
+          auto header = (NczHeader*)m_buffer.data();
+          for (u64 i = 0; i < header->sectionCount(); i++)
           {
-               encrypt(m_deflateBuffer.data(), m_deflateBuffer.size(), m_offset);
-
-               flush();
+               sections.push_back(new NczHeader::SectionContext(header->section(i)));
+               m_ctr.add(sections.back());
           }
-          return 1;
+          m_ctr.build();
+
+          m_sectionsInitialized = true;
+          m_buffer.clear();
      }
 
-     u64 write(const  u8* ptr, u64 sz) override
+     /* Reads the NCZ headers starting at sourceOffset and skips every block which is already fully in the placeholder.
+        Returns the source offset of the first block left to write, or 0 if the content can't be resumed (solid NCZ) */
+     u64 resume(u64 writtenSize, u64 sourceOffset, const NcaReadFunction& read)
      {
-          if (!m_sectionsInitialized)
+          /* Nothing may be flushed on destruction unless resuming succeeds */
+          m_closed = true;
+          m_buffer.clear();
+          if (read(sourceOffset, sizeof(u64) * 2, m_buffer.end()) != sizeof(u64) * 2)
           {
-               if (!m_buffer.size())
-               {
-                    append(m_buffer, ptr, sizeof(u64)*2);
-                    ptr += sizeof(u64) * 2;
-                    sz -= sizeof(u64) * 2;
-               }
-
-               auto header = (NczHeader*)m_buffer.data();
+               return 0;
+          }
+          m_buffer.commit(sizeof(u64) * 2);
 
-               if (m_buffer.size() + sz > header->size())
-               {
-                    u64 remainder = header->size() - m_buffer.size();
-                    append(m_buffer, ptr, remainder);
-                    ptr += remainder;
-                    sz -= remainder;
-               }
-               else
-               {
-                    append(m_buffer, ptr, sz);
-                    ptr += sz;
-                    sz = 0;
-               }
+          auto header = (NczHeader*)m_buffer.data();
+          if (!header->isValid())
+          {
+               return 0;
+          }
 
-               header = (NczHeader*)m_buffer.data();
+          u64 headerSize = header->size();
+          if (read(sourceOffset + m_buffer.size(), headerSize - m_buffer.size(), m_buffer.end()) != headerSize - m_buffer.size())
+          {
+               return 0;
+          }
+          m_buffer.commit(headerSize - m_buffer.size());
+          initSections();
+          sourceOffset += headerSize;
 
-               if (m_buffer.size() == header->size())
-               {
-                    for (u64 i = 0; i < header->sectionCount(); i++)
-                    {
-                         sections.push_back(new NczHeader::SectionContext(header->section(i)));
-                    }
+          /* Solid streams can't be entered halfway, the decompressor state would be missing */
+          const u64 fixedSize = sizeof(NczBlockHeader) - sizeof(u32);
+          if (read(sourceOffset, fixedSize, m_buffer.end()) != fixedSize)
+          {
+               return 0;
+          }
+          m_buffer.commit(fixedSize);
+          if (*(u64*)m_buffer.data() != NczBlockHeader::MAGIC || !((NczBlockHeader*)m_buffer.data())->isValid())
+          {
+               return 0;
+          }
 
-                    m_sectionsInitialized = true;
-                    m_buffer.resize(0);
-               }
+          headerSize = ((NczBlockHeader*)m_buffer.data())->size();
+          if (read(sourceOffset + fixedSize, headerSize - fixedSize, m_buffer.end()) != headerSize - fixedSize)
+          {
+               return 0;
+          }
+          m_buffer.commit(headerSize - fixedSize);
+          if (!detectBlockMode() || !m_blockMode)
+          {
+               return 0;
           }
+          sourceOffset += headerSize;
 
-          while (sz)
+          auto blockHeader = (const NczBlockHeader*)m_blockHeader.data();
+          u64 block = std::min((u64)blockHeader->blockCount(), (writtenSize - m_offset) / blockHeader->blockSize());
+          for (u32 i = 0; i < block; i++)
           {
-               if (m_buffer.size() + sz >= NSZ_BUFFER_SZ)
-               {
-                    u64 chunk = NSZ_BUFFER_SZ - m_buffer.size();
-                    append(m_buffer, ptr, chunk);
+               sourceOffset += blockHeader->compressedBlockSize(i);
+          }
+          m_currentBlock = block;
+          m_offset += block * blockHeader->blockSize();
+          m_buffer.clear();
+          m_closed = false;
 
-                    processChunk(m_buffer.data(), m_buffer.size());
-                    m_buffer.resize(0);
+          return sourceOffset;
+     }
 
-                    sz -= chunk;
-                    ptr += chunk;
-               }
-               else
-               {
-                    append(m_buffer, ptr, sz);
-                    sz = 0;
-               }
+     /* Returns false while more data is needed to tell whether this is a solid or a block-compressed NCZ */
+     bool detectBlockMode()
+     {
+          if (m_buffer.size() < sizeof(u64))
+          {
+               return false;
+          }
 
+          if (*(u64*)m_buffer.data() != NczBlockHeader::MAGIC)
+          {
+               m_modeDetected = true;
+               return true;
           }
 
-          return sz;
-     }
+          /* Fixed part of the header first, then the compressed block size table */
+          const u64 fixedSize = sizeof(NczBlockHeader) - sizeof(u32);
+          if (m_buffer.size() < fixedSize)
+          {
+               return false;
+          }
 
-     size_t const buffInSize = ZSTD_DStreamInSize();
-     size_t const buffOutSize = ZSTD_DStreamOutSize();
+          auto header = (NczBlockHeader*)m_buffer.data();
+          if (!header->isValid())
+          {
+               throw "invalid or unsupported NCZ block header";
+          }
 
-     void* buffIn = NULL;
-     void* buffOut = NULL;
+          if (m_buffer.size() < header->size())
+          {
+               return false;
+          }
 
-     ZSTD_DCtx* dctx = NULL;
+          m_blockHeader.assign(m_buffer.data(), m_buffer.data() + header->size());
+          m_buffer.consume(header->size());
 
-     std::vector<u8> m_buffer;
-     std::vector<u8> m_deflateBuffer;
+          header = (NczBlockHeader*)m_blockHeader.data();
 
-     bool m_sectionsInitialized = false;
+          /* A batch has to fit in the pooled buffers, which only holds if no block is stored bigger than the block size */
+          for (u32 i = 0; i < header->blockCount(); i++)
+          {
+               if (header->compressedBlockSize(i) > header->blockSize())
+               {
+                    throw "invalid NCZ block size table";
+               }
+          }
 
-     std::vector<NczHeader::SectionContext*> sections;
-};
+          m_blockWorkers = std::max(1u, hos::GetAvailableCoreCount());
+          m_batchBlocks = std::max((u64)1, std::min(m_buffer.capacity(), m_deflateBuffer.capacity()) / header->blockSize());
+          if (m_batchBlocks > m_blockWorkers)
+          {
+               m_batchBlocks -= m_batchBlocks % m_blockWorkers;
+          }
+          for (u32 i = 0; i < m_blockWorkers; i++)
+          {
+               m_blockDctxs.push_back(ZSTD_createDCtx());
+          }
+          m_blockThreads.reset(new hos::WorkerThread[m_blockWorkers]);
 
-NcaWriter::NcaWriter(const NcmContentId& contentId, NcmPlaceHolderId& placeHoldId, NcmContentStorage* contentStorage) : m_contentId(contentId), m_placeHoldId(placeHoldId), m_contentStorage(contentStorage), m_writer(NULL)
-{
-}
+          m_blockMode = true;
+          m_modeDetected = true;
+          return true;
+     }
 
-NcaWriter::~NcaWriter()
-{
-     close();
-}
+     /* Decompresses every n-th block of the current batch, so that all workers get a similar amount of work */
+     void decompressBlocks(u32 worker, u32 firstBlock, u32 count, const std::vector<u64>& srcOffsets, u8* output, const std::vector<u64>& dstOffsets)
+     {
+          auto header = (const NczBlockHeader*)m_blockHeader.data();
+          for (u32 i = worker; i < count; i += m_blockWorkers)
+          {
+               auto block = firstBlock + i;
+               auto src = m_buffer.data() + srcOffsets[i];
+               auto dst = output + dstOffsets[i];
+               auto decompressedSize = header->decompressedBlockSize(block);
 
-bool NcaWriter::close()
+               if (!header->isBlockCompressed(block))
+               {
+                    memcpy(dst, src, decompressedSize);
+                    continue;
+               }
+
+               auto ret = ZSTD_decompressDCtx(m_blockDctxs[worker], dst, decompressedSize, src, header->compressedBlockSize(block));
+               if (ZSTD_isError(ret) || ret != decompressedSize)
+               {
+                    m_blockFailed = true;
+               }
+          }
+     }
+
+     /* Decompresses all the complete blocks buffered so far in batches, then re-encrypts and flushes them in order */
+     void processBlocks(bool final)
+     {
+          auto header = (const NczBlockHeader*)m_blockHeader.data();
+
+          while (m_currentBlock < header->blockCount())
+          {
+               /* Decompress straight into the sink's buffer when it has room for a block per worker (or at least for the next block),
+                  the batch is then cut down to what fits there */
+               u64 batchBlocks = m_batchBlocks;
+               u64 room = 0;
+               u8* direct = NULL;
+               if (m_outputFunc)
+               {
+                    u64 want = header->decompressedBlockSize(m_currentBlock);
+                    for (u32 i = 1; i < m_blockWorkers && m_currentBlock + i < header->blockCount(); i++)
+                    {
+                         want += header->decompressedBlockSize(m_currentBlock + i);
+                    }
+                    direct = m_outputFunc(m_offset, want, room);
+                    if (!direct)
+                    {
+                         direct = m_outputFunc(m_offset, header->decompressedBlockSize(m_currentBlock), room);
+                    }
+               }
+               if (direct)
+               {
+                    batchBlocks = std::max((u64)1, std::min(batchBlocks, room / header->blockSize()));
+                    if (batchBlocks > m_blockWorkers)
+                    {
+                         batchBlocks -= batchBlocks % m_blockWorkers;
+                    }
+               }
+
+               u32 count = 0;
+               u64 srcSize = 0;
+               u64 dstSize = 0;
+               std::vector<u64> srcOffsets;
+               std::vector<u64> dstOffsets;
+               while (count < batchBlocks && m_currentBlock + count < header->blockCount())
+               {
+                    auto block = m_currentBlock + count;
+                    if (srcSize + header->compressedBlockSize(block) > m_buffer.size() || (direct && dstSize + header->decompressedBlockSize(block) > room))
+                    {
+                         break;
+                    }
+                    srcOffsets.push_back(srcSize);
+                    dstOffsets.push_back(dstSize);
+                    srcSize += header->compressedBlockSize(block);
+                    dstSize += header->decompressedBlockSize(block);
+                    count++;
+               }
+
+               /* Wait for a full batch unless we are at the end of the content */
+               bool lastBlocks = m_currentBlock + count == header->blockCount();
+               if (count == 0 || (count < batchBlocks && !lastBlocks && !final))
+               {
+                    break;
+               }
+
+               u8* output = direct;
+               if (!output)
+               {
+                    m_deflateBuffer.clear();
+                    m_deflateBuffer.commit(dstSize);
+                    output = m_deflateBuffer.data();
+               }
+               m_blockFailed = false;
+
+               /* The calling thread takes the first share, the rest goes to the worker threads */
+               u32 firstBlock = m_currentBlock;
+               u32 threads = std::min(m_blockWorkers, count);
+               for (u32 i = 1; i < threads; i++)
+               {
+                    auto rc = m_blockThreads[i].Start([&, i]()
+                    {
+                         decompressBlocks(i, firstBlock, count, srcOffsets, output, dstOffsets);
+                    }, hos::GetWorkerCore(i - 1));
+
+                    if (R_FAILED(rc))
+                    {
+                         m_blockThreads[i].Join();
+                         decompressBlocks(i, firstBlock, count, srcOffsets, output, dstOffsets);
+                    }
+               }
+               decompressBlocks(0, firstBlock, count, srcOffsets, output, dstOffsets);
+               for (u32 i = 1; i < threads; i++)
+               {
+                    m_blockThreads[i].Join();
+               }
+
+               if (m_blockFailed)
+               {
+                    throw "failed to decompress NCZ block";
+               }
+
+               m_buffer.consume(srcSize);
+               m_currentBlock += count;
+
+               if (direct)
+               {
+                    writeDecompressed(direct, dstSize);
+               }
+               else
+               {
+                    flush();
+               }
+          }
+
+          if (final && m_currentBlock < header->blockCount())
+          {
+               throw "truncated NCZ block data";
+          }
+     }
+
+     u64 write(const  u8* ptr, u64 sz) override
+     {
+          if (!m_sectionsInitialized)
+          {
+               if (!m_buffer.size())
+               {
+                    m_buffer.append(ptr, sizeof(u64)*2);
+                    ptr += sizeof(u64) * 2;
+                    sz -= sizeof(u64) * 2;
+
+                    if (!((NczHeader*)m_buffer.data())->isValid())
+                    {
+                         throw "invalid NCZ section header";
+                    }
+               }
+
+               auto header = (NczHeader*)m_buffer.data();
+
+               if (m_buffer.size() + sz > header->size())
+               {
+                    u64 remainder = header->size() - m_buffer.size();
+                    m_buffer.append(ptr, remainder);
+                    ptr += remainder;
+                    sz -= remainder;
+               }
+               else
+               {
+                    m_buffer.append(ptr, sz);
+                    ptr += sz;
+                    sz = 0;
+               }
+
+               header = (NczHeader*)m_buffer.data();
+
+               if (m_buffer.size() == header->size())
+               {
+                    initSections();
+               }
+          }
+
+          if (m_sectionsInitialized && !m_modeDetected)
+          {
+               u64 chunk = m_buffer.append(ptr, sz);
+               ptr += chunk;
+               sz -= chunk;
+
+               if (!detectBlockMode())
+               {
+                    if (sz)
+                    {
+                         throw "NCZ block header too large";
+                    }
+                    return 0;
+               }
+
+               /* Solid stream, whatever got buffered while detecting is just the start of it */
+               if (!m_blockMode)
+               {
+                    processChunk(m_buffer.data(), m_buffer.size());
+                    m_buffer.clear();
+               }
+          }
+
+          if (m_blockMode)
+          {
+               while (true)
+               {
+                    u64 chunk = m_buffer.append(ptr, sz);
+                    ptr += chunk;
+                    sz -= chunk;
+
+                    u32 processed = m_currentBlock;
+                    processBlocks(false);
+
+                    if (!sz)
+                    {
+                         break;
+                    }
+                    if (!chunk && processed == m_currentBlock)
+                    {
+                         throw "NCZ block does not fit in buffer";
+                    }
+               }
+               return sz;
+          }
+
+          /* Solid streams need no staging, zstd takes the data as it comes */
+          processChunk(ptr, sz);
+          return sz;
+     }
+
+     ZSTD_DCtx* dctx = NULL;
+
+     NcaBuffer& m_buffer;
+     NcaBuffer& m_deflateBuffer;
+
+     bool m_sectionsInitialized = false;
+
+     std::vector<NczHeader::SectionContext*> sections;
+     NczCtrEngine m_ctr;
+
+     bool m_closed = false;
+     bool m_modeDetected = false;
+     bool m_blockMode = false;
+     /* Set by any of the block workers */
+     std::atomic<bool> m_blockFailed = false;
+     std::vector<u8> m_blockHeader;
+     u32 m_currentBlock = 0;
+     u32 m_blockWorkers = 0;
+     u64 m_batchBlocks = 0;
+     std::vector<ZSTD_DCtx*> m_blockDctxs;
+     std::unique_ptr<hos::WorkerThread[]> m_blockThreads;
+};
+
+NcaWriter::NcaWriter(const NcmContentId& contentId, NcmPlaceHolderId& placeHoldId, NcmContentStorage* contentStorage, const NcaWriteFunction& writeFunc, NcaBufferPool* pool) : m_contentId(contentId), m_placeHoldId(placeHoldId), m_contentStorage(contentStorage), m_writeFunc(writeFunc), m_ownPool(pool ? NULL : new NcaBufferPool()), m_pool(pool ? pool : m_ownPool.get()), m_buffer(m_pool->header), m_writer(NULL), m_telemetry(NULL)
+{
+     m_buffer.clear();
+}
+
+NcaWriter::~NcaWriter()
+{
+     try
+     {
+          close();
+     }
+     catch (...)
+     {
+     }
+}
+
+bool NcaWriter::close()
 {
      if (m_writer)
      {
+          auto writer = m_writer;
           m_writer = NULL;
+          m_contentStorage = NULL;
+          writer->close();
      }
      else if(m_buffer.size())
      {
           if(isOpen())
           {
                ERR_RC_TRY(ncmContentStorageCreatePlaceHolder(m_contentStorage, &m_contentId, &m_placeHoldId, m_buffer.size()));
-               ERR_RC_TRY(ncmContentStorageWritePlaceHolder(m_contentStorage, &m_placeHoldId, 0, m_buffer.data(), m_buffer.size()));
+               if (m_writeFunc)
+               {
+                    m_writeFunc(0, m_buffer.data(), m_buffer.size());
+               }
+               else
+               {
+                    ERR_RC_TRY(ncmContentStorageWritePlaceHolder(m_contentStorage, &m_placeHoldId, 0, m_buffer.data(), m_buffer.size()));
+               }
           }
 
-          m_buffer.resize(0);
+          m_buffer.clear();
      }
      m_contentStorage = NULL;
      return true;
 }
 
+u64 NcaWriter::resume(u64 writtenSize, const NcaReadFunction& read)
+{
+     /* The header is only written once it's complete, so anything shorter means starting over */
+     if (writtenSize < NCA_HEADER_SIZE || m_writer)
+     {
+          return 0;
+     }
+
+     m_buffer.clear();
+     if (read(0, NCA_HEADER_SIZE, m_buffer.data()) != NCA_HEADER_SIZE)
+     {
+          return 0;
+     }
+     m_buffer.commit(NCA_HEADER_SIZE);
+
+     NcaHeader header;
+     memcpy(&header, m_buffer.data(), sizeof(header));
+     AesXtr crypto(keys().headerKey);
+     crypto.decrypt(&header, &header, sizeof(header), 0, 0x200);
+
+     u64 magic = 0;
+     if (header.magic != MAGIC_NCA3 || read(NCA_HEADER_SIZE, sizeof(magic), (u8*)&magic) != sizeof(magic))
+     {
+          m_buffer.clear();
+          return 0;
+     }
+
+     /* Plain NCAs map 1:1 to the placeholder */
+     if (magic != NczHeader::MAGIC)
+     {
+          setWriter(std::shared_ptr<NcaBodyWriter>(new NcaBodyWriter(m_placeHoldId, writtenSize, m_contentStorage, m_writeFunc, *m_pool)));
+          return writtenSize;
+     }
+
+     auto writer = std::shared_ptr<NczBodyWriter>(new NczBodyWriter(m_placeHoldId, NCA_HEADER_SIZE, m_contentStorage, m_writeFunc, *m_pool));
+     u64 sourceOffset = writer->resume(writtenSize, NCA_HEADER_SIZE, read);
+     if (!sourceOffset)
+     {
+          m_buffer.clear();
+          return 0;
+     }
+
+     setWriter(writer);
+     return sourceOffset;
+}
+
 bool NcaWriter::isOpen() const
 {
      return (bool)m_contentStorage;
 }
 
+void NcaWriter::setTelemetry(nsp::InstallTelemetry* telemetry)
+{
+     m_telemetry = telemetry;
+     if (m_writer)
+     {
+          m_writer->setTelemetry(telemetry);
+     }
+}
+
+void NcaWriter::setOutput(const NcaOutputFunction& outputFunc)
+{
+     m_outputFunc = outputFunc;
+     if (m_writer)
+     {
+          m_writer->setOutput(outputFunc);
+     }
+}
+
+void NcaWriter::setWriter(const std::shared_ptr<NcaBodyWriter>& writer)
+{
+     m_writer = writer;
+     m_writer->setTelemetry(m_telemetry);
+     m_writer->setOutput(m_outputFunc);
+}
+
 u64 NcaWriter::write(const  u8* ptr, u64 sz)
 {
      if (m_buffer.size() < NCA_HEADER_SIZE)
@@ -507,14 +1179,14 @@ u64 NcaWriter::write(const  u8* ptr, u64 sz)
           if (m_buffer.size() + sz > NCA_HEADER_SIZE)
           {
                u64 remainder = NCA_HEADER_SIZE - m_buffer.size();
-               append(m_buffer, ptr, remainder);
+               m_buffer.append(ptr, remainder);
 
                ptr += remainder;
                sz -= remainder;
           }
           else
           {
-               append(m_buffer, ptr, sz);
+               m_buffer.append(ptr, sz);
                ptr += sz;
                sz = 0;
           }
@@ -540,7 +1212,14 @@ u64 NcaWriter::write(const  u8* ptr, u64 sz)
 
                if(isOpen())
                {
-                    ncmContentStorageWritePlaceHolder(m_contentStorage, &m_placeHoldId, 0, m_buffer.data(), m_buffer.size());
+                    if (m_writeFunc)
+                    {
+                         m_writeFunc(0, m_buffer.data(), m_buffer.size());
+                    }
+                    else
+                    {
+                         ncmContentStorageWritePlaceHolder(m_contentStorage, &m_placeHoldId, 0, m_buffer.data(), m_buffer.size());
+                    }
                }
           }
      }
@@ -553,11 +1232,11 @@ u64 NcaWriter::write(const  u8* ptr, u64 sz)
                {
                     if (*(u64*)ptr == NczHeader::MAGIC)
                     {
-                         m_writer = std::shared_ptr<NcaBodyWriter>(new NczBodyWriter(m_placeHoldId, m_buffer.size(), m_contentStorage));
+                         setWriter(std::shared_ptr<NcaBodyWriter>(new NczBodyWriter(m_placeHoldId, m_buffer.size(), m_contentStorage, m_writeFunc, *m_pool)));
                     }
                     else
                     {
-                         m_writer = std::shared_ptr<NcaBodyWriter>(new NcaBodyWriter(m_placeHoldId, m_buffer.size(), m_contentStorage));
+                         setWriter(std::shared_ptr<NcaBodyWriter>(new NcaBodyWriter(m_placeHoldId, m_buffer.size(), m_contentStorage, m_writeFunc, *m_pool)));
                     }
                }
                else
@@ -579,3 +1258,591 @@ u64 NcaWriter::write(const  u8* ptr, u64 sz)
      return sz;
 }
 
+/* Every file read out of a section is small metadata (CNMT, NACP, icon), bound the tables/files we are willing to load */
+#define NCA_READER_MAX_TABLE_SZ 0x100000
+
+#define NCA_FS_TYPE_ROMFS 3
+#define NCA_FS_TYPE_PFS0 2
+#define NCA_CRYPT_NONE 1
+#define NCA_CRYPT_CTR 3
+
+NcaReader::NcaReader(const NcaReadFunction& read) : m_read(read), m_header(), m_key(), m_ok(false)
+{
+     if (m_read(0, sizeof(m_header), (u8*)&m_header) != sizeof(m_header))
+     {
+          return;
+     }
+
+     AesXtr crypto(keys().headerKey);
+     crypto.decrypt(&m_header, &m_header, sizeof(m_header), 0, 0x200);
+
+     if (m_header.magic != MAGIC_NCA3 || hasRightsId() || m_header.m_kaekIndex >= 3)
+     {
+          return;
+     }
+
+     /* Same derivation the system does for the key area, through spl so no keys are needed */
+     u8 masterKeyRev = std::max(m_header.m_cryptoType, m_header.m_cryptoType2);
+     if (masterKeyRev > 0)
+     {
+          masterKeyRev--;
+     }
+
+     u8 kek[0x10] = {};
+     if (R_FAILED(splCryptoGenerateAesKek(keys().keyAreaKeySources[m_header.m_kaekIndex], masterKeyRev, 0, kek)) || R_FAILED(splCryptoGenerateAesKey(kek, m_header.m_keys + (2 * 0x10), m_key)))
+     {
+          return;
+     }
+
+     for (u32 i = 0; i < 4; i++)
+     {
+          auto& entry = m_header.section_entries[i];
+          auto& fsHeader = m_header.fs_headers[i];
+
+          if (!entry.media_start_offset || entry.media_end_offset <= entry.media_start_offset)
+          {
+               continue;
+          }
+
+          if (fsHeader.crypt_type != NCA_CRYPT_NONE && fsHeader.crypt_type != NCA_CRYPT_CTR)
+          {
+               continue;
+          }
+
+          Section section;
+          section.offset = (u64)entry.media_start_offset * 0x200;
+          section.size = (u64)(entry.media_end_offset - entry.media_start_offset) * 0x200;
+          section.cryptType = fsHeader.crypt_type;
+          section.ctr = fsHeader.section_ctr;
+          m_sections.push_back(section);
+
+          try
+          {
+               if (fsHeader.fs_type == NCA_FS_TYPE_PFS0)
+               {
+                    /* PFS0 superblock: master hash (0x20), block size, always 2, hash table offset/size, then the PFS0 offset */
+                    parsePfs0(m_sections.size() - 1, *(u64*)(fsHeader.superblock_data + 0x38));
+               }
+               else if (fsHeader.fs_type == NCA_FS_TYPE_ROMFS)
+               {
+                    /* IVFC superblock: the last of the 6 levels (0x18 bytes each, from 0x10) holds the actual RomFS */
+                    parseRomfs(m_sections.size() - 1, *(u64*)(fsHeader.superblock_data + 0x10 + (5 * 0x18)));
+               }
+          }
+          catch(...)
+          {
+               /* Leave malformed sections out */
+          }
+     }
+
+     m_ok = true;
+}
+
+bool NcaReader::isOk() const
+{
+     return m_ok;
+}
+
+bool NcaReader::hasRightsId() const
+{
+     return m_header.m_rightsId[0] || m_header.m_rightsId[1];
+}
+
+u8 NcaReader::keyGeneration() const
+{
+     return std::max(m_header.m_cryptoType, m_header.m_cryptoType2);
+}
+
+std::vector<std::string> NcaReader::files() const
+{
+     std::vector<std::string> names;
+     for (auto& file : m_files)
+     {
+          names.push_back(file.name);
+     }
+     return names;
+}
+
+u64 NcaReader::fileSize(const std::string& name) const
+{
+     for (auto& file : m_files)
+     {
+          if (file.name == name)
+          {
+               return file.size;
+          }
+     }
+     return 0;
+}
+
+bool NcaReader::readFile(const std::string& name, std::vector<u8>& out, u64 maxSize)
+{
+     for (auto& file : m_files)
+     {
+          if (file.name == name)
+          {
+               u64 sz = std::min(file.size, maxSize);
+               out.resize(sz);
+               try
+               {
+                    return read(m_sections[file.section], file.offset, sz, out.data()) == sz;
+               }
+               catch(...)
+               {
+                    return false;
+               }
+          }
+     }
+     return false;
+}
+
+u64 NcaReader::read(const Section& section, u64 offset, u64 sz, u8* ptr)
+{
+     if (offset < section.offset || offset + sz > section.offset + section.size)
+     {
+          throw "NCA section read out of bounds";
+     }
+
+     u64 rsz = m_read(offset, sz, ptr);
+
+     if (section.cryptType == NCA_CRYPT_CTR)
+     {
+          Aes128Ctr crypto(m_key, AesCtr(section.ctr));
+          crypto.seek(offset);
+          crypto.decrypt(ptr, ptr, rsz);
+     }
+
+     return rsz;
+}
+
+void NcaReader::parsePfs0(u32 index, u64 offset)
+{
+     const Section& section = m_sections[index];
+     const u64 start = section.offset + offset;
+
+     struct
+     {
+          u32 magic;
+          u32 fileCount;
+          u32 stringTableSize;
+          u32 reserved;
+     } PACKED header;
+
+     struct Entry
+     {
+          u64 offset;
+          u64 size;
+          u32 stringTableOffset;
+          u32 reserved;
+     } PACKED;
+
+     if (read(section, start, sizeof(header), (u8*)&header) != sizeof(header) || header.magic != 0x30534650)
+     {
+          return;
+     }
+
+     const u64 tableSize = (u64)header.fileCount * sizeof(Entry) + header.stringTableSize;
+     if (tableSize > NCA_READER_MAX_TABLE_SZ)
+     {
+          return;
+     }
+
+     /* Entries and string table are contiguous, one read for both */
+     std::vector<u8> table(tableSize);
+     if (read(section, start + sizeof(header), tableSize, table.data()) != tableSize)
+     {
+          return;
+     }
+
+     const Entry* entries = (const Entry*)table.data();
+     const char* strings = (const char*)(table.data() + (u64)header.fileCount * sizeof(Entry));
+     const u64 dataStart = start + sizeof(header) + tableSize;
+
+     for (u32 i = 0; i < header.fileCount; i++)
+     {
+          if (entries[i].stringTableOffset >= header.stringTableSize)
+          {
+               continue;
+          }
+
+          File file;
+          file.name = std::string(strings + entries[i].stringTableOffset, strnlen(strings + entries[i].stringTableOffset, header.stringTableSize - entries[i].stringTableOffset));
+          file.section = index;
+          file.offset = dataStart + entries[i].offset;
+          file.size = entries[i].size;
+          m_files.push_back(file);
+     }
+}
+
+void NcaReader::parseRomfs(u32 index, u64 offset)
+{
+     const Section& section = m_sections[index];
+     const u64 start = section.offset + offset;
+
+     struct
+     {
+          u64 headerSize;
+          u64 dirHashTableOffset;
+          u64 dirHashTableSize;
+          u64 dirMetaTableOffset;
+          u64 dirMetaTableSize;
+          u64 fileHashTableOffset;
+          u64 fileHashTableSize;
+          u64 fileMetaTableOffset;
+          u64 fileMetaTableSize;
+          u64 dataOffset;
+     } PACKED header;
+
+     struct Entry
+     {
+          u32 parent;
+          u32 sibling;
+          u64 offset;
+          u64 size;
+          u32 hash;
+          u32 nameSize;
+     } PACKED;
+
+     if (read(section, start, sizeof(header), (u8*)&header) != sizeof(header) || header.headerSize != sizeof(header) || header.fileMetaTableSize > NCA_READER_MAX_TABLE_SZ)
+     {
+          return;
+     }
+
+     std::vector<u8> table(header.fileMetaTableSize);
+     if (read(section, start + header.fileMetaTableOffset, table.size(), table.data()) != table.size())
+     {
+          return;
+     }
+
+     /* Only files in the root directory are listed, which is where control.nacp and the icons are */
+     u64 pos = 0;
+     while (pos + sizeof(Entry) <= table.size())
+     {
+          const Entry* entry = (const Entry*)(table.data() + pos);
+          if (pos + sizeof(Entry) + entry->nameSize > table.size())
+          {
+               break;
+          }
+
+          if (entry->parent == 0)
+          {
+               File file;
+               file.name = std::string((const char*)(entry + 1), entry->nameSize);
+               file.section = index;
+               file.offset = start + header.dataOffset + entry->offset;
+               file.size = entry->size;
+               m_files.push_back(file);
+          }
+
+          pos += sizeof(Entry) + ((entry->nameSize + 3) & ~3);
+     }
+}
+
+NczCompressor::NczCompressor(const NcaReadFunction& read, u64 ncaSize, const NcaWriteFunction& write, bool solid) : NcaReader(read), m_ncaSize(ncaSize), m_write(write), m_solid(solid)
+{
+}
+
+bool NczCompressor::compress(const std::function<void(u64 done, u64 total)>& progress)
+{
+     /* Titlekey crypto can't be undone through spl (the titlekek isn't a key it derives), callers tell those NCAs apart with hasRightsId() */
+     if (!isOk() || m_ncaSize <= NCA_HEADER_SIZE)
+     {
+          return false;
+     }
+
+     try
+     {
+          std::vector<u8> header(NCA_HEADER_SIZE);
+          if (m_read(0, header.size(), header.data()) != header.size())
+          {
+               return false;
+          }
+          m_write(0, header.data(), header.size());
+
+          u64 offset = writeSectionHeader();
+          if (m_solid)
+          {
+               compressSolid(offset, progress);
+          }
+          else
+          {
+               compressBlocks(offset, progress);
+          }
+     }
+     catch(...)
+     {
+          return false;
+     }
+     return true;
+}
+
+u64 NczCompressor::readDecrypted(u64 offset, u64 sz, u8* ptr)
+{
+     if (m_read(offset, sz, ptr) != sz)
+     {
+          throw "failed to read NCA data";
+     }
+
+     /* Anything outside the CTR sections is stored as it is, NczBodyWriter leaves those bytes untouched too */
+     for (auto& section : m_sections)
+     {
+          u64 start = std::max(offset, section.offset);
+          u64 end = std::min(offset + sz, section.offset + section.size);
+          if (section.cryptType != NCA_CRYPT_CTR || start >= end)
+          {
+               continue;
+          }
+
+          Aes128Ctr crypto(m_key, AesCtr(section.ctr));
+          crypto.seek(start);
+          crypto.decrypt(ptr + (start - offset), ptr + (start - offset), end - start);
+     }
+
+     return sz;
+}
+
+u64 NczCompressor::writeSectionHeader()
+{
+     std::vector<u8> header(sizeof(u64) * 2 + sizeof(NczHeader::Section) * m_sections.size(), 0);
+     ((u64*)header.data())[0] = NczHeader::MAGIC;
+     ((u64*)header.data())[1] = m_sections.size();
+
+     auto sections = (NczHeader::Section*)(header.data() + sizeof(u64) * 2);
+     for (u64 i = 0; i < m_sections.size(); i++)
+     {
+          sections[i].offset = m_sections[i].offset;
+          sections[i].size = m_sections[i].size;
+          sections[i].cryptoType = m_sections[i].cryptType;
+          memcpy(sections[i].cryptoKey, m_key, sizeof(m_key));
+
+          /* NczHeader::SectionContext swaps the counter back when installing */
+          *(u64*)sections[i].cryptoCounter = swapEndian(m_sections[i].ctr);
+     }
+
+     m_write(NCA_HEADER_SIZE, header.data(), header.size());
+     return NCA_HEADER_SIZE + header.size();
+}
+
+/* One zstd stream for the whole body, the next chunk is read and decrypted on a worker thread while the current one gets compressed */
+void NczCompressor::compressSolid(u64 offset, const std::function<void(u64 done, u64 total)>& progress)
+{
+     auto cctx = ZSTD_createCCtx();
+     if (!cctx)
+     {
+          throw "failed to create zstd context";
+     }
+     ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, NCZ_COMPRESSION_LEVEL);
+
+     /* Only works if zstd was built with multithreading support, otherwise this fails and compression stays on this thread */
+     u32 cores = hos::GetAvailableCoreCount();
+     if (cores > 1)
+     {
+          ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, cores - 1);
+     }
+
+     const u64 total = m_ncaSize - NCA_HEADER_SIZE;
+     std::vector<u8> input[2] = { std::vector<u8>(NSZ_BUFFER_SZ), std::vector<u8>(NSZ_BUFFER_SZ) };
+     std::vector<u8> output(ZSTD_CStreamOutSize());
+     hos::WorkerThread reader;
+     bool readFailed = false;
+
+     try
+     {
+          u64 position = NCA_HEADER_SIZE;
+          u64 chunk = std::min((u64)NSZ_BUFFER_SZ, m_ncaSize - position);
+          u32 current = 0;
+          readDecrypted(position, chunk, input[current].data());
+
+          while (chunk)
+          {
+               const u64 nextPosition = position + chunk;
+               const u64 nextChunk = std::min((u64)NSZ_BUFFER_SZ, m_ncaSize - nextPosition);
+               auto readNext = [&, current, nextPosition, nextChunk]()
+               {
+                    try
+                    {
+                         readDecrypted(nextPosition, nextChunk, input[current ^ 1].data());
+                    }
+                    catch(...)
+                    {
+                         readFailed = true;
+                    }
+               };
+
+               if (nextChunk && R_FAILED(reader.Start(readNext, hos::GetWorkerCore(0))))
+               {
+                    reader.Join();
+                    readNext();
+               }
+
+               const bool last = !nextChunk;
+               ZSTD_inBuffer in = { input[current].data(), chunk, 0 };
+               while (true)
+               {
+                    ZSTD_outBuffer out = { output.data(), output.size(), 0 };
+                    auto remaining = ZSTD_compressStream2(cctx, &out, &in, last ? ZSTD_e_end : ZSTD_e_continue);
+                    if (ZSTD_isError(remaining))
+                    {
+                         throw "failed to compress NCZ data";
+                    }
+
+                    if (out.pos)
+                    {
+                         m_write(offset, output.data(), out.pos);
+                         offset += out.pos;
+                    }
+
+                    if (last ? (remaining == 0) : (in.pos == in.size))
+                    {
+                         break;
+                    }
+               }
+
+               reader.Join();
+               if (readFailed)
+               {
+                    throw "failed to read NCA data";
+               }
+
+               position = nextPosition;
+               chunk = nextChunk;
+               current ^= 1;
+               progress(position - NCA_HEADER_SIZE, total);
+          }
+     }
+     catch(...)
+     {
+          reader.Join();
+          ZSTD_freeCCtx(cctx);
+          throw;
+     }
+
+     ZSTD_freeCCtx(cctx);
+}
+
+/* Independent blocks, compressed in batches where every worker takes every n-th block (the same split NczBodyWriter decompresses them with) */
+void NczCompressor::compressBlocks(u64 offset, const std::function<void(u64 done, u64 total)>& progress)
+{
+     const u64 blockSize = 1ull << NCZ_BLOCK_SIZE_EXPONENT;
+     const u64 total = m_ncaSize - NCA_HEADER_SIZE;
+     const u32 blockCount = (total + blockSize - 1) / blockSize;
+
+     /* The size table goes before the blocks, so it's written once now to reserve its space and again when every size is known */
+     std::vector<u8> header(sizeof(NczBlockHeader) - sizeof(u32) + sizeof(u32) * blockCount, 0);
+     auto blockHeader = (NczBlockHeader*)header.data();
+     blockHeader->init(NCZ_BLOCK_SIZE_EXPONENT, blockCount, total);
+     const u64 headerOffset = offset;
+     m_write(headerOffset, header.data(), header.size());
+     offset += header.size();
+
+     const u32 workers = std::max(1u, hos::GetAvailableCoreCount());
+     const u32 batchBlocks = workers * 2;
+     const u64 bound = ZSTD_compressBound(blockSize);
+     std::vector<u8> input(batchBlocks * blockSize);
+     std::vector<u8> output(batchBlocks * bound);
+     std::vector<u64> outputSizes(batchBlocks);
+     std::vector<ZSTD_CCtx*> cctxs;
+     std::unique_ptr<hos::WorkerThread[]> threads(new hos::WorkerThread[workers]);
+     /* Set by any of the workers */
+     std::atomic<bool> failed = false;
+
+     auto compressShare = [&](u32 worker, u32 firstBlock, u32 count)
+     {
+          for (u32 i = worker; i < count; i += workers)
+          {
+               const u64 decompressedSize = blockHeader->decompressedBlockSize(firstBlock + i);
+               auto ret = ZSTD_compressCCtx(cctxs[worker], output.data() + i * bound, bound, input.data() + i * blockSize, decompressedSize, NCZ_COMPRESSION_LEVEL);
+               if (ZSTD_isError(ret))
+               {
+                    failed = true;
+                    continue;
+               }
+
+               /* Blocks that wouldn't get any smaller are stored as they are */
+               if (ret >= decompressedSize)
+               {
+                    memcpy(output.data() + i * bound, input.data() + i * blockSize, decompressedSize);
+                    ret = decompressedSize;
+               }
+               outputSizes[i] = ret;
+          }
+     };
+
+     try
+     {
+          for (u32 i = 0; i < workers; i++)
+          {
+               cctxs.push_back(ZSTD_createCCtx());
+               if (!cctxs.back())
+               {
+                    throw "failed to create zstd context";
+               }
+          }
+
+          for (u32 block = 0; block < blockCount; )
+          {
+               const u32 count = std::min(batchBlocks, blockCount - block);
+               u64 batchSize = 0;
+               for (u32 i = 0; i < count; i++)
+               {
+                    batchSize += blockHeader->decompressedBlockSize(block + i);
+               }
+               readDecrypted(NCA_HEADER_SIZE + (u64)block * blockSize, batchSize, input.data());
+
+               /* The calling thread takes the first share, the rest goes to the worker threads */
+               const u32 threadCount = std::min(workers, count);
+               for (u32 i = 1; i < threadCount; i++)
+               {
+                    auto rc = threads[i].Start([&, i, block, count]()
+                    {
+                         compressShare(i, block, count);
+                    }, hos::GetWorkerCore(i - 1));
+
+                    if (R_FAILED(rc))
+                    {
+                         threads[i].Join();
+                         compressShare(i, block, count);
+                    }
+               }
+               compressShare(0, block, count);
+               for (u32 i = 1; i < threadCount; i++)
+               {
+                    threads[i].Join();
+               }
+
+               if (failed)
+               {
+                    throw "failed to compress NCZ block";
+               }
+
+               for (u32 i = 0; i < count; i++)
+               {
+                    m_write(offset, output.data() + i * bound, outputSizes[i]);
+                    offset += outputSizes[i];
+                    blockHeader->setCompressedBlockSize(block + i, outputSizes[i]);
+               }
+
+               block += count;
+               progress(std::min((u64)block * blockSize, total), total);
+          }
+
+          m_write(headerOffset, header.data(), header.size());
+     }
+     catch(...)
+     {
+          for (u32 i = 1; i < workers; i++)
+          {
+               threads[i].Join();
+          }
+          for (auto cctx : cctxs)
+          {
+               ZSTD_freeCCtx(cctx);
+          }
+          throw;
+     }
+
+     for (auto cctx : cctxs)
+     {
+          ZSTD_freeCCtx(cctx);
+     }
+}
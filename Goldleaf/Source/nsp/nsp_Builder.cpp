@@ -29,61 +29,69 @@
 
 namespace nsp
 {
-    bool GenerateFrom(String Input, String Out, std::function<void(u64, u64)> Callback)
+    bool Build(std::vector<BuildEntry> Entries, String Out, std::function<void(u64, u64)> Callback)
     {
-        auto exp = fs::GetExplorerForPath(Input);
-        auto files = exp->GetFiles(Input);
         PFS0Header header = {};
-        header.FileCount = (u32)files.size();
+        header.FileCount = (u32)Entries.size();
         header.Magic = Magic;
-        u8 *strtable = fs::GetWorkBuffer();
-        size_t strtablesize = 0;
-        std::vector<PFS0File> fentries;
-        size_t base_offset = 0;
-        for(auto &file: files)
+        std::vector<char> strtable;
+        std::vector<PFS0FileEntry> fentries;
+        u64 base_offset = 0;
+        for(auto &entry: Entries)
         {
-            PFS0File entry = {};
-            entry.Entry.Offset = base_offset;
-            entry.Entry.StringTableOffset = strtablesize;
-            auto fsize = exp->GetFileSize(Input + "/" + file);
-            entry.Entry.Size = fsize;
-            entry.Name = file;
-            base_offset += fsize;
-            strcpy((char*)&strtable[strtablesize], file.AsUTF8().c_str());
-            strtablesize += file.length() + 1; // NUL terminated!
-            fentries.push_back(entry);
+            PFS0FileEntry fentry = {};
+            fentry.Offset = base_offset;
+            fentry.StringTableOffset = strtable.size();
+            fentry.Size = entry.Source->GetSize();
+            base_offset += fentry.Size;
+            auto name = entry.Name.AsUTF8();
+            strtable.insert(strtable.end(), name.c_str(), name.c_str() + name.length() + 1); // NUL terminated!
+            fentries.push_back(fentry);
         }
-        strtablesize = (strtablesize + 0x1f) &~ 0x1f;
-        header.StringTableSize = strtablesize;
+        strtable.resize((strtable.size() + 0x1f) &~ 0x1f, '\0');
+        header.StringTableSize = strtable.size();
         auto outexp = fs::GetExplorerForPath(Out);
         outexp->StartFile(Out, fs::FileMode::Write);
         outexp->WriteFileBlock(Out, &header, sizeof(header));
-        for(auto &entry: fentries)
+        for(auto &fentry: fentries)
         {
-            outexp->WriteFileBlock(Out, &entry.Entry, sizeof(entry.Entry));
+            outexp->WriteFileBlock(Out, &fentry, sizeof(fentry));
         }
-        outexp->WriteFileBlock(Out, strtable, strtablesize);
-        size_t done = 0;
-        for(auto &entry: fentries)
+        outexp->WriteFileBlock(Out, strtable.data(), strtable.size());
+        bool ok = true;
+        u64 done = 0;
+        u8 *buf = fs::GetWorkBuffer();
+        for(u32 i = 0; (i < Entries.size()) && ok; i++)
         {
-            size_t toread = entry.Entry.Size;
-            u8 *buf = fs::GetWorkBuffer();
-            size_t readsz = fs::WorkBufferSize;
-            size_t fdone = 0;
-            auto fentry = Input + "/" + entry.Name;
-            exp->StartFile(fentry, fs::FileMode::Read);
+            auto &source = Entries[i].Source;
+            u64 toread = fentries[i].Size;
+            u64 fdone = 0;
             while(toread)
             {
-                auto read = exp->ReadFileBlock(fentry, fdone, std::min(toread, readsz), buf);
+                auto read = source->Read(fdone, std::min(toread, (u64)fs::WorkBufferSize), buf);
+                if(read == 0)
+                {
+                    ok = false;
+                    break;
+                }
                 outexp->WriteFileBlock(Out, buf, read);
                 fdone += read;
                 done += read;
                 toread -= read;
                 Callback(done, base_offset);
             }
-            exp->EndFile(fs::FileMode::Read);
         }
         outexp->EndFile(fs::FileMode::Write);
-        return true;
+        return ok;
+    }
+
+    bool GenerateFrom(String Input, String Out, std::function<void(u64, u64)> Callback)
+    {
+        auto exp = fs::GetExplorerForPath(Input);
+        std::vector<BuildEntry> entries;
+        for(auto &file: exp->GetFiles(Input)) entries.push_back({ file, std::make_shared<fs::FileStorage>(exp, Input + "/" + file) });
+        auto ok = Build(entries, Out, Callback);
+        exp->EndFileShared();
+        return ok;
     }
 }
\ No newline at end of file
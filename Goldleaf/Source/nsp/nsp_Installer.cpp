@@ -21,6 +21,7 @@
 
 #include <nsp/nsp_Installer.hpp>
 #include <nsp/nca_Writer.hpp>
+#include <nsp/nsp_Pipeline.hpp>
 #include <err/err_Result.hpp>
 #include <fs/fs_FileSystem.hpp>
 #include <sys/stat.h>
@@ -28,7 +29,7 @@
 #include <fstream>
 #include <malloc.h>
 #include <dirent.h>
-#include <chrono>
+#include <ctime>
 
 extern cfg::Settings global_settings;
 
@@ -44,6 +45,11 @@ namespace nsp
         ERR_RC_UNLESS(pfs0_file.IsOk(), err::result::ResultInvalidNSP);
         ERR_RC_TRY(ncmOpenContentStorage(&this->cnt_storage, this->storage_id));
         ERR_RC_TRY(ncmOpenContentMetaDatabase(&this->cnt_meta_db, this->storage_id));
+        if(global_settings.reuse_other_storage_contents && !this->has_other_cnt_storage)
+        {
+            auto other_storage_id = (this->storage_id == NcmStorageId_SdCard) ? NcmStorageId_BuiltInUser : NcmStorageId_SdCard;
+            this->has_other_cnt_storage = R_SUCCEEDED(ncmOpenContentStorage(&this->other_cnt_storage, other_storage_id));
+        }
 
         String cnmt_nca_file_name;
         u32 cnmt_nca_file_idx = PFS0::InvalidFileIndex;
@@ -56,7 +62,6 @@ namespace nsp
             auto file = pfs0_files[i];
             if(fs::GetExtension(file) == "tik")
             {
-                tik_file_name = file;
                 tik_file_idx = i;
                 tik_file_size = pfs0_file.GetFileSize(i);
             }
@@ -77,33 +82,33 @@ namespace nsp
         ERR_RC_UNLESS(cnmt_nca_file_size > 0, err::result::ResultMetaNotFound);
         auto cnmt_nca_content_id = fs::GetFileName(cnmt_nca_file_name);
 
-        auto nand_sys_explorer = fs::GetNANDSystemExplorer();
-        nand_sys_explorer->CreateDirectory("Contents/temp");
-
+        // Ticket, CNMT and control data are all read straight from the package, nothing gets staged on NAND
         if(tik_file_size > 0)
         {
-            auto tik_path = nand_sys_explorer->FullPathFor("Contents/temp/" + tik_file_name);
-            this->pfs0_file.SaveFile(tik_file_idx, nand_sys_explorer, tik_path);
-            this->tik_file = hos::ReadTicket(tik_path);
+            this->tik_data.resize(tik_file_size);
+            ERR_RC_UNLESS(this->pfs0_file.ReadFromFile(tik_file_idx, 0, tik_file_size, this->tik_data.data()) == tik_file_size, err::result::ResultContentReadFailed);
+            this->tik_file = hos::ReadTicket(this->tik_data.data(), this->tik_data.size());
         }
 
-        auto cnmt_nca_temp_path = nand_sys_explorer->FullPathFor("Contents/temp/" + cnmt_nca_file_name);
-        nand_sys_explorer->DeleteFile(cnmt_nca_temp_path);
-        pfs0_file.SaveFile(cnmt_nca_file_idx, nand_sys_explorer, cnmt_nca_temp_path);
-
-        char cnmt_nca_content_path[FS_MAX_PATH] = {};
-        sprintf(cnmt_nca_content_path, "@SystemContent://temp/%s", cnmt_nca_file_name.AsUTF8().c_str());
-        FsRightsId tmp_rid;
-        ERR_RC_TRY(fsGetRightsIdAndKeyGenerationByPath(cnmt_nca_content_path, &keygen, &tmp_rid));
+        auto cnmt_nca_storage = this->pfs0_file.GetFileStorage(cnmt_nca_file_idx);
+        if(cnmt_nca_file_size <= MaxBufferedMetaSize)
+        {
+            std::vector<u8> cnmt_nca_data(cnmt_nca_file_size);
+            ERR_RC_UNLESS(cnmt_nca_storage->Read(0, cnmt_nca_file_size, cnmt_nca_data.data()) == cnmt_nca_file_size, err::result::ResultContentReadFailed);
+            cnmt_nca_storage = std::make_shared<fs::MemoryStorage>(std::move(cnmt_nca_data));
+        }
+        NcaReader cnmt_nca([&](u64 Offset, u64 Size, u8 *Out) -> u64
+        {
+            return cnmt_nca_storage->Read(Offset, Size, Out);
+        });
+        ERR_RC_UNLESS(cnmt_nca.isOk(), err::result::ResultMetaNotFound);
+        keygen = cnmt_nca.keyGeneration();
         auto systemkgen = hos::ComputeSystemKeyGeneration();
         ERR_RC_UNLESS(systemkgen >= keygen, err::result::ResultKeyGenMismatch);
 
-        FsFileSystem cnmt_nca_fs;
-        ERR_RC_TRY(fsOpenFileSystemWithId(&cnmt_nca_fs, 0, FsFileSystemType_ContentMeta, cnmt_nca_content_path));
         {
-            fs::FspExplorer cnmt_nca_fs_obj("NSP-ContentMeta", cnmt_nca_fs);
-            String cnmt_file_name;
-            for(auto &cnt: cnmt_nca_fs_obj.GetContents())
+            std::string cnmt_file_name;
+            for(auto &cnt: cnmt_nca.files())
             {
                 if(fs::GetExtension(cnt) == "cnmt")
                 {
@@ -112,12 +117,9 @@ namespace nsp
                 }
             }
             ERR_RC_UNLESS(!cnmt_file_name.empty(), err::result::ResultMetaNotFound);
-            auto cnmt_file_size = cnmt_nca_fs_obj.GetFileSize(cnmt_file_name);
-            auto cnmt_tmp_buf = fs::GetWorkBuffer();
-            cnmt_nca_fs_obj.StartFile(cnmt_file_name, fs::FileMode::Read);
-            cnmt_nca_fs_obj.ReadFileBlock(cnmt_file_name, 0, cnmt_file_size, cnmt_tmp_buf);
-            cnmt_nca_fs_obj.EndFile(fs::FileMode::Read);
-            this->cnmt = ncm::ContentMeta(cnmt_tmp_buf, cnmt_file_size);
+            std::vector<u8> cnmt_data;
+            ERR_RC_UNLESS(cnmt_nca.readFile(cnmt_file_name, cnmt_data), err::result::ResultMetaNotFound);
+            this->cnmt = ncm::ContentMeta(cnmt_data.data(), cnmt_data.size());
         }
 
         ncm::ContentRecord record = {};
@@ -125,8 +127,20 @@ namespace nsp
         *reinterpret_cast<u64*>(record.Size) = cnmt_nca_file_size;
         record.Type = ncm::ContentType::Meta;
         this->cnt_meta_key = cnmt.GetContentMetaKey();
-        ERR_RC_UNLESS(!hos::ExistsTitle(ncm::ContentMetaType::Any, Storage::SdCard, this->cnt_meta_key.id), err::result::ResultTitleAlreadyInstalled);
-        ERR_RC_UNLESS(!hos::ExistsTitle(ncm::ContentMetaType::Any, Storage::NANDUser, this->cnt_meta_key.id), err::result::ResultTitleAlreadyInstalled);
+
+        // If the last install of this same package was interrupted, the title found below is just what that install left behind
+        this->resuming = this->journal.Load() && this->journal.Matches(this->pfs0_file.GetPath(), this->pfs0_file.GetExplorer()->GetFileSizeShared(this->pfs0_file.GetPath()), this->cnt_meta_key, this->storage_id);
+        if(!this->resuming)
+        {
+            // Re-installing the same version on the same storage is a repair: the contents still intact are kept, see DoWriteContents
+            // Any other version, or a copy on the other storage, still has to be removed first
+            auto other_location = (this->storage_id == NcmStorageId_SdCard) ? Storage::NANDUser : Storage::SdCard;
+            ERR_RC_UNLESS(!hos::ExistsTitle(ncm::ContentMetaType::Any, other_location, this->cnt_meta_key.id), err::result::ResultTitleAlreadyInstalled);
+            for(auto &title: hos::SearchTitles(ncm::ContentMetaType::Any, static_cast<Storage>(this->storage_id)))
+            {
+                if(title.ApplicationId == this->cnt_meta_key.id) ERR_RC_UNLESS(title.Version == this->cnt_meta_key.version, err::result::ResultTitleAlreadyInstalled);
+            }
+        }
 
         bool has_cnmt_installed = false;
         ERR_RC_TRY(ncmContentStorageHas(&this->cnt_storage, &has_cnmt_installed, &record.ContentId));
@@ -135,9 +149,11 @@ namespace nsp
         this->base_app_id = hos::GetBaseApplicationId(this->cnt_meta_key.id, static_cast<ncm::ContentMetaType>(this->cnt_meta_key.type));
         this->nacp_data = {};
 
-        for(auto &rec: this->cnmt.GetContentRecords())
+        for(auto &hashed_rec: this->cnmt.GetHashedContentRecords())
         {
+            auto rec = hashed_rec.Record;
             this->ncas.push_back(rec);
+            this->nca_hashes.push_back(hashed_rec);
             if(rec.Type == ncm::ContentType::Control)
             {
                 auto control_nca_content_id = hos::ContentIdAsString(rec.ContentId);
@@ -145,26 +161,33 @@ namespace nsp
                 auto control_nca_file_idx = this->pfs0_file.GetFileIndexByName(control_nca_file_name);
                 if(PFS0::IsValidFileIndex(control_nca_file_idx))
                 {
-                    auto control_nca_temp_path = nand_sys_explorer->FullPathFor("Contents/temp/" + control_nca_file_name);
-                    this->pfs0_file.SaveFile(control_nca_file_idx, nand_sys_explorer, control_nca_temp_path);
-                    char control_nca_content_path[FS_MAX_PATH] = {0};
-                    sprintf(control_nca_content_path, "@SystemContent://temp/%s", control_nca_file_name.AsUTF8().c_str());
-                    FsFileSystem control_nca_fs;
-                    if(R_SUCCEEDED(fsOpenFileSystemWithId(&control_nca_fs, this->cnt_meta_key.id, FsFileSystemType_ContentControl, control_nca_content_path)))
+                    // Titlekey-encrypted control NCAs can't be read before the ticket is imported, those just show no NACP/icon
+                    auto control_nca_storage = this->pfs0_file.GetFileStorage(control_nca_file_idx);
+                    NcaReader control_nca([&](u64 Offset, u64 Size, u8 *Out) -> u64
+                    {
+                        return control_nca_storage->Read(Offset, Size, Out);
+                    });
+                    if(control_nca.isOk())
                     {
-                        fs::FspExplorer control_nca_fs_obj("NSP-Control", control_nca_fs);
-                        for(auto &cnt: control_nca_fs_obj.GetContents())
+                        std::vector<u8> control_data;
+                        for(auto &cnt: control_nca.files())
                         {
                             if(fs::GetExtension(cnt) == "dat")
                             {
-                                this->icon = "sdmc:/" + consts::Root + "/meta/" + control_nca_content_id + ".jpg";
-                                control_nca_fs_obj.CopyFile(cnt, this->icon);
+                                if(control_nca.readFile(cnt, control_data))
+                                {
+                                    this->icon = "sdmc:/" + consts::Root + "/meta/" + control_nca_content_id + ".jpg";
+                                    FILE *f = fopen(this->icon.AsUTF8().c_str(), "wb");
+                                    if(f)
+                                    {
+                                        fwrite(control_data.data(), 1, control_data.size(), f);
+                                        fclose(f);
+                                    }
+                                }
                                 break;
                             }
                         }
-                        control_nca_fs_obj.StartFile("control.nacp", fs::FileMode::Read);
-                        control_nca_fs_obj.ReadFileBlock("control.nacp", 0, sizeof(nacp_data), &nacp_data);
-                        control_nca_fs_obj.EndFile(fs::FileMode::Read);
+                        if(control_nca.readFile("control.nacp", control_data, sizeof(nacp_data))) memcpy(&nacp_data, control_data.data(), control_data.size());
                     }
                 }
             }
@@ -188,7 +211,11 @@ namespace nsp
             auto tmp_buf = reinterpret_cast<ns::ContentStorageRecord*>(fs::GetWorkBuffer());
             u32 real_count = 0;
             ERR_RC_TRY(ns::ListApplicationRecordContentMeta(0, this->base_app_id, tmp_buf, content_meta_count * sizeof(ns::ContentStorageRecord), &real_count));
-            for(u32 i = 0; i < real_count; i++) content_storage_records.push_back(tmp_buf[i]);
+            for(u32 i = 0; i < real_count; i++)
+            {
+                // A repaired title is already part of the record, it gets pushed again below
+                if(tmp_buf[i].Record.id != this->cnt_meta_key.id) content_storage_records.push_back(tmp_buf[i]);
+            }
         }
 
         ns::ContentStorageRecord content_storage_record = {};
@@ -198,16 +225,7 @@ namespace nsp
         ns::DeleteApplicationRecord(this->base_app_id);
         ERR_RC_TRY(ns::PushApplicationRecord(this->base_app_id, 3, content_storage_records.data(), content_storage_records.size() * sizeof(ns::ContentStorageRecord)));
 
-        if(this->tik_file_size > 0)
-        {
-            auto tmp_buf = fs::GetWorkBuffer();
-            auto tik_path = "Contents/temp/" + this->tik_file_name;
-            auto nand_sys_explorer = fs::GetNANDSystemExplorer();
-            nand_sys_explorer->StartFile(tik_path, fs::FileMode::Read);
-            nand_sys_explorer->ReadFileBlock(tik_path, 0, this->tik_file.GetFullSize(), tmp_buf);
-            nand_sys_explorer->EndFile(fs::FileMode::Read);
-            ERR_RC_TRY(es::ImportTicket(tmp_buf, this->tik_file_size, es::CommonCertificateData, es::CommonCertificateSize));
-        }
+        if(this->tik_file_size > 0) ERR_RC_TRY(es::ImportTicket(this->tik_data.data(), this->tik_file_size, es::CommonCertificateData, es::CommonCertificateSize));
         return err::result::ResultSuccess;
     }
 
@@ -246,16 +264,69 @@ namespace nsp
         return this->keygen;
     }
 
+    bool Installer::IsResuming()
+    {
+        return this->resuming;
+    }
+
     std::vector<ncm::ContentRecord> Installer::GetNCAs()
     {
         return this->ncas;
     }
 
+    InstallTelemetry *Installer::GetTelemetry()
+    {
+        return &this->telemetry;
+    }
+
+    u64 Installer::GetSkippedSize()
+    {
+        return this->skipped_size;
+    }
+
+    const u8 *Installer::FindContentHash(NcmContentId Id)
+    {
+        for(auto &hashed_rec: this->nca_hashes)
+        {
+            if(memcmp(hashed_rec.Record.ContentId.c, Id.c, sizeof(Id.c)) == 0) return hashed_rec.Hash;
+        }
+        return nullptr;
+    }
+
+    bool Installer::IsInstalledContentValid(NcmContentStorage *Storage, NcmContentId Id)
+    {
+        // The meta NCA has no hash to check against, but it's the one content which is never shared
+        auto hash = this->FindContentHash(Id);
+        if(hash == nullptr) return true;
+        s64 size = 0;
+        if(R_FAILED(ncmContentStorageGetSizeFromContentId(Storage, &size, &Id))) return false;
+        std::vector<u8> buf(0x400000);
+        Sha256Context ctx;
+        sha256ContextCreate(&ctx);
+        for(s64 offset = 0; offset < size;)
+        {
+            auto read_size = std::min((s64)buf.size(), size - offset);
+            if(R_FAILED(ncmContentStorageReadContentIdFile(Storage, buf.data(), read_size, &Id, offset))) return false;
+            sha256ContextUpdate(&ctx, buf.data(), read_size);
+            offset += read_size;
+        }
+        u8 content_hash[SHA256_HASH_SIZE];
+        sha256ContextGetHash(&ctx, content_hash);
+        return memcmp(content_hash, hash, SHA256_HASH_SIZE) == 0;
+    }
+
     Result Installer::WriteContents(OnContentsWriteFunction OnContentWrite)
     {
-        auto nand_sys_explorer = fs::GetNANDSystemExplorer();
-        auto read_size = fs::WorkBufferSize;
-        auto tmp_buf = fs::GetWorkBuffer();
+        this->telemetry.Start();
+        auto rc = this->DoWriteContents(OnContentWrite);
+        this->telemetry.Stop();
+        auto stats_path = "sdmc:/" + consts::InstallStats + "/" + hos::FormatApplicationId(this->cnt_meta_key.id) + "_" + std::to_string(time(nullptr)) + ".json";
+        this->telemetry.SaveSummary(stats_path, this->cnt_meta_key.id, rc);
+        return rc;
+    }
+
+    Result Installer::DoWriteContents(OnContentsWriteFunction OnContentWrite)
+    {
         u64 total_size = 0;
         u64 total_written_size = 0;
         std::vector<u32> content_file_idxs;
@@ -285,6 +356,11 @@ namespace nsp
                 return err::result::ResultInvalidNSP;
             }
         }
+        if(!this->resuming) this->journal.Begin(this->pfs0_file.GetPath(), this->pfs0_file.GetExplorer()->GetFileSizeShared(this->pfs0_file.GetPath()), this->cnt_meta_key, this->storage_id);
+        ContentPipeline pipeline(&this->cnt_storage, &this->telemetry);
+        // Decompression/re-encryption buffers, reused by every content
+        NcaBufferPool buffer_pool;
+        bool retry_from_package = false;
         for(u32 i = 0; i < this->ncas.size(); i++)
         {
             auto cnt = this->ncas[i];
@@ -296,61 +372,177 @@ namespace nsp
             NcmPlaceHolderId placehld_id = {};
             memcpy(placehld_id.uuid.uuid, cnt_id.c, 0x10);
 
-            ncmContentStorageDeletePlaceHolder(&this->cnt_storage, &placehld_id);
-            ERR_RC_TRY(ncmContentStorageCreatePlaceHolder(&this->cnt_storage, &cnt_id, &placehld_id, content_file_size));
-            NcaWriter writer(cnt_id, placehld_id, &this->cnt_storage);
-            u64 cur_written_size = 0;
-            u64 rem_size = content_file_size;
-            auto content_path = "Contents/temp/" + content_file_name;
-            switch(cnt.Type)
+            // Contents which got registered before the install was interrupted are already done
+            u64 resume_size = 0;
+            auto journal_cnt = this->journal.Find(cnt_id);
+            if(journal_cnt != nullptr)
             {
-                case ncm::ContentType::Meta:
-                case ncm::ContentType::Control:
-                    nand_sys_explorer->StartFile(content_path, fs::FileMode::Read);
-                    break;
-                default:
-                    pfs0_file.GetExplorer()->StartFile(pfs0_file.GetPath(), fs::FileMode::Read);
-                    break;
+                bool has_content = false;
+                if(journal_cnt->Registered && R_SUCCEEDED(ncmContentStorageHas(&this->cnt_storage, &has_content, &cnt_id)) && has_content)
+                {
+                    total_written_size += content_file_size;
+                    continue;
+                }
+                bool has_placehld = false;
+                if(!journal_cnt->Registered && R_SUCCEEDED(ncmContentStorageHasPlaceHolder(&this->cnt_storage, &has_placehld, &journal_cnt->PlaceHolderId)) && has_placehld)
+                {
+                    placehld_id = journal_cnt->PlaceHolderId;
+                    resume_size = journal_cnt->WrittenSize;
+                }
             }
-            while(rem_size)
+            else
             {
-                u64 tmp_read_size = 0;
-                auto proper_size = std::min(rem_size, read_size);
-                auto time_pre = std::chrono::steady_clock::now();
-                switch(cnt.Type)
+                // Shared data NCAs, re-installs and repairs: contents registered already are kept as they are, unless they're damaged
+                bool has_content = false;
+                if(R_SUCCEEDED(ncmContentStorageHas(&this->cnt_storage, &has_content, &cnt_id)) && has_content)
                 {
-                    case ncm::ContentType::Meta:
-                    case ncm::ContentType::Control:
-                        tmp_read_size = nand_sys_explorer->ReadFileBlock(content_path, cur_written_size, proper_size, tmp_buf);
-                        break;
-                    default:
-                        tmp_read_size = pfs0_file.ReadFromFile(content_file_idx, cur_written_size, proper_size, tmp_buf);
-                        break;
+                    if(this->IsInstalledContentValid(&this->cnt_storage, cnt_id))
+                    {
+                        total_written_size += content_file_size;
+                        this->skipped_size += content_file_size;
+                        OnContentWrite(cnt, i, this->ncas.size(), (double)total_written_size, (double)total_size, 0);
+                        continue;
+                    }
+                    ncmContentStorageDelete(&this->cnt_storage, &cnt_id);
                 }
-                ERR_RC_TRY(ncmContentStorageWritePlaceHolder(&this->cnt_storage, &placehld_id, cur_written_size, tmp_buf, tmp_read_size));
-                writer.write(tmp_buf, tmp_read_size);
-                cur_written_size += tmp_read_size;
-                rem_size -= tmp_read_size;
-                auto time_post = std::chrono::steady_clock::now();
-                auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(time_post - time_pre).count();
-                auto bytes_per_sec = (1000.0f / (double)(diff)) * (double)(tmp_read_size); // By elapsed time and written bytes, compute how much data has been written in 1 second
-                OnContentWrite(cnt, i, this->ncas.size(), (double)(cur_written_size + total_written_size), (double)total_size, (u64)bytes_per_sec);
             }
-            switch(cnt.Type)
+
+            // Shared reads, since another package might be getting prepared from the same explorer meanwhile
+            auto content_storage = this->pfs0_file.GetFileStorage(content_file_idx);
+
+            // A copy installed on the other storage is a plain NCA which reads faster than the package, and needs no decompression
+            // It gets verified by the pipeline's hasher while it's copied, if it turns out damaged the content is written again from the package
+            // Progress keeps being reported in package bytes, so the bar moves the same regardless of the source
+            const u64 package_file_size = content_file_size;
+            bool from_other_storage = false;
+            bool has_other_content = false;
+            if(!retry_from_package && (resume_size == 0) && this->has_other_cnt_storage && (this->FindContentHash(cnt_id) != nullptr) && R_SUCCEEDED(ncmContentStorageHas(&this->other_cnt_storage, &has_other_content, &cnt_id)) && has_other_content)
             {
-                case ncm::ContentType::Meta:
-                case ncm::ContentType::Control:
-                    nand_sys_explorer->EndFile(fs::FileMode::Read);
-                    break;
-                default:
-                    pfs0_file.GetExplorer()->EndFile(fs::FileMode::Read);
-                    break;
+                auto other_content_storage = std::make_shared<fs::ContentStorage>(&this->other_cnt_storage, cnt_id);
+                if(other_content_storage->GetSize() > 0)
+                {
+                    content_storage = other_content_storage;
+                    content_file_size = other_content_storage->GetSize();
+                    from_other_storage = true;
+                }
+            }
+            retry_from_package = false;
+            PipelineReadFunction read_fn = [&](u64 Offset, u64 Size, u8 *Out) -> u64
+            {
+                return content_storage->Read(Offset, Size, Out);
+            };
+            const double progress_scale = (double)package_file_size / (double)content_file_size;
+
+            NcaWriter writer(cnt_id, placehld_id, &this->cnt_storage, [&](u64 Offset, const u8 *Data, u64 Size)
+            {
+                pipeline.Write(Offset, Data, Size);
+            }, &buffer_pool);
+            writer.setTelemetry(&this->telemetry);
+            // NCZs are decoded right into the output ring, and the blocks of plain NCAs are handed to the writer thread as they are
+            writer.setOutput([&](u64 Offset, u64 MinSize, u64 &Size) -> u8*
+            {
+                return pipeline.AcquireOutput(Offset, MinSize, Size);
+            });
+
+            // Plain NCAs and block-compressed NCZs continue where the placeholder was left, solid NCZs start over
+            u64 start_offset = 0;
+            if(resume_size > 0)
+            {
+                try
+                {
+                    start_offset = writer.resume(resume_size, read_fn);
+                }
+                catch(...)
+                {
+                    start_offset = 0;
+                }
             }
-            writer.close();
-            total_written_size += cur_written_size;
+            if(start_offset == 0) resume_size = 0;
+
+            auto rc = err::result::ResultSuccess;
+            if(resume_size == 0)
+            {
+                ncmContentStorageDeletePlaceHolder(&this->cnt_storage, &placehld_id);
+                rc = ncmContentStorageCreatePlaceHolder(&this->cnt_storage, &cnt_id, &placehld_id, content_file_size);
+            }
+            this->journal.Update(cnt_id, placehld_id, resume_size);
+            this->journal.Save();
+
+            // The meta NCA isn't listed in the CNMT itself, so only contents with a known hash get verified
+            // Resumed contents can't be verified either, since part of their data was written in a previous run
+            const u8 *expected_hash = nullptr;
+            if((global_settings.verify_content_hashes || from_other_storage) && (start_offset == 0)) expected_hash = this->FindContentHash(cnt_id);
+
+            // Reading from the source and writing the placeholder are done by the pipeline threads, while this thread decompresses/re-encrypts
+            u64 cur_written_size = start_offset;
+            u64 checkpoint_size = resume_size;
+            if(R_SUCCEEDED(rc)) rc = pipeline.Start(placehld_id, start_offset, content_file_size, read_fn, expected_hash);
+            if(R_SUCCEEDED(rc))
+            {
+                try
+                {
+                    while(true)
+                    {
+                        auto block = pipeline.ReadBlock();
+                        if(block == nullptr) break;
+                        auto block_size = block->Size;
+                        // Re-encryption and waiting for the writer happen within write(), but they're accounted as their own stages
+                        auto nested_ticks = this->telemetry.GetBusyTicks(InstallStage::Encrypt) + this->telemetry.GetStallTicks(InstallStage::Decompress);
+                        auto decode_tick = armGetSystemTick();
+                        writer.write(block->Data, block_size);
+                        auto decode_ticks = armGetSystemTick() - decode_tick;
+                        nested_ticks = this->telemetry.GetBusyTicks(InstallStage::Encrypt) + this->telemetry.GetStallTicks(InstallStage::Decompress) - nested_ticks;
+                        this->telemetry.AddBusy(InstallStage::Decompress, block_size, decode_ticks - std::min(decode_ticks, nested_ticks));
+                        pipeline.ReleaseBlock();
+                        cur_written_size += block_size;
+                        auto written_size = pipeline.GetWrittenSize();
+                        if(written_size >= (checkpoint_size + JournalCheckpointSize))
+                        {
+                            checkpoint_size = written_size;
+                            this->journal.Update(cnt_id, placehld_id, written_size);
+                            this->journal.Save();
+                        }
+                        // Moving-window throughput of the placeholder writes, rather than the time a single block took
+                        auto bytes_per_sec = this->telemetry.GetStats(InstallStage::Write).BytesPerSec;
+                        OnContentWrite(cnt, i, this->ncas.size(), (double)cur_written_size * progress_scale + (double)total_written_size, (double)total_size, (u64)bytes_per_sec);
+                    }
+                    writer.close();
+                }
+                catch(...)
+                {
+                    // NcaWriter throws on invalid/unsupported NCA data
+                    pipeline.Abort(err::result::ResultInvalidNSP);
+                }
+                rc = pipeline.Finish();
+                if(R_SUCCEEDED(rc) && (cur_written_size != content_file_size)) rc = err::result::ResultContentReadFailed;
+            }
+            pfs0_file.GetExplorer()->EndFileShared();
+            if(R_FAILED(rc))
+            {
+                // Keep what's been written so far, unless the data itself was the problem
+                if((rc == err::result::ResultInvalidNSP) || (rc == err::result::ResultContentHashMismatch))
+                {
+                    ncmContentStorageDeletePlaceHolder(&this->cnt_storage, &placehld_id);
+                    this->journal.Update(cnt_id, placehld_id, 0);
+                    if(from_other_storage)
+                    {
+                        this->journal.Save();
+                        retry_from_package = true;
+                        i--;
+                        continue;
+                    }
+                }
+                else this->journal.Update(cnt_id, placehld_id, std::max(checkpoint_size, pipeline.GetWrittenSize()));
+                this->journal.Save();
+                return rc;
+            }
+            total_written_size += package_file_size;
             ERR_RC_TRY(ncmContentStorageRegister(&this->cnt_storage, &cnt_id, &placehld_id));
             ncmContentStorageDeletePlaceHolder(&this->cnt_storage, &placehld_id);
+            this->journal.MarkRegistered(cnt_id);
+            this->journal.Save();
         }
+        this->journal.Delete();
         return err::result::ResultSuccess;
     }
 
@@ -358,7 +550,10 @@ namespace nsp
     {
         ncmContentStorageClose(&this->cnt_storage);
         ncmContentMetaDatabaseClose(&this->cnt_meta_db);
-        auto nand_sys_explorer = fs::GetNANDSystemExplorer();
-        nand_sys_explorer->DeleteDirectory("Contents/temp");
+        if(this->has_other_cnt_storage)
+        {
+            ncmContentStorageClose(&this->other_cnt_storage);
+            this->has_other_cnt_storage = false;
+        }
     }
 }
@@ -0,0 +1,170 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+#include <nsp/nsp_Journal.hpp>
+#include <fs/fs_FileSystem.hpp>
+#include <hos/hos_Content.hpp>
+#include <iomanip>
+#include <fstream>
+
+namespace nsp
+{
+    namespace
+    {
+        std::string PlaceHolderIdAsString(const NcmPlaceHolderId &PlaceHolderId)
+        {
+            NcmContentId as_cnt_id = {};
+            memcpy(as_cnt_id.c, PlaceHolderId.uuid.uuid, sizeof(as_cnt_id.c));
+            return hos::ContentIdAsString(as_cnt_id).AsUTF8();
+        }
+
+        NcmPlaceHolderId StringAsPlaceHolderId(std::string PlaceHolderId)
+        {
+            auto as_cnt_id = hos::StringAsContentId(PlaceHolderId);
+            NcmPlaceHolderId placehld_id = {};
+            memcpy(placehld_id.uuid.uuid, as_cnt_id.c, sizeof(as_cnt_id.c));
+            return placehld_id;
+        }
+    }
+
+    InstallJournal::InstallJournal() : package_size(0), meta_key(), storage_id(NcmStorageId_None)
+    {
+    }
+
+    bool InstallJournal::Load()
+    {
+        this->contents.clear();
+        std::ifstream ifs("sdmc:/" + consts::InstallJournal);
+        if(!ifs.good()) return false;
+        auto json = JSON::parse(ifs, nullptr, false);
+        ifs.close();
+        if(json.is_discarded() || !json.is_object()) return false;
+
+        this->package_path = json.value("package", "");
+        this->package_size = json.value("packageSize", (u64)0);
+        this->meta_key.id = json.value("applicationId", (u64)0);
+        this->meta_key.version = json.value("version", (u32)0);
+        this->meta_key.type = json.value("type", (u8)0);
+        this->storage_id = static_cast<NcmStorageId>(json.value("storage", (u8)NcmStorageId_None));
+        if(json.count("contents"))
+        {
+            for(auto &cnt: json["contents"])
+            {
+                std::string cnt_id = cnt.value("contentId", "");
+                std::string placehld_id = cnt.value("placeHolderId", "");
+                if((cnt_id.length() != 32) || (placehld_id.length() != 32)) continue;
+                JournalContent journal_cnt = {};
+                journal_cnt.ContentId = hos::StringAsContentId(cnt_id);
+                journal_cnt.PlaceHolderId = StringAsPlaceHolderId(placehld_id);
+                journal_cnt.WrittenSize = cnt.value("writtenSize", (u64)0);
+                journal_cnt.Registered = cnt.value("registered", false);
+                this->contents.push_back(journal_cnt);
+            }
+        }
+        return !this->package_path.empty();
+    }
+
+    void InstallJournal::Save()
+    {
+        auto json = JSON::object();
+        json["package"] = this->package_path;
+        json["packageSize"] = this->package_size;
+        json["applicationId"] = this->meta_key.id;
+        json["version"] = this->meta_key.version;
+        json["type"] = this->meta_key.type;
+        json["storage"] = (u8)this->storage_id;
+        json["contents"] = JSON::array();
+        for(auto &cnt: this->contents)
+        {
+            auto cnt_json = JSON::object();
+            cnt_json["contentId"] = hos::ContentIdAsString(cnt.ContentId).AsUTF8();
+            cnt_json["placeHolderId"] = PlaceHolderIdAsString(cnt.PlaceHolderId);
+            cnt_json["writtenSize"] = cnt.WrittenSize;
+            cnt_json["registered"] = cnt.Registered;
+            json["contents"].push_back(cnt_json);
+        }
+        std::ofstream ofs("sdmc:/" + consts::InstallJournal, std::ios::trunc);
+        ofs << std::setw(4) << json;
+        ofs.close();
+    }
+
+    void InstallJournal::Delete()
+    {
+        this->contents.clear();
+        auto sd_exp = fs::GetSdCardExplorer();
+        sd_exp->DeleteFile(consts::InstallJournal);
+    }
+
+    bool InstallJournal::Matches(String PackagePath, u64 PackageSize, NcmContentMetaKey MetaKey, NcmStorageId StorageId)
+    {
+        return (this->package_path == PackagePath.AsUTF8()) && (this->package_size == PackageSize) && (this->meta_key.id == MetaKey.id) && (this->meta_key.version == MetaKey.version) && (this->meta_key.type == MetaKey.type) && (this->storage_id == StorageId);
+    }
+
+    void InstallJournal::Begin(String PackagePath, u64 PackageSize, NcmContentMetaKey MetaKey, NcmStorageId StorageId)
+    {
+        // The journal of an interrupted install is the only thing referring to its placeholders, which would stay on the storage forever otherwise
+        if(!this->contents.empty() && (this->storage_id != NcmStorageId_None))
+        {
+            NcmContentStorage cnt_storage = {};
+            if(R_SUCCEEDED(ncmOpenContentStorage(&cnt_storage, this->storage_id)))
+            {
+                for(auto &cnt: this->contents)
+                {
+                    if(!cnt.Registered) ncmContentStorageDeletePlaceHolder(&cnt_storage, &cnt.PlaceHolderId);
+                }
+                ncmContentStorageClose(&cnt_storage);
+            }
+        }
+        this->package_path = PackagePath.AsUTF8();
+        this->package_size = PackageSize;
+        this->meta_key = MetaKey;
+        this->storage_id = StorageId;
+        this->contents.clear();
+    }
+
+    JournalContent *InstallJournal::Find(NcmContentId ContentId)
+    {
+        for(auto &cnt: this->contents)
+        {
+            if(memcmp(cnt.ContentId.c, ContentId.c, sizeof(ContentId.c)) == 0) return &cnt;
+        }
+        return nullptr;
+    }
+
+    void InstallJournal::Update(NcmContentId ContentId, NcmPlaceHolderId PlaceHolderId, u64 WrittenSize)
+    {
+        auto cnt = this->Find(ContentId);
+        if(cnt == nullptr)
+        {
+            this->contents.push_back({});
+            cnt = &this->contents.back();
+            cnt->ContentId = ContentId;
+        }
+        cnt->PlaceHolderId = PlaceHolderId;
+        cnt->WrittenSize = WrittenSize;
+        cnt->Registered = false;
+    }
+
+    void InstallJournal::MarkRegistered(NcmContentId ContentId)
+    {
+        auto cnt = this->Find(ContentId);
+        if(cnt != nullptr) cnt->Registered = true;
+    }
+}
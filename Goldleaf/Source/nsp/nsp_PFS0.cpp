@@ -21,54 +21,80 @@
 
 #include <nsp/nsp_PFS0.hpp>
 #include <cstring>
+#include <cctype>
 
 namespace nsp
 {
-    PFS0::PFS0(fs::Explorer *Exp, String Path)
+    PFS0::PFS0(fs::Explorer *Exp, String Path, u64 Offset) : path(Path), gexp(Exp), storage(std::make_shared<fs::FileStorage>(Exp, Path))
+    {
+        this->Parse(Offset);
+        Exp->EndFileShared();
+    }
+
+    PFS0::PFS0(fs::StorageRef Storage, u64 Offset) : gexp(nullptr), storage(Storage)
+    {
+        this->Parse(Offset);
+    }
+
+    void PFS0::Parse(u64 Offset)
     {
-        this->path = Path;
-        this->gexp = Exp;
         this->ok = false;
         this->headersize = 0;
-        this->stringtable = nullptr;
-        Exp->StartFile(this->path, fs::FileMode::Read);
-        Exp->ReadFileBlock(this->path, 0, sizeof(this->header), &this->header);
-        if(this->header.Magic == Magic)
+        this->header = {};
+        // Two reads no matter how many files there are, which matters a lot over USB where every read is a round trip
+        this->storage->Read(Offset, sizeof(this->header), &this->header);
+        if((this->header.Magic == Magic) || (this->header.Magic == HFS0Magic))
         {
-            this->ok = true;
-            u64 strtoff = sizeof(PFS0Header) + (sizeof(PFS0FileEntry) * this->header.FileCount);
-            this->stringtable = new u8[this->header.StringTableSize]();
-            this->headersize = strtoff + this->header.StringTableSize;
-            Exp->ReadFileBlock(this->path, strtoff, this->header.StringTableSize, this->stringtable);
-            for(u32 i = 0; i < this->header.FileCount; i++)
+            // Both formats share the header and the start of each entry, HFS0 entries are just bigger
+            u64 entsize = (this->header.Magic == HFS0Magic) ? sizeof(HFS0FileEntry) : sizeof(PFS0FileEntry);
+            u64 strtoff = entsize * this->header.FileCount;
+            u64 tablesize = strtoff + this->header.StringTableSize;
+            if(tablesize <= MaxHeaderSize)
             {
-                u64 offset = sizeof(PFS0Header) + (i * sizeof(PFS0FileEntry));
-                PFS0FileEntry ent = {};
-                Exp->ReadFileBlock(this->path, offset, sizeof(ent), &ent);
-                String name;
-                for(u32 j = ent.StringTableOffset; j < this->header.StringTableSize; j++)
+                // In-memory storages are parsed in place
+                std::vector<u8> tables_buf;
+                auto tables = this->storage->GetBufferView(Offset + sizeof(PFS0Header), tablesize);
+                if(tables == nullptr)
                 {
-                    char ch = (char)this->stringtable[j];
-                    if(ch == '\0') break;
-                    name += ch;
+                    tables_buf.resize(tablesize);
+                    if(this->storage->Read(Offset + sizeof(PFS0Header), tablesize, tables_buf.data()) == tablesize) tables = tables_buf.data();
+                }
+                if(tables != nullptr)
+                {
+                    this->ok = true;
+                    this->headersize = Offset + sizeof(PFS0Header) + tablesize;
+                    auto stringtable = reinterpret_cast<const char*>(tables + strtoff);
+                    this->files.reserve(this->header.FileCount);
+                    for(u32 i = 0; i < this->header.FileCount; i++)
+                    {
+                        PFS0File fl = {};
+                        memcpy(&fl.Entry, tables + (i * entsize), sizeof(fl.Entry));
+                        std::string name;
+                        if(fl.Entry.StringTableOffset < this->header.StringTableSize) name = std::string(stringtable + fl.Entry.StringTableOffset, strnlen(stringtable + fl.Entry.StringTableOffset, this->header.StringTableSize - fl.Entry.StringTableOffset));
+                        fl.Name = name;
+                        this->files.push_back(fl);
+                        // Keep the first entry on duplicated names, as the linear lookup did
+                        this->name_index.emplace(NormalizeName(name), i);
+                    }
                 }
-                PFS0File fl = {};
-                fl.Entry = ent;
-                fl.Name = name;
-                this->files.push_back(fl);
             }
         }
-        Exp->EndFile(fs::FileMode::Read);
     }
 
     PFS0::~PFS0()
     {
-        if(this->stringtable != nullptr) delete[] this->stringtable;
+    }
+
+    std::string PFS0::NormalizeName(const std::string &Name)
+    {
+        std::string name = Name;
+        for(auto &ch: name) ch = std::tolower(static_cast<unsigned char>(ch));
+        return name;
     }
 
     u32 PFS0::GetCount()
     {
-        return this->header.FileCount;
+        return this->files.size();
     }
 
     String PFS0::GetFile(u32 Index)
@@ -85,7 +111,7 @@ namespace nsp
 
     u64 PFS0::ReadFromFile(u32 Index, u64 Offset, u64 Size, u8 *Out)
     {
-        return this->gexp->ReadFileBlock(this->path, (this->headersize + this->files[Index].Entry.Offset + Offset), Size, Out);
+        return this->storage->Read(this->headersize + this->files[Index].Entry.Offset + Offset, Size, Out);
     }
 
     std::vector<String> PFS0::GetFiles()
@@ -112,6 +138,25 @@ namespace nsp
         return this->files[Index].Entry.Size;
     }
 
+    u64 PFS0::GetFileOffset(u32 Index)
+    {
+        if(IsInvalidFileIndex(Index)) return 0;
+        if(Index >= this->files.size()) return 0;
+        return this->headersize + this->files[Index].Entry.Offset;
+    }
+
+    fs::StorageRef PFS0::GetStorage()
+    {
+        return this->storage;
+    }
+
+    fs::StorageRef PFS0::GetFileStorage(u32 Index)
+    {
+        if(IsInvalidFileIndex(Index)) return nullptr;
+        if(Index >= this->files.size()) return nullptr;
+        return std::make_shared<fs::SubStorage>(this->storage, this->GetFileOffset(Index), this->GetFileSize(Index));
+    }
+
     void PFS0::SaveFile(u32 Index, fs::Explorer *Exp, String Path)
     {
         if(IsInvalidFileIndex(Index)) return;
@@ -123,7 +168,6 @@ namespace nsp
         u64 off = 0;
         Exp->DeleteFile(Path);
         Exp->CreateFile(Path);
-        this->gexp->StartFile(this->path, fs::FileMode::Read);
         Exp->StartFile(Path, fs::FileMode::Write);
         while(szrem)
         {
@@ -133,24 +177,14 @@ namespace nsp
             off += rbytes;
             szrem -= rbytes;
         }
-        this->gexp->EndFile(fs::FileMode::Read);
+        if(this->gexp != nullptr) this->gexp->EndFileShared();
         Exp->EndFile(fs::FileMode::Write);
     }
 
     u32 PFS0::GetFileIndexByName(String File)
     {
-        auto found = false;
-        u32 idx = 0;
-        for(auto &file: this->files)
-        {
-            if(strcasecmp(file.Name.AsUTF8().c_str(), File.AsUTF8().c_str()) == 0)
-            {
-                found = true;
-                break;
-            }
-            idx++;
-        }
-        if(!found) return InvalidFileIndex;
-        return idx;
+        auto it = this->name_index.find(NormalizeName(File.AsUTF8()));
+        if(it == this->name_index.end()) return InvalidFileIndex;
+        return it->second;
     }
 }
\ No newline at end of file
@@ -0,0 +1,383 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <nsp/nsp_Pipeline.hpp>
+#include <err/err_Result.hpp>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace nsp
+{
+    BlockRing::BlockRing(size_t Count, size_t BlockSize) : block_count(Count), block_size(BlockSize)
+    {
+        mutexInit(&this->lock);
+        condvarInit(&this->cv);
+        this->block_data = new (std::align_val_t(PipelineBlockAlignment)) u8[Count * BlockSize];
+        this->blocks = new PipelineBlock[Count]();
+        for(size_t i = 0; i < Count; i++) this->blocks[i].Data = this->block_data + (i * BlockSize);
+        this->Reset();
+    }
+
+    BlockRing::~BlockRing()
+    {
+        delete[] this->blocks;
+        operator delete[](this->block_data, std::align_val_t(PipelineBlockAlignment));
+    }
+
+    u64 BlockRing::GetSlowestReadCount()
+    {
+        auto count = this->read_count[0];
+        for(size_t i = 1; i < this->consumer_count; i++) count = std::min(count, this->read_count[i]);
+        return count;
+    }
+
+    void BlockRing::Reset(size_t Consumers)
+    {
+        mutexLock(&this->lock);
+        this->consumer_count = std::min(std::max(Consumers, (size_t)1), PipelineMaxConsumers);
+        this->written_count = 0;
+        for(size_t i = 0; i < PipelineMaxConsumers; i++) this->read_count[i] = 0;
+        this->finished = false;
+        this->aborted = false;
+        mutexUnlock(&this->lock);
+    }
+
+    PipelineBlock *BlockRing::AcquireWrite()
+    {
+        PipelineBlock *block = nullptr;
+        mutexLock(&this->lock);
+        while(((this->written_count - this->GetSlowestReadCount()) == this->block_count) && !this->aborted) condvarWait(&this->cv, &this->lock);
+        if(!this->aborted)
+        {
+            block = &this->blocks[this->written_count % this->block_count];
+            block->Size = 0;
+            block->Offset = 0;
+        }
+        mutexUnlock(&this->lock);
+        return block;
+    }
+
+    void BlockRing::CommitWrite()
+    {
+        mutexLock(&this->lock);
+        this->written_count++;
+        condvarWakeAll(&this->cv);
+        mutexUnlock(&this->lock);
+    }
+
+    void BlockRing::Finish()
+    {
+        mutexLock(&this->lock);
+        this->finished = true;
+        condvarWakeAll(&this->cv);
+        mutexUnlock(&this->lock);
+    }
+
+    PipelineBlock *BlockRing::AcquireRead(size_t Consumer)
+    {
+        PipelineBlock *block = nullptr;
+        mutexLock(&this->lock);
+        auto &read = this->read_count[Consumer];
+        while((read == this->written_count) && !this->finished && !this->aborted) condvarWait(&this->cv, &this->lock);
+        if(!this->aborted && (read < this->written_count)) block = &this->blocks[read % this->block_count];
+        mutexUnlock(&this->lock);
+        return block;
+    }
+
+    void BlockRing::CommitRead(size_t Consumer)
+    {
+        mutexLock(&this->lock);
+        this->read_count[Consumer]++;
+        condvarWakeAll(&this->cv);
+        mutexUnlock(&this->lock);
+    }
+
+    void BlockRing::Abort()
+    {
+        mutexLock(&this->lock);
+        this->aborted = true;
+        condvarWakeAll(&this->cv);
+        mutexUnlock(&this->lock);
+    }
+
+    bool BlockRing::IsAborted()
+    {
+        mutexLock(&this->lock);
+        auto aborted = this->aborted;
+        mutexUnlock(&this->lock);
+        return aborted;
+    }
+
+    ContentPipeline::ContentPipeline(NcmContentStorage *Storage, InstallTelemetry *Telemetry) : input_ring(PipelineBlockCount, PipelineBlockSize), output_ring(PipelineBlockCount, PipelineBlockSize), cnt_storage(Storage), telemetry(Telemetry), placehld_id(), content_offset(0), content_size(0), written_size(0), cur_input(nullptr), cur_output(nullptr), verify_hash(false), rc(err::result::ResultSuccess)
+    {
+        mutexInit(&this->rc_lock);
+    }
+
+    ContentPipeline::~ContentPipeline()
+    {
+        this->input_ring.Abort();
+        this->output_ring.Abort();
+        this->reader_thread.Join();
+        this->writer_thread.Join();
+        this->hasher_thread.Join();
+    }
+
+    void ContentPipeline::SetResult(Result Res)
+    {
+        mutexLock(&this->rc_lock);
+        // Keep the first error, since it's the one which caused the rest
+        if(R_SUCCEEDED(this->rc)) this->rc = Res;
+        mutexUnlock(&this->rc_lock);
+    }
+
+    Result ContentPipeline::GetResult()
+    {
+        mutexLock(&this->rc_lock);
+        auto res = this->rc;
+        mutexUnlock(&this->rc_lock);
+        return res;
+    }
+
+    u64 ContentPipeline::GetWrittenSize()
+    {
+        mutexLock(&this->rc_lock);
+        auto size = this->written_size;
+        mutexUnlock(&this->rc_lock);
+        return size;
+    }
+
+    void ContentPipeline::AddBusy(InstallStage Stage, u64 Bytes, u64 StartTick)
+    {
+        if(this->telemetry != nullptr) this->telemetry->AddBusy(Stage, Bytes, armGetSystemTick() - StartTick);
+    }
+
+    void ContentPipeline::AddStall(InstallStage Stage, u64 StartTick)
+    {
+        if(this->telemetry != nullptr) this->telemetry->AddStall(Stage, armGetSystemTick() - StartTick);
+    }
+
+    void ContentPipeline::ReaderMain()
+    {
+        u64 offset = this->content_offset;
+        while(offset < this->content_size)
+        {
+            auto wait_tick = armGetSystemTick();
+            auto block = this->input_ring.AcquireWrite();
+            this->AddStall(InstallStage::Read, wait_tick);
+            if(block == nullptr) break;
+            auto read_size = std::min(this->content_size - offset, (u64)this->input_ring.GetBlockSize());
+            auto read_tick = armGetSystemTick();
+            auto got_size = this->read_fn(offset, read_size, block->Data);
+            this->AddBusy(InstallStage::Read, got_size, read_tick);
+            if(got_size == 0)
+            {
+                this->Abort(err::result::ResultContentReadFailed);
+                break;
+            }
+            block->Offset = offset;
+            block->Size = got_size;
+            this->input_ring.CommitWrite();
+            offset += got_size;
+        }
+        this->input_ring.Finish();
+    }
+
+    void ContentPipeline::WriterMain()
+    {
+        while(true)
+        {
+            auto wait_tick = armGetSystemTick();
+            auto block = this->output_ring.AcquireRead();
+            this->AddStall(InstallStage::Write, wait_tick);
+            if(block == nullptr) break;
+            auto write_tick = armGetSystemTick();
+            auto rc = ncmContentStorageWritePlaceHolder(this->cnt_storage, &this->placehld_id, block->Offset, block->Data, block->Size);
+            this->AddBusy(InstallStage::Write, block->Size, write_tick);
+            if(R_FAILED(rc))
+            {
+                this->Abort(rc);
+                break;
+            }
+            mutexLock(&this->rc_lock);
+            this->written_size = block->Offset + block->Size;
+            mutexUnlock(&this->rc_lock);
+            this->output_ring.CommitRead();
+        }
+    }
+
+    void ContentPipeline::HasherMain()
+    {
+        Sha256Context ctx;
+        sha256ContextCreate(&ctx);
+        u64 offset = 0;
+        while(true)
+        {
+            auto wait_tick = armGetSystemTick();
+            auto block = this->output_ring.AcquireRead(1);
+            this->AddStall(InstallStage::Hash, wait_tick);
+            if(block == nullptr) break;
+            // Writers only ever produce data sequentially, anything else can't be hashed in a single pass
+            if(block->Offset != offset)
+            {
+                this->Abort(err::result::ResultContentHashMismatch);
+                break;
+            }
+            auto hash_tick = armGetSystemTick();
+            sha256ContextUpdate(&ctx, block->Data, block->Size);
+            this->AddBusy(InstallStage::Hash, block->Size, hash_tick);
+            offset += block->Size;
+            this->output_ring.CommitRead(1);
+        }
+        sha256ContextGetHash(&ctx, this->hash);
+    }
+
+    void ContentPipeline::FlushOutput()
+    {
+        if(this->cur_output != nullptr)
+        {
+            if(this->cur_output->Size > 0) this->output_ring.CommitWrite();
+            this->cur_output = nullptr;
+        }
+    }
+
+    bool ContentPipeline::NextOutput(u64 Offset)
+    {
+        auto wait_tick = armGetSystemTick();
+        this->cur_output = this->output_ring.AcquireWrite();
+        this->AddStall(InstallStage::Decompress, wait_tick);
+        // The writer failed, nothing else to do here
+        if(this->cur_output == nullptr) return false;
+        this->cur_output->Offset = Offset;
+        return true;
+    }
+
+    Result ContentPipeline::Start(NcmPlaceHolderId PlaceHolderId, u64 Offset, u64 Size, PipelineReadFunction Read, const u8 *ExpectedHash)
+    {
+        this->verify_hash = ExpectedHash != nullptr;
+        if(this->verify_hash) memcpy(this->expected_hash, ExpectedHash, SHA256_HASH_SIZE);
+        this->input_ring.Reset();
+        this->output_ring.Reset(this->verify_hash ? 2 : 1);
+        this->placehld_id = PlaceHolderId;
+        this->content_offset = Offset;
+        this->content_size = Size;
+        this->written_size = 0;
+        this->read_fn = Read;
+        this->cur_input = nullptr;
+        this->cur_output = nullptr;
+        this->rc = err::result::ResultSuccess;
+
+        auto rc = this->reader_thread.Start(std::bind(&ContentPipeline::ReaderMain, this), hos::GetWorkerCore(0));
+        if(R_SUCCEEDED(rc)) rc = this->writer_thread.Start(std::bind(&ContentPipeline::WriterMain, this), hos::GetWorkerCore(1));
+        if(R_SUCCEEDED(rc) && this->verify_hash) rc = this->hasher_thread.Start(std::bind(&ContentPipeline::HasherMain, this), hos::GetWorkerCore(2));
+        if(R_FAILED(rc))
+        {
+            this->Abort(rc);
+            this->reader_thread.Join();
+            this->writer_thread.Join();
+        }
+        return rc;
+    }
+
+    PipelineBlock *ContentPipeline::ReadBlock()
+    {
+        auto wait_tick = armGetSystemTick();
+        this->cur_input = this->input_ring.AcquireRead();
+        this->AddStall(InstallStage::Decompress, wait_tick);
+        return this->cur_input;
+    }
+
+    void ContentPipeline::ReleaseBlock()
+    {
+        this->cur_input = nullptr;
+        this->input_ring.CommitRead();
+    }
+
+    void ContentPipeline::Write(u64 Offset, const u8 *Data, u64 Size)
+    {
+        if((this->cur_input != nullptr) && (Data == this->cur_input->Data) && (Size == this->cur_input->Size))
+        {
+            // Both blocks belong to this thread until they're committed, so the reader gets the empty one back instead
+            this->FlushOutput();
+            if(!this->NextOutput(Offset)) return;
+            std::swap(this->cur_input->Data, this->cur_output->Data);
+            this->cur_output->Size = Size;
+            this->FlushOutput();
+            return;
+        }
+
+        while(Size > 0)
+        {
+            if(this->cur_output != nullptr)
+            {
+                // Only append if the data is contiguous to the current block and it still has room left
+                auto cur_end = this->cur_output->Offset + this->cur_output->Size;
+                if((cur_end != Offset) || (this->cur_output->Size == this->output_ring.GetBlockSize())) this->FlushOutput();
+            }
+            if((this->cur_output == nullptr) && !this->NextOutput(Offset)) return;
+            auto copy_size = std::min(Size, (u64)(this->output_ring.GetBlockSize() - this->cur_output->Size));
+            auto dst = this->cur_output->Data + this->cur_output->Size;
+            // Already decoded in place
+            if(dst != Data) memcpy(dst, Data, copy_size);
+            this->cur_output->Size += copy_size;
+            Offset += copy_size;
+            Data += copy_size;
+            Size -= copy_size;
+        }
+    }
+
+    u8 *ContentPipeline::AcquireOutput(u64 Offset, u64 MinSize, u64 &Size)
+    {
+        if(MinSize > this->output_ring.GetBlockSize()) return nullptr;
+        if(this->cur_output != nullptr)
+        {
+            auto cur_end = this->cur_output->Offset + this->cur_output->Size;
+            if((cur_end != Offset) || ((this->output_ring.GetBlockSize() - this->cur_output->Size) < std::max(MinSize, (u64)1))) this->FlushOutput();
+        }
+        if((this->cur_output == nullptr) && !this->NextOutput(Offset)) return nullptr;
+        Size = this->output_ring.GetBlockSize() - this->cur_output->Size;
+        return this->cur_output->Data + this->cur_output->Size;
+    }
+
+    void ContentPipeline::Abort(Result Res)
+    {
+        this->SetResult(Res);
+        this->input_ring.Abort();
+        this->output_ring.Abort();
+    }
+
+    Result ContentPipeline::Finish()
+    {
+        if(!this->output_ring.IsAborted())
+        {
+            this->FlushOutput();
+            this->output_ring.Finish();
+        }
+        this->reader_thread.Join();
+        this->writer_thread.Join();
+        if(this->verify_hash)
+        {
+            this->hasher_thread.Join();
+            if(R_SUCCEEDED(this->GetResult()) && (memcmp(this->hash, this->expected_hash, SHA256_HASH_SIZE) != 0)) this->SetResult(err::result::ResultContentHashMismatch);
+        }
+        return this->GetResult();
+    }
+}
@@ -0,0 +1,171 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <nsp/nsp_Telemetry.hpp>
+#include <Types.hpp>
+#include <hos/hos_Titles.hpp>
+#include <fstream>
+#include <iomanip>
+#include <cstring>
+
+namespace nsp
+{
+    InstallTelemetry::InstallTelemetry()
+    {
+        mutexInit(&this->lock);
+        this->Start();
+    }
+
+    void InstallTelemetry::AddSample(StageCounters &Counters, u64 Tick)
+    {
+        if(Counters.sample_count > 0)
+        {
+            auto &last = Counters.samples[(Counters.sample_idx + TelemetrySampleCount - 1) % TelemetrySampleCount];
+            if(armTicksToNs(Tick - last.Tick) < TelemetrySampleIntervalNs) return;
+        }
+        Counters.samples[Counters.sample_idx] = { Tick, Counters.bytes };
+        Counters.sample_idx = (Counters.sample_idx + 1) % TelemetrySampleCount;
+        if(Counters.sample_count < TelemetrySampleCount) Counters.sample_count++;
+    }
+
+    void InstallTelemetry::Start()
+    {
+        mutexLock(&this->lock);
+        memset(this->stages, 0, sizeof(this->stages));
+        this->start_tick = armGetSystemTick();
+        this->end_tick = 0;
+        mutexUnlock(&this->lock);
+    }
+
+    void InstallTelemetry::Stop()
+    {
+        mutexLock(&this->lock);
+        this->end_tick = armGetSystemTick();
+        mutexUnlock(&this->lock);
+    }
+
+    void InstallTelemetry::AddBusy(InstallStage Stage, u64 Bytes, u64 Ticks)
+    {
+        mutexLock(&this->lock);
+        auto &counters = this->stages[static_cast<u32>(Stage)];
+        counters.bytes += Bytes;
+        counters.busy_ticks += Ticks;
+        this->AddSample(counters, armGetSystemTick());
+        mutexUnlock(&this->lock);
+    }
+
+    void InstallTelemetry::AddStall(InstallStage Stage, u64 Ticks)
+    {
+        mutexLock(&this->lock);
+        this->stages[static_cast<u32>(Stage)].stall_ticks += Ticks;
+        mutexUnlock(&this->lock);
+    }
+
+    u64 InstallTelemetry::GetBusyTicks(InstallStage Stage)
+    {
+        mutexLock(&this->lock);
+        auto ticks = this->stages[static_cast<u32>(Stage)].busy_ticks;
+        mutexUnlock(&this->lock);
+        return ticks;
+    }
+
+    u64 InstallTelemetry::GetStallTicks(InstallStage Stage)
+    {
+        mutexLock(&this->lock);
+        auto ticks = this->stages[static_cast<u32>(Stage)].stall_ticks;
+        mutexUnlock(&this->lock);
+        return ticks;
+    }
+
+    StageStats InstallTelemetry::GetStats(InstallStage Stage)
+    {
+        StageStats stats = {};
+        mutexLock(&this->lock);
+        auto &counters = this->stages[static_cast<u32>(Stage)];
+        stats.Bytes = counters.bytes;
+        stats.BusyNs = armTicksToNs(counters.busy_ticks);
+        stats.StallNs = armTicksToNs(counters.stall_ticks);
+        if(counters.sample_count > 0)
+        {
+            // Oldest sample still in the window against the current count, a stage which stopped producing decays to 0 once its samples get old
+            auto now = (this->end_tick != 0) ? this->end_tick : armGetSystemTick();
+            auto &oldest = counters.samples[(counters.sample_count < TelemetrySampleCount) ? 0 : counters.sample_idx];
+            auto window_ns = armTicksToNs(now - oldest.Tick);
+            if(window_ns > 0) stats.BytesPerSec = (double)(counters.bytes - oldest.Bytes) * 1000000000.0 / (double)window_ns;
+        }
+        mutexUnlock(&this->lock);
+        return stats;
+    }
+
+    u64 InstallTelemetry::GetElapsedNs()
+    {
+        mutexLock(&this->lock);
+        auto end = (this->end_tick != 0) ? this->end_tick : armGetSystemTick();
+        auto elapsed = armTicksToNs(end - this->start_tick);
+        mutexUnlock(&this->lock);
+        return elapsed;
+    }
+
+    void InstallTelemetry::SaveSummary(std::string Path, u64 ApplicationId, Result Res)
+    {
+        auto elapsed_ns = this->GetElapsedNs();
+        auto json = JSON::object();
+        json["applicationId"] = hos::FormatApplicationId(ApplicationId);
+        json["result"] = Res;
+        json["elapsedMs"] = elapsed_ns / 1000000;
+        json["stages"] = JSON::object();
+        for(u32 i = 0; i < static_cast<u32>(InstallStage::Count); i++)
+        {
+            auto stage = static_cast<InstallStage>(i);
+            auto stats = this->GetStats(stage);
+            auto stage_json = JSON::object();
+            stage_json["bytes"] = stats.Bytes;
+            stage_json["busyMs"] = stats.BusyNs / 1000000;
+            stage_json["stallMs"] = stats.StallNs / 1000000;
+            // Average over the time the stage was actually working, and over the whole install
+            stage_json["busyBytesPerSec"] = (stats.BusyNs > 0) ? (u64)((double)stats.Bytes * 1000000000.0 / (double)stats.BusyNs) : 0;
+            stage_json["bytesPerSec"] = (elapsed_ns > 0) ? (u64)((double)stats.Bytes * 1000000000.0 / (double)elapsed_ns) : 0;
+            json["stages"][GetInstallStageName(stage)] = stage_json;
+        }
+        std::ofstream ofs(Path, std::ios::trunc);
+        ofs << std::setw(4) << json;
+        ofs.close();
+    }
+
+    const char *GetInstallStageName(InstallStage Stage)
+    {
+        switch(Stage)
+        {
+            case InstallStage::Read:
+                return "read";
+            case InstallStage::Decompress:
+                return "decompress";
+            case InstallStage::Encrypt:
+                return "encrypt";
+            case InstallStage::Write:
+                return "write";
+            case InstallStage::Hash:
+                return "hash";
+            default:
+                return "";
+        }
+    }
+}
@@ -0,0 +1,57 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <nsp/nsp_XCI.hpp>
+#include <nsp/nsp_PFS0.hpp>
+
+namespace nsp
+{
+    bool IsGamecardImage(String Path)
+    {
+        auto ext = fs::GetExtension(Path);
+        return (strcasecmp(ext.AsUTF8().c_str(), "xci") == 0) || (strcasecmp(ext.AsUTF8().c_str(), "xcz") == 0);
+    }
+
+    u64 LocateSecurePartition(fs::Explorer *Exp, String Path)
+    {
+        auto image = std::make_shared<fs::FileStorage>(Exp, Path);
+        u64 secure_offset = 0;
+        for(auto base: { (u64)0, XCIKeyAreaSize })
+        {
+            u32 magic = 0;
+            image->Read(base + XCIHeaderMagicOffset, sizeof(magic), &magic);
+            if(magic != XCIHeaderMagic) continue;
+            u64 root_offset = 0;
+            image->Read(base + XCIRootPartitionOffsetOffset, sizeof(root_offset), &root_offset);
+            root_offset += base;
+            // The root is parsed as a view of the image, so the secure partition's view maps straight to its range of the file
+            PFS0 root(std::make_shared<fs::SubStorage>(image, root_offset, image->GetSize() - std::min(image->GetSize(), root_offset)));
+            if(!root.IsOk()) break;
+            auto secure_idx = root.GetFileIndexByName("secure");
+            if(!PFS0::IsValidFileIndex(secure_idx)) break;
+            fs::StorageRef secure_base;
+            root.GetFileStorage(secure_idx)->GetBaseRange(secure_base, secure_offset);
+            break;
+        }
+        Exp->EndFileShared();
+        return secure_offset;
+    }
+}
@@ -162,12 +162,15 @@ namespace ui
         }
         else if(sopt == 1)
         {
-            sopt = global_app->CreateShowDialog(cfg::strings::Main.GetString(182), cfg::strings::Main.GetString(184), { cfg::strings::Main.GetString(111), cfg::strings::Main.GetString(18) }, true);
+            sopt = global_app->CreateShowDialog(cfg::strings::Main.GetString(182), cfg::strings::Main.GetString(184), { cfg::strings::Main.GetString(111), cfg::strings::Main.GetString(448), cfg::strings::Main.GetString(449), cfg::strings::Main.GetString(18) }, true);
             if(sopt < 0) return;
-            if(sopt == 0)
+            if(sopt < 3)
             {
+                auto fmt = dump::ExportFormat::NSP;
+                if(sopt == 1) fmt = dump::ExportFormat::NSZ;
+                else if(sopt == 2) fmt = dump::ExportFormat::NSZSolid;
                 global_app->LoadLayout(global_app->GetTitleDumperLayout());
-                global_app->GetTitleDumperLayout()->StartDump(cnt, hastik);
+                global_app->GetTitleDumperLayout()->StartDump(cnt, hastik, fmt);
                 global_app->ReturnToMainMenu();
             }
         }
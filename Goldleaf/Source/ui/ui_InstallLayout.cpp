@@ -22,6 +22,8 @@
 #include <ui/ui_InstallLayout.hpp>
 #include <ui/ui_MainApplication.hpp>
 #include <iomanip>
+#include <algorithm>
+#include <memory>
 
 extern ui::MainApplication::Ref global_app;
 extern cfg::Settings global_settings;
@@ -35,15 +37,34 @@ namespace ui
         this->installText->SetColor(global_settings.custom_scheme.Text);
         this->installBar = pu::ui::elm::ProgressBar::New(340, 360, 600, 30, 100.0f);
         global_settings.ApplyProgressBarColor(this->installBar);
+        this->statsText = pu::ui::elm::TextBlock::New(150, 410, "");
+        this->statsText->SetHorizontalAlign(pu::ui::elm::HorizontalAlign::Center);
+        this->statsText->SetColor(global_settings.custom_scheme.Text);
+        this->statsText->SetFont("DefaultFont@20");
         this->Add(this->installText);
         this->Add(this->installBar);
+        this->Add(this->statsText);
     }
 
-    void InstallLayout::StartInstall(String Path, fs::Explorer *Exp, Storage Location, bool OmitConfirmation)
+    String InstallLayout::FormatTelemetry(nsp::InstallTelemetry *Telemetry)
     {
-        nsp::Installer inst(Path, Exp, Location);
+        // One line per stage which saw any data: moving-window throughput and how much of its time it spent waiting on the rest
+        String stats;
+        for(u32 i = 0; i < static_cast<u32>(nsp::InstallStage::Count); i++)
+        {
+            auto stage_stats = Telemetry->GetStats(static_cast<nsp::InstallStage>(i));
+            if(stage_stats.Bytes == 0) continue;
+            auto total_ns = stage_stats.BusyNs + stage_stats.StallNs;
+            auto stall_pct = (total_ns > 0) ? ((stage_stats.StallNs * 100) / total_ns) : 0;
+            if(!stats.empty()) stats += "\n";
+            stats += cfg::strings::Main.GetString(442 + i) + ": " + fs::FormatSize((u64)stage_stats.BytesPerSec) + "/s  (" + std::to_string(stall_pct) + "% " + cfg::strings::Main.GetString(447) + ")";
+        }
+        return stats;
+    }
 
-        auto rc = inst.PrepareInstallation();
+    bool InstallLayout::ConfirmInstall(nsp::Installer &Inst, Result PrepareResult, bool OmitConfirmation)
+    {
+        auto rc = PrepareResult;
         if(R_FAILED(rc))
         {
             if(rc == err::result::ResultTitleAlreadyInstalled)
@@ -51,28 +72,28 @@ namespace ui
                 auto sopt = global_app->CreateShowDialog(cfg::strings::Main.GetString(77), cfg::strings::Main.GetString(272) + "\n" + cfg::strings::Main.GetString(273) + "\n" + cfg::strings::Main.GetString(274), { cfg::strings::Main.GetString(111), cfg::strings::Main.GetString(18) }, true);
                 if(sopt == 0)
                 {
-                    auto title = hos::Locate(inst.GetApplicationId());
-                    if(title.ApplicationId == inst.GetApplicationId())
+                    auto title = hos::Locate(Inst.GetApplicationId());
+                    if(title.ApplicationId == Inst.GetApplicationId())
                     {
                         hos::RemoveTitle(title);
-                        inst.FinalizeInstallation();
-                        auto rc = inst.PrepareInstallation();
+                        Inst.FinalizeInstallation();
+                        auto rc = Inst.PrepareInstallation();
                         if(R_FAILED(rc))
                         {
                             HandleResult(rc, cfg::strings::Main.GetString(251));
-                            return;
+                            return false;
                         }
                     }
                 }
                 else
                 {
-                    return;
+                    return false;
                 }
             }
             else
             {
                 HandleResult(rc, cfg::strings::Main.GetString(251));
-                return;
+                return false;
             }
         }
 
@@ -82,7 +103,7 @@ namespace ui
         else
         {
             String info = cfg::strings::Main.GetString(82) + "\n\n";
-            switch(inst.GetContentMetaType())
+            switch(Inst.GetContentMetaType())
             {
                 case ncm::ContentMetaType::Application:
                     info += cfg::strings::Main.GetString(83);
@@ -98,7 +119,7 @@ namespace ui
                     break;
             }
             info += "\n";
-            auto idmask = hos::IsValidApplicationId(inst.GetApplicationId());
+            auto idmask = hos::IsValidApplicationId(Inst.GetApplicationId());
             switch(idmask)
             {
                 case hos::ApplicationIdMask::Official:
@@ -111,9 +132,9 @@ namespace ui
                     info += cfg::strings::Main.GetString(89);
                     break;
             }
-            info += "\n" + cfg::strings::Main.GetString(90) + " " + hos::FormatApplicationId(inst.GetApplicationId());
+            info += "\n" + cfg::strings::Main.GetString(90) + " " + hos::FormatApplicationId(Inst.GetApplicationId());
             info += "\n\n";
-            auto nacp = inst.GetNACP();
+            auto nacp = Inst.GetNACP();
             if(strlen(nacp->display_version) > 0)
             {
                 info += cfg::strings::Main.GetString(91) + " ";
@@ -124,7 +145,7 @@ namespace ui
                 info += hos::GetNACPVersion(nacp);
                 info += "\n\n";
             }
-            auto ncas = inst.GetNCAs();
+            auto ncas = Inst.GetNCAs();
             info += cfg::strings::Main.GetString(93) + " ";
             for(auto &nca: ncas)
             {
@@ -155,7 +176,7 @@ namespace ui
             }
             info = info.substr(0, info.length() - 2);
 
-            u8 kgen = inst.GetKeyGeneration();
+            u8 kgen = Inst.GetKeyGeneration();
             u8 masterkey = kgen - 1;
             info += "\n" + cfg::strings::Main.GetString(95) + " " + std::to_string(kgen) + " ";
             switch(masterkey)
@@ -198,9 +219,9 @@ namespace ui
                     break;
             }
 
-            if(inst.HasTicket())
+            if(Inst.HasTicket())
             {
-                auto ticket = inst.GetTicketFile();
+                auto ticket = Inst.GetTicketFile();
                 info += "\n\n" + cfg::strings::Main.GetString(94) + "\n\n";
                 info += cfg::strings::Main.GetString(235) + " " + ticket.GetTitleKey();
                 info += "\n" + cfg::strings::Main.GetString(236) + " ";
@@ -229,41 +250,110 @@ namespace ui
                 }
             }
             else info += "\n\n" + cfg::strings::Main.GetString(97);
-            int sopt = global_app->CreateShowDialog(cfg::strings::Main.GetString(77), info, { cfg::strings::Main.GetString(65), cfg::strings::Main.GetString(18) }, true, inst.GetExportedIconPath());
+            if(Inst.IsResuming()) info += "\n\n" + cfg::strings::Main.GetString(439);
+            int sopt = global_app->CreateShowDialog(cfg::strings::Main.GetString(77), info, { cfg::strings::Main.GetString(65), cfg::strings::Main.GetString(18) }, true, Inst.GetExportedIconPath());
 
             doinstall = (sopt == 0);
         }
-        
-        if(doinstall)
+        return doinstall;
+    }
+
+    void InstallLayout::StartInstall(String Path, fs::Explorer *Exp, Storage Location, bool OmitConfirmation)
+    {
+        this->StartInstallBatch({ Path }, Exp, Location, OmitConfirmation);
+    }
+
+    void InstallLayout::StartInstallBatch(std::vector<String> Paths, fs::Explorer *Exp, Storage Location, bool OmitConfirmation)
+    {
+        if(Paths.empty()) return;
+
+        // An interrupted install can only be resumed before another package replaces its journal, so it goes first
+        nsp::InstallJournal journal;
+        if(journal.Load())
         {
-            rc = inst.PreProcessContents();
-            if(R_FAILED(rc))
+            auto journal_path = std::find(Paths.begin(), Paths.end(), journal.GetPackagePath());
+            if(journal_path != Paths.end()) std::rotate(Paths.begin(), journal_path, journal_path + 1);
+        }
+
+        std::vector<u64> package_sizes;
+        u64 batch_size = 0;
+        for(auto &path: Paths)
+        {
+            auto package_size = Exp->GetFileSizeShared(path);
+            package_sizes.push_back(package_size);
+            batch_size += package_size;
+        }
+
+        // The next package gets prepared (PFS0 header parsed, CNMT and ticket read into memory) by a worker thread while the current one is written
+        std::unique_ptr<nsp::Installer> next_inst;
+        auto next_rc = err::result::ResultSuccess;
+        hos::WorkerThread prepare_thread;
+        auto prepare_fn = [&](u32 Index)
+        {
+            next_inst = std::make_unique<nsp::Installer>(Paths[Index], Exp, Location);
+            next_rc = next_inst->PrepareInstallation();
+        };
+        prepare_fn(0);
+
+        u64 batch_done_size = 0;
+        u32 installed_count = 0;
+        for(u32 i = 0; i < Paths.size(); i++)
+        {
+            prepare_thread.Join();
+            auto inst = std::move(next_inst);
+            auto prepare_next = [&]()
             {
-                HandleResult(rc, cfg::strings::Main.GetString(251));
-                return;
-            }
-            this->installText->SetText(cfg::strings::Main.GetString(146));
-            global_app->CallForRender();
-            this->installBar->SetVisible(true);
-            hos::LockAutoSleep();
-            rc = inst.WriteContents([&](ncm::ContentRecord Record, u32 Content, u32 ContentCount, double Done, double Total, u64 BytesSec)
+                if((i + 1) >= Paths.size()) return;
+                auto next_idx = i + 1;
+                if(R_FAILED(prepare_thread.Start([&, next_idx]() { prepare_fn(next_idx); }, hos::GetWorkerCore(0)))) prepare_fn(next_idx);
+            };
+
+            auto rc = err::result::ResultSuccess;
+            bool doinstall = this->ConfirmInstall(*inst, next_rc, OmitConfirmation);
+            if(doinstall)
             {
-                this->installBar->SetMaxValue(Total);
-                String name = cfg::strings::Main.GetString(148) + " \'"  + hos::ContentIdAsString(Record.ContentId);
-                if(Record.Type == ncm::ContentType::Meta) name += ".cnmt";
-                u64 speed = (u64)BytesSec;
-                u64 size = (u64)(Total - Done);
-                u64 secstime = size / speed;
-                name += ".nca\'... (" + fs::FormatSize(BytesSec) + "/s  -  " + hos::FormatTime(secstime) + ")";
-                this->installText->SetText(name);
-                this->installBar->SetProgress(Done);
-                global_app->CallForRender();
-            });
-            hos::UnlockAutoSleep();
+                rc = inst->PreProcessContents();
+                prepare_next();
+                if(R_SUCCEEDED(rc))
+                {
+                    this->installText->SetText(cfg::strings::Main.GetString(146));
+                    global_app->CallForRender();
+                    this->installBar->SetVisible(true);
+                    hos::LockAutoSleep();
+                    rc = inst->WriteContents([&](ncm::ContentRecord Record, u32 Content, u32 ContentCount, double Done, double Total, u64 BytesSec)
+                    {
+                        // A single bar for the whole batch, each package taking its share of it
+                        auto batch_progress = (double)batch_done_size;
+                        if(Total > 0) batch_progress += (Done / Total) * (double)package_sizes[i];
+                        this->installBar->SetMaxValue((double)batch_size);
+                        String name = cfg::strings::Main.GetString(148) + " \'"  + hos::ContentIdAsString(Record.ContentId);
+                        if(Record.Type == ncm::ContentType::Meta) name += ".cnmt";
+                        u64 speed = (u64)BytesSec;
+                        u64 size = (u64)((double)batch_size - batch_progress);
+                        u64 secstime = (speed > 0) ? (size / speed) : 0;
+                        name += ".nca\'... (" + fs::FormatSize(BytesSec) + "/s  -  " + hos::FormatTime(secstime) + ")";
+                        if(Paths.size() > 1) name += "\n" + cfg::strings::Main.GetString(440) + " " + std::to_string(i + 1) + "/" + std::to_string(Paths.size());
+                        if(inst->GetSkippedSize() > 0) name += "\n" + cfg::strings::Main.GetString(452) + ": " + fs::FormatSize(inst->GetSkippedSize());
+                        this->installText->SetText(name);
+                        this->installBar->SetProgress(batch_progress);
+                        this->statsText->SetText(this->FormatTelemetry(inst->GetTelemetry()));
+                        global_app->CallForRender();
+                    });
+                    hos::UnlockAutoSleep();
+                }
+            }
+            else prepare_next();
+
+            // The worker fills next_inst and next_rc and reads through the same explorer, so it's waited for before this installer closes its ncm sessions and an error dialog blocks this thread
+            prepare_thread.Join();
+            inst.reset();
+            batch_done_size += package_sizes[i];
+            if(R_FAILED(rc)) HandleResult(rc, cfg::strings::Main.GetString(251));
+            else if(doinstall) installed_count++;
         }
         this->installBar->SetVisible(false);
+        this->statsText->SetText("");
         global_app->CallForRender();
-        if(R_FAILED(rc)) HandleResult(rc, cfg::strings::Main.GetString(251));
-        else if(doinstall) global_app->ShowNotification(cfg::strings::Main.GetString(150));
+        if(installed_count > 0) global_app->ShowNotification(cfg::strings::Main.GetString(150));
     }
 }
\ No newline at end of file
@@ -106,6 +106,8 @@ namespace ui
         this->exploreMenu->SetOnInput(std::bind(&MainApplication::exploreMenu_Input, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         this->pcExplore = PCExploreLayout::New();
         this->pcExplore->SetOnInput(std::bind(&MainApplication::pcExplore_Input, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        this->usbBenchmark = USBBenchmarkLayout::New();
+        this->usbBenchmark->SetOnInput(std::bind(&MainApplication::usbBenchmark_Input, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         this->nspInstall = InstallLayout::New();
         this->contentInformation = ContentInformationLayout::New();
         this->contentInformation->SetOnInput(std::bind(&MainApplication::contentInformation_Input, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
@@ -135,6 +137,7 @@ namespace ui
         MAINAPP_MENU_SET_BASE(this->browser);
         MAINAPP_MENU_SET_BASE(this->exploreMenu);
         MAINAPP_MENU_SET_BASE(this->pcExplore);
+        MAINAPP_MENU_SET_BASE(this->usbBenchmark);
         MAINAPP_MENU_SET_BASE(this->fileContent);
         MAINAPP_MENU_SET_BASE(this->copy);
         MAINAPP_MENU_SET_BASE(this->nspInstall);
@@ -383,6 +386,15 @@ namespace ui
         }
     }
 
+    void MainApplication::usbBenchmark_Input(u64 down, u64 up, u64 held)
+    {
+        if(down & KEY_B)
+        {
+            this->LoadMenuHead(cfg::strings::Main.GetString(278));
+            this->LoadLayout(this->pcExplore);
+        }
+    }
+
     void MainApplication::fileContent_Input(u64 down, u64 up, u64 held)
     {
         if(down & KEY_B) this->LoadLayout(this->browser);
@@ -504,6 +516,11 @@ namespace ui
         return this->pcExplore;
     }
 
+    USBBenchmarkLayout::Ref &MainApplication::GetUSBBenchmarkLayout()
+    {
+        return this->usbBenchmark;
+    }
+
     InstallLayout::Ref &MainApplication::GetInstallLayout()
     {
         return this->nspInstall;
@@ -87,6 +87,11 @@ namespace ui
         fselitm->SetIcon(global_settings.PathForResource("/FileSystem/File.png"));
         fselitm->AddOnClick(std::bind(&PCExploreLayout::fileSelect_Click, this));
         this->pathsMenu->AddItem(fselitm);
+        auto benchitm = pu::ui::elm::MenuItem::New(cfg::strings::Main.GetString(453));
+        benchitm->SetColor(global_settings.custom_scheme.Text);
+        benchitm->SetIcon(global_settings.PathForResource("/Common/USB.png"));
+        benchitm->AddOnClick(std::bind(&PCExploreLayout::benchmark_Click, this));
+        this->pathsMenu->AddItem(benchitm);
         this->pathsMenu->SetSelectedIndex(0);
     }
 
@@ -103,4 +108,15 @@ namespace ui
         auto rc = usb::ProcessCommand<usb::CommandId::SelectFile>(usb::OutString(selfile));
         if(R_SUCCEEDED(rc)) global_app->GetBrowserLayout()->HandleFileDirectly(selfile);
     }
+
+    void PCExploreLayout::benchmark_Click()
+    {
+        global_app->LoadMenuHead(cfg::strings::Main.GetString(453));
+        global_app->LoadLayout(global_app->GetUSBBenchmarkLayout());
+        if(!global_app->GetUSBBenchmarkLayout()->RunBenchmark())
+        {
+            global_app->LoadMenuHead(cfg::strings::Main.GetString(278));
+            global_app->LoadLayout(global_app->GetPCExploreLayout());
+        }
+    }
 }
\ No newline at end of file
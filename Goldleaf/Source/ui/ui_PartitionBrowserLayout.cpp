@@ -91,7 +91,10 @@ namespace ui
 
     void PartitionBrowserLayout::UpdateElements(int Idx)
     {
-        this->elems = this->gexp->GetContents();
+        // The listing already says what each entry is, so no path has to be checked again (slow on remote explorers)
+        auto entries = this->gexp->GetContentEntries();
+        this->elems.clear();
+        for(auto &entry: entries) this->elems.push_back(entry.Name);
         this->browseMenu->ClearItems();
         global_app->LoadMenuHead(this->gexp->GetPresentableCwd());
         if(this->elems.empty())
@@ -103,15 +106,16 @@ namespace ui
         {
             this->browseMenu->SetVisible(true);
             this->dirEmptyText->SetVisible(false);
-            for(auto &itm: this->elems)
+            for(auto &entry: entries)
             {
+                auto &itm = entry.Name;
                 auto mitm = pu::ui::elm::MenuItem::New(itm);
                 mitm->SetColor(global_settings.custom_scheme.Text);
-                if(this->gexp->IsDirectory(itm)) mitm->SetIcon(global_settings.PathForResource("/FileSystem/Directory.png"));
+                if(entry.IsDirectory) mitm->SetIcon(global_settings.PathForResource("/FileSystem/Directory.png"));
                 else
                 {
                     auto ext = LowerCaseString(fs::GetExtension(itm));
-                    if(ext == "nsp" || ext == "nsz") mitm->SetIcon(global_settings.PathForResource("/FileSystem/NSP.png"));
+                    if(ext == "nsp" || ext == "nsz" || ext == "xci" || ext == "xcz") mitm->SetIcon(global_settings.PathForResource("/FileSystem/NSP.png"));
                     else if(ext == "nro") mitm->SetIcon(global_settings.PathForResource("/FileSystem/NRO.png"));
                     else if(ext == "tik") mitm->SetIcon(global_settings.PathForResource("/FileSystem/TIK.png"));
                     else if(ext == "cert") mitm->SetIcon(global_settings.PathForResource("/FileSystem/CERT.png"));
@@ -187,6 +191,7 @@ namespace ui
             auto ext = LowerCaseString(fs::GetExtension(item));
             auto msg = cfg::strings::Main.GetString(52) + " ";
             if(ext == "nsp" || ext == "nsz") msg += cfg::strings::Main.GetString(53);
+            else if(ext == "xci" || ext == "xcz") msg += cfg::strings::Main.GetString(441);
             else if(ext == "nro") msg += cfg::strings::Main.GetString(54);
             else if(ext == "tik") msg += cfg::strings::Main.GetString(55);
             else if(ext == "nxtheme") msg += cfg::strings::Main.GetString(56);
@@ -198,7 +203,7 @@ namespace ui
             const auto is_bin = this->gexp->IsFileBinary(fullitm);
             std::vector<String> vopts;
             u32 copt = 5;
-            if(ext == "nsp" || ext == "nsz")
+            if(ext == "nsp" || ext == "nsz" || ext == "xci" || ext == "xcz")
             {
                 vopts.push_back(cfg::strings::Main.GetString(65));
                 copt++;
@@ -246,7 +251,7 @@ namespace ui
             auto sopt = global_app->CreateShowDialog(cfg::strings::Main.GetString(76), msg, vopts, true);
             if(sopt < 0) return;
             int osopt = sopt;
-            if(ext == "nsp" || ext == "nsz")
+            if(ext == "nsp" || ext == "nsz" || ext == "xci" || ext == "xcz")
             {
                 switch(sopt)
                 {
@@ -507,7 +512,7 @@ namespace ui
             {
                 auto path = fullitm + "/" + file;
                 auto ext = LowerCaseString(fs::GetExtension(path));
-                if(ext == "nsp" || ext == "nsz") nsps.push_back(file);
+                if(ext == "nsp" || ext == "nsz" || ext == "xci" || ext == "xcz") nsps.push_back(file);
             }
             std::vector<String> extraopts = { cfg::strings::Main.GetString(281) };
             if(!nsps.empty()) extraopts.push_back(cfg::strings::Main.GetString(282));
@@ -607,23 +612,24 @@ namespace ui
                             Storage dst = Storage::SdCard;
                             if(sopt == 0) dst = Storage::SdCard;
                             else if(sopt == 1) dst = Storage::NANDUser;
+                            std::vector<String> batch_nsps;
+                            u64 batch_size = 0;
                             for(auto &nsp_path: nsps)
                             {
                                 auto nsp = fullitm + "/" + nsp_path;
-                                auto pnsp = pfullitm + "/" + nsp_path;
-                                
-                                u64 fsize = this->gexp->GetFileSize(nsp);
-                                u64 rsize = fs::GetFreeSpaceForPartition(static_cast<fs::Partition>(dst));
-                                if(rsize < fsize)
-                                {
-                                    HandleResult(err::result::ResultNotEnoughSize, cfg::strings::Main.GetString(251));
-                                    return;
-                                }
-                                global_app->LoadMenuHead(cfg::strings::Main.GetString(145) + " " + pnsp);
-                                global_app->LoadLayout(global_app->GetInstallLayout());
-                                global_app->GetInstallLayout()->StartInstall(nsp, this->gexp, dst, true);
-                                global_app->LoadLayout(global_app->GetBrowserLayout());
+                                batch_size += this->gexp->GetFileSize(nsp);
+                                batch_nsps.push_back(nsp);
+                            }
+                            u64 rsize = fs::GetFreeSpaceForPartition(static_cast<fs::Partition>(dst));
+                            if(rsize < batch_size)
+                            {
+                                HandleResult(err::result::ResultNotEnoughSize, cfg::strings::Main.GetString(251));
+                                return;
                             }
+                            global_app->LoadMenuHead(cfg::strings::Main.GetString(145) + " " + pfullitm);
+                            global_app->LoadLayout(global_app->GetInstallLayout());
+                            global_app->GetInstallLayout()->StartInstallBatch(batch_nsps, this->gexp, dst, true);
+                            global_app->LoadLayout(global_app->GetBrowserLayout());
                             global_app->LoadMenuHead(this->gexp->GetPresentableCwd());
                             break;
                     }
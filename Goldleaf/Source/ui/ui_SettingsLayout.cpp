@@ -55,6 +55,8 @@ namespace ui
     {
         String msg = cfg::strings::Main.GetString(354) + ":\n";
         msg += String("\n" + cfg::strings::Main.GetString(355) + ": ") + (global_settings.ignore_required_fw_ver ? cfg::strings::Main.GetString(111) : cfg::strings::Main.GetString(112));
+        msg += String("\n" + cfg::strings::Main.GetString(438) + ": ") + (global_settings.verify_content_hashes ? cfg::strings::Main.GetString(111) : cfg::strings::Main.GetString(112));
+        msg += String("\n" + cfg::strings::Main.GetString(451) + ": ") + (global_settings.reuse_other_storage_contents ? cfg::strings::Main.GetString(111) : cfg::strings::Main.GetString(112));
         if(!global_settings.external_romfs.empty()) msg += "\n" + cfg::strings::Main.GetString(356) + ": 'SdCard:/" + global_settings.external_romfs + "'";
         global_app->CreateShowDialog(cfg::strings::Main.GetString(357), msg, { cfg::strings::Main.GetString(234) }, true);
     }
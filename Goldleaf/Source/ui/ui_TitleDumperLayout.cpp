@@ -39,7 +39,7 @@ namespace ui
         this->Add(this->ncaBar);
     }
 
-    void TitleDumperLayout::StartDump(hos::Title &Target, bool HasTicket)
+    void TitleDumperLayout::StartDump(hos::Title &Target, bool HasTicket, dump::ExportFormat Format)
     {
         EnsureDirectories();
         global_app->CallForRender();
@@ -82,238 +82,71 @@ namespace ui
             serviceClose(&cmdb.s);
             return;
         }
-        String smeta = dump::GetNCAIdPath(&cst, &meta);
-        NcmContentId program;
-        ok = dump::GetNCAId(&cmdb, &mrec, Target.ApplicationId, dump::NCAType::Program, &program);
-        bool hasprogram = ok;
-        String sprogram;
-        if(ok) sprogram = dump::GetNCAIdPath(&cst, &program);
-        NcmContentId control;
-        ok = dump::GetNCAId(&cmdb, &mrec, Target.ApplicationId, dump::NCAType::Control, &control);
-        bool hascontrol = ok;
-        String scontrol;
-        if(ok) scontrol = dump::GetNCAIdPath(&cst, &control);
-        NcmContentId linfo;
-        ok = dump::GetNCAId(&cmdb, &mrec, Target.ApplicationId, dump::NCAType::LegalInfo, &linfo);
-        bool haslinfo = ok;
-        String slinfo;
-        if(ok) slinfo = dump::GetNCAIdPath(&cst, &linfo);
-        NcmContentId hoff;
-        ok = dump::GetNCAId(&cmdb, &mrec, Target.ApplicationId, dump::NCAType::OfflineHtml, &hoff);
-        bool hashoff = ok;
-        String shoff;
-        if(ok) shoff = dump::GetNCAIdPath(&cst, &hoff);
 
-        NcmContentId data;
-        ok = dump::GetNCAId(&cmdb, &mrec, Target.ApplicationId, dump::NCAType::Data, &data);
-        bool hasdata = ok;
-        String sdata;
-        if(ok) sdata = dump::GetNCAIdPath(&cst, &data);
+        // Contents are read through ncm wherever they are installed (which also takes care of SD card NAX0 crypto), and streamed straight into the NSP
+        std::vector<nsp::BuildEntry> entries;
+        for(auto &file: sd_exp->GetFiles(outdir)) entries.push_back({ file, std::make_shared<fs::FileStorage>(sd_exp, outdir + "/" + file) });
+        entries.push_back({ hos::ContentIdAsString(meta) + ".cnmt.nca", std::make_shared<fs::ContentStorage>(&cst, meta) });
 
         hos::LockAutoSleep();
-
-        String xprogram = sprogram;
-        String xmeta = smeta;
-        String xcontrol = scontrol;
-        String xlinfo = slinfo;
-        String xhoff = shoff;
-        String xdata = sdata;
-        if(stid == NcmStorageId_SdCard)
+        bool solid = (Format == dump::ExportFormat::NSZSolid);
+        std::vector<String> uncompressed;
+        for(auto type: { dump::NCAType::Program, dump::NCAType::Control, dump::NCAType::LegalInfo, dump::NCAType::OfflineHtml, dump::NCAType::Data })
         {
-            this->dumpText->SetText(cfg::strings::Main.GetString(194));
-            xmeta = outdir + "/" + hos::ContentIdAsString(meta) + ".cnmt.nca";
-            fs::CreateConcatenationFile(xmeta);
-            this->ncaBar->SetVisible(true);
-            dump::DecryptCopyNAX0ToNCA(&cst, meta, xmeta, [&](double Done, double Total)
-            {
-                this->ncaBar->SetMaxValue(Total);
-                this->ncaBar->SetProgress(Done);
-                global_app->CallForRender();
-            });
-            this->ncaBar->SetVisible(false);
-            if(hasprogram)
-            {
-                xprogram = outdir + "/" + hos::ContentIdAsString(program) + ".nca";
-                fs::CreateConcatenationFile(xprogram);
-                this->ncaBar->SetVisible(true);
-                dump::DecryptCopyNAX0ToNCA(&cst, program, xprogram, [&](double Done, double Total)
-                {
-                    this->ncaBar->SetMaxValue(Total);
-                    this->ncaBar->SetProgress(Done);
-                    global_app->CallForRender();
-                });
-                this->ncaBar->SetVisible(false);
-            }
-            if(hascontrol)
-            {
-                xcontrol = outdir + "/" + hos::ContentIdAsString(control) + ".nca";
-                fs::CreateConcatenationFile(xcontrol);
-                this->ncaBar->SetVisible(true);
-                dump::DecryptCopyNAX0ToNCA(&cst, control, xcontrol, [&](double Done, double Total)
-                {
-                    this->ncaBar->SetMaxValue(Total);
-                    this->ncaBar->SetProgress(Done);
-                    global_app->CallForRender();
-                });
-                this->ncaBar->SetVisible(false);
-            }
-            if(haslinfo)
-            {
-                xlinfo = outdir + "/" + hos::ContentIdAsString(linfo) + ".nca";
-                fs::CreateConcatenationFile(xlinfo);
-                this->ncaBar->SetVisible(true);
-                dump::DecryptCopyNAX0ToNCA(&cst, linfo, xlinfo, [&](double Done, double Total)
-                {
-                    this->ncaBar->SetMaxValue(Total);
-                    this->ncaBar->SetProgress(Done);
-                    global_app->CallForRender();
-                });
-                this->ncaBar->SetVisible(false);
-            }
-            if(hashoff)
-            {
-                xhoff = outdir + "/" + hos::ContentIdAsString(hoff) + ".nca";
-                fs::CreateConcatenationFile(xhoff);
-                this->ncaBar->SetVisible(true);
-                dump::DecryptCopyNAX0ToNCA(&cst, hoff, xhoff, [&](double Done, double Total)
-                {
-                    this->ncaBar->SetMaxValue(Total);
-                    this->ncaBar->SetProgress(Done);
-                    global_app->CallForRender();
-                });
-                this->ncaBar->SetVisible(false);
-            }
-            if(hasdata)
+            NcmContentId cnt_id;
+            if(!dump::GetNCAId(&cmdb, &mrec, Target.ApplicationId, type, &cnt_id)) continue;
+            auto cnt_name = hos::ContentIdAsString(cnt_id);
+            auto cnt_storage = std::make_shared<fs::ContentStorage>(&cst, cnt_id);
+
+            // NCZs need their compressed size before they can be placed in the NSP, so those are the only thing staged on the SD card
+            // Meta and control NCAs stay as they are, the installer reads them directly
+            if((Format != dump::ExportFormat::NSP) && (type != dump::NCAType::Control))
             {
-                xdata = outdir + "/" + hos::ContentIdAsString(data) + ".nca";
-                fs::CreateConcatenationFile(xdata);
+                this->dumpText->SetText(cfg::strings::Main.GetString(450));
+                String ncz = outdir + "/" + cnt_name + ".ncz";
                 this->ncaBar->SetVisible(true);
-                dump::DecryptCopyNAX0ToNCA(&cst, data, xdata, [&](double Done, double Total)
+                auto res = dump::CompressNCAToNCZ(cnt_storage, ncz, solid, [&](double Done, double Total)
                 {
                     this->ncaBar->SetMaxValue(Total);
                     this->ncaBar->SetProgress(Done);
                     global_app->CallForRender();
                 });
                 this->ncaBar->SetVisible(false);
-            }
-        }
-        else
-        {
-            fs::Explorer *nexp = nullptr;
-            if(stid == NcmStorageId_BuiltInSystem) nexp = fs::GetNANDSystemExplorer();
-            else if(stid == NcmStorageId_BuiltInUser) nexp = fs::GetNANDUserExplorer();
-            else
-            {
-                HandleResult(err::result::ResultCouldNotLocateTitleContents, cfg::strings::Main.GetString(198));
-                global_app->LoadLayout(global_app->GetContentManagerLayout());
-                serviceClose(&cst.s);
-                serviceClose(&cmdb.s);
-                hos::UnlockAutoSleep();
-                return;
-            }
-            this->dumpText->SetText(cfg::strings::Main.GetString(195));
-            xmeta = nexp->FullPathFor("Contents/" + xmeta.substr(15));
-            String txmeta = outdir + "/" + hos::ContentIdAsString(meta) + ".cnmt.nca";
-            fs::CreateConcatenationFile(txmeta);
-            this->ncaBar->SetVisible(true);
-            fs::CopyFileProgress(xmeta, txmeta, [&](double done, double total)
-            {
-                this->ncaBar->SetMaxValue(total);
-                this->ncaBar->SetProgress(done);
-                global_app->CallForRender();
-            });
-            this->ncaBar->SetVisible(false);
-            xmeta = txmeta;
-            if(hasprogram)
-            {
-                xprogram = nexp->FullPathFor("Contents/" + xprogram.substr(15));
-                String txprogram = outdir + "/" + hos::ContentIdAsString(program) + ".nca";
-                fs::CreateConcatenationFile(txprogram);
-                this->ncaBar->SetVisible(true);
-                fs::CopyFileProgress(xprogram, txprogram, [&](double done, double total)
-                {
-                    this->ncaBar->SetMaxValue(total);
-                    this->ncaBar->SetProgress(done);
-                    global_app->CallForRender();
-                });
-                this->ncaBar->SetVisible(false);
-                xprogram = txprogram;
-            }
-            if(hascontrol)
-            {
-                xcontrol = nexp->FullPathFor("Contents/" + xcontrol.substr(15));
-                String txcontrol = outdir + "/" + hos::ContentIdAsString(control) + ".nca";
-                fs::CreateConcatenationFile(txcontrol);
-                this->ncaBar->SetVisible(true);
-                fs::CopyFileProgress(xcontrol, txcontrol, [&](double done, double total)
-                {
-                    this->ncaBar->SetMaxValue(total);
-                    this->ncaBar->SetProgress(done);
-                    global_app->CallForRender();
-                });
-                this->ncaBar->SetVisible(false);
-                xcontrol = txcontrol;
-            }
-            if(haslinfo)
-            {
-                xlinfo = nexp->FullPathFor("Contents/" + xlinfo.substr(15));
-                String txlinfo = outdir + "/" + hos::ContentIdAsString(linfo) + ".nca";
-                fs::CreateConcatenationFile(txlinfo);
-                this->ncaBar->SetVisible(true);
-                fs::CopyFileProgress(xlinfo, txlinfo, [&](double done, double total)
-                {
-                    this->ncaBar->SetMaxValue(total);
-                    this->ncaBar->SetProgress(done);
-                    global_app->CallForRender();
-                });
-                this->ncaBar->SetVisible(false);
-                xlinfo = txlinfo;
-            }
-            if(hashoff)
-            {
-                xhoff = nexp->FullPathFor("Contents/" + xhoff.substr(15));
-                String txhoff = outdir + "/" + hos::ContentIdAsString(hoff) + ".nca";
-                fs::CreateConcatenationFile(txhoff);
-                this->ncaBar->SetVisible(true);
-                fs::CopyFileProgress(xhoff, txhoff, [&](double done, double total)
+                if(res == dump::CompressResult::Compressed)
                 {
-                    this->ncaBar->SetMaxValue(total);
-                    this->ncaBar->SetProgress(done);
-                    global_app->CallForRender();
-                });
-                this->ncaBar->SetVisible(false);
-                xhoff = txhoff;
-            }
-            if(hasdata)
-            {
-                xdata = nexp->FullPathFor("Contents/" + xdata.substr(15));
-                String txdata = outdir + "/" + hos::ContentIdAsString(data) + ".nca";
-                fs::CreateConcatenationFile(txdata);
-                this->ncaBar->SetVisible(true);
-                fs::CopyFileProgress(xdata, txdata, [&](double done, double total)
-                {
-                    this->ncaBar->SetMaxValue(total);
-                    this->ncaBar->SetProgress(done);
-                    global_app->CallForRender();
-                });
-                this->ncaBar->SetVisible(false);
-                xdata = txdata;
+                    entries.push_back({ cnt_name + ".ncz", std::make_shared<fs::FileStorage>(sd_exp, ncz) });
+                    continue;
+                }
+                // Most eShop titles use titlekey crypto, so this has to be told rather than passing the NSZ off as compressed
+                if(res == dump::CompressResult::TitlekeyCrypto) uncompressed.push_back(cnt_name + ".nca");
             }
+            entries.push_back({ cnt_name + ".nca", cnt_storage });
         }
-        String fout = "sdmc:/" + consts::Root + "/dump/title/" + fappid + ".nsp";
+
+        String fout = "sdmc:/" + consts::Root + "/dump/title/" + fappid + ((Format != dump::ExportFormat::NSP) ? ".nsz" : ".nsp");
         fs::CreateConcatenationFile(fout);
         this->ncaBar->SetVisible(true);
         this->dumpText->SetText(cfg::strings::Main.GetString(196));
-        ok = nsp::GenerateFrom(outdir, fout, [&](u64 done, u64 total)
+        ok = nsp::Build(entries, fout, [&](u64 done, u64 total)
         {
             this->ncaBar->SetMaxValue((double)total);
             this->ncaBar->SetProgress((double)done);
             global_app->CallForRender();
         });
+        sd_exp->EndFileShared();
         hos::UnlockAutoSleep();
         sd_exp->DeleteDirectory(consts::Root + "/dump/temp");
         sd_exp->DeleteDirectory(outdir);
-        if(ok) global_app->ShowNotification(cfg::strings::Main.GetString(197) + " '" + fout + "'");
+        if(ok)
+        {
+            if(!uncompressed.empty())
+            {
+                String msg = cfg::strings::Main.GetString(460);
+                for(auto &cnt: uncompressed) msg += "\n" + cnt;
+                global_app->CreateShowDialog(cfg::strings::Main.GetString(450), msg, { cfg::strings::Main.GetString(234) }, true);
+            }
+            global_app->ShowNotification(cfg::strings::Main.GetString(197) + " '" + fout + "'");
+        }
         else
         {
             HandleResult(err::result::ResultCouldNotBuildNSP, cfg::strings::Main.GetString(198));
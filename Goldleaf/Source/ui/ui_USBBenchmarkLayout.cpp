@@ -0,0 +1,95 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <ui/ui_USBBenchmarkLayout.hpp>
+#include <ui/ui_MainApplication.hpp>
+#include <cstdio>
+
+extern ui::MainApplication::Ref global_app;
+extern cfg::Settings global_settings;
+
+namespace ui
+{
+    static String FormatLatency(u64 Ns)
+    {
+        char str[0x20] = {};
+        snprintf(str, sizeof(str), "%.2f ms", (double)Ns / 1000000.0);
+        return str;
+    }
+
+    // Runs come in pairs, console to PC first
+    static String FormatRunPair(usb::ThroughputRun &ToPC, usb::ThroughputRun &ToConsole)
+    {
+        return fs::FormatSize((u64)ToPC.GetBytesPerSec()) + "/s  |  " + fs::FormatSize((u64)ToConsole.GetBytesPerSec()) + "/s";
+    }
+
+    USBBenchmarkLayout::USBBenchmarkLayout() : pu::ui::Layout()
+    {
+        this->infoText = pu::ui::elm::TextBlock::New(150, 180, cfg::strings::Main.GetString(454));
+        this->infoText->SetHorizontalAlign(pu::ui::elm::HorizontalAlign::Center);
+        this->infoText->SetColor(global_settings.custom_scheme.Text);
+        this->benchmarkBar = pu::ui::elm::ProgressBar::New(340, 240, 600, 30, 100.0f);
+        global_settings.ApplyProgressBarColor(this->benchmarkBar);
+        this->resultsText = pu::ui::elm::TextBlock::New(100, 230, "");
+        this->resultsText->SetFont("DefaultFont@20");
+        this->resultsText->SetColor(global_settings.custom_scheme.Text);
+        this->Add(this->infoText);
+        this->Add(this->benchmarkBar);
+        this->Add(this->resultsText);
+    }
+
+    bool USBBenchmarkLayout::RunBenchmark()
+    {
+        this->infoText->SetText(cfg::strings::Main.GetString(454));
+        this->resultsText->SetText("");
+        this->benchmarkBar->SetProgress(0);
+        this->benchmarkBar->SetVisible(true);
+        global_app->CallForRender();
+
+        usb::BenchmarkResults results = {};
+        auto rc = usb::RunBenchmark(results, [&](u32 Done, u32 Total)
+        {
+            this->benchmarkBar->SetMaxValue((double)Total);
+            this->benchmarkBar->SetProgress((double)Done);
+            global_app->CallForRender();
+        });
+        this->benchmarkBar->SetVisible(false);
+        if(R_FAILED(rc))
+        {
+            HandleResult(rc, cfg::strings::Main.GetString(453));
+            return false;
+        }
+
+        auto path = "sdmc:/" + consts::USBBenchmarks + "/" + std::to_string(time(nullptr)) + ".json";
+        usb::SaveBenchmarkResults(results, path);
+        this->infoText->SetText(cfg::strings::Main.GetString(459) + " '" + path + "'");
+
+        auto &lat = results.Latency;
+        String text = cfg::strings::Main.GetString(455) + ": p50 " + FormatLatency(lat.P50Ns) + ", p99 " + FormatLatency(lat.P99Ns) + " (" + std::to_string(lat.Samples) + ")\n\n";
+        text += cfg::strings::Main.GetString(456) + "  |  " + cfg::strings::Main.GetString(457) + "\n";
+        for(u32 i = 0; (i + 1) < results.SizeSweep.size(); i += 2) text += fs::FormatSize(results.SizeSweep[i].TransferSize) + ": " + FormatRunPair(results.SizeSweep[i], results.SizeSweep[i + 1]) + "\n";
+        text += "\n";
+        for(u32 i = 0; (i + 1) < results.DepthSweep.size(); i += 2) text += fs::FormatSize(results.DepthSweep[i].TransferSize) + ", " + cfg::strings::Main.GetString(458) + " " + std::to_string(results.DepthSweep[i].QueueDepth) + ": " + FormatRunPair(results.DepthSweep[i], results.DepthSweep[i + 1]) + "\n";
+        this->resultsText->SetText(text);
+        global_app->CallForRender();
+        return true;
+    }
+}
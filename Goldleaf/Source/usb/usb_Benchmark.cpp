@@ -0,0 +1,210 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <usb/usb_Benchmark.hpp>
+#include <err/err_Result.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+namespace usb
+{
+    static Result ReceiveBenchmarkResponse(u32 Interface)
+    {
+        OutCommandBlock resp(Interface);
+        resp.Cleanup();
+        if(resp.IsValid()) return err::result::ResultSuccess;
+        return R_FAILED(resp.res) ? resp.res : MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsRead);
+    }
+
+    static Result MeasureLatency(LatencyStats &Out)
+    {
+        std::vector<u64> samples;
+        samples.reserve(BenchmarkLatencySamples);
+        Out = {};
+        for(u32 i = 0; i < BenchmarkLatencySamples; i++)
+        {
+            u32 echo = 0;
+            auto start = armGetSystemTick();
+            auto rc = ProcessCommand<CommandId::Echo>(In32(i), Out32(echo));
+            auto ns = armTicksToNs(armGetSystemTick() - start);
+            R_TRY(rc);
+            if(echo != i) return MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsRead);
+            samples.push_back(ns);
+            Out.Histogram[std::min((size_t)(ns / BenchmarkHistogramBucketNs), BenchmarkHistogramBuckets - 1)]++;
+        }
+        std::sort(samples.begin(), samples.end());
+        Out.Samples = samples.size();
+        Out.MinNs = samples.front();
+        Out.P50Ns = samples[samples.size() / 2];
+        Out.P99Ns = samples[std::min(samples.size() - 1, (samples.size() * 99) / 100)];
+        Out.MaxNs = samples.back();
+        return err::result::ResultSuccess;
+    }
+
+    // Every transfer is a slice of the same aligned buffer, since neither end looks at the data
+    // Transfers bigger than the chunk size are split like any other payload, Quark still moves them as a whole on its side
+    static Result MeasureThroughput(u8 *Buf, BenchmarkDirection Direction, u64 TransferSize, u32 QueueDepth, ThroughputRun &Out)
+    {
+        auto total = std::max(BenchmarkRunSize, TransferSize * 4);
+        auto post_size = std::min((u64)detail::TransferChunkSize, TransferSize);
+        auto write = Direction == BenchmarkDirection::ConsoleToPC;
+        auto cmd_id = write ? CommandId::Sink : CommandId::Source;
+        auto intf = BeginCommand(cmd_id);
+        InCommandBlock block(cmd_id, intf);
+        block.Write64(total);
+        block.Write32(static_cast<u32>(TransferSize));
+        auto rc = block.Send();
+        // The PC acknowledges a source before sending anything, and a sink once it received everything
+        if(R_SUCCEEDED(rc) && !write) rc = ReceiveBenchmarkResponse(intf);
+        if(R_SUCCEEDED(rc))
+        {
+            auto start = armGetSystemTick();
+            {
+                detail::TransferQueue queue(write, intf);
+                for(u64 offset = 0; offset < total; offset += post_size)
+                {
+                    if(queue.GetPendingCount() >= QueueDepth)
+                    {
+                        rc = queue.WaitNext();
+                        if(R_FAILED(rc)) break;
+                    }
+                    rc = queue.Post(Buf, post_size);
+                    if(R_FAILED(rc)) break;
+                }
+                auto wait_rc = queue.WaitAll();
+                if(R_SUCCEEDED(rc)) rc = wait_rc;
+            }
+            auto ns = armTicksToNs(armGetSystemTick() - start);
+            if(R_SUCCEEDED(rc) && write) rc = ReceiveBenchmarkResponse(intf);
+            Out = { Direction, TransferSize, QueueDepth, total, ns };
+        }
+        EndCommand(intf);
+        return rc;
+    }
+
+    Result RunBenchmark(BenchmarkResults &Out, std::function<void(u32 Done, u32 Total)> Callback)
+    {
+        // The PC might have changed since the last Hello, and older clients would take raw data as commands
+        Out.Host = Hello();
+        ERR_RC_UNLESS(HostSupports(FeatureBenchmark), err::result::ResultPCFeatureNotSupported);
+        Out.SizeSweep.clear();
+        Out.DepthSweep.clear();
+
+        std::vector<u64> sizes;
+        for(u64 size = BenchmarkMinTransferSize; size <= BenchmarkMaxTransferSize; size *= 4) sizes.push_back(size);
+        std::vector<u32> depths;
+        for(u32 depth = 1; depth <= detail::MaxTransferQueueDepth; depth *= 2) depths.push_back(depth);
+        const BenchmarkDirection directions[] = { BenchmarkDirection::ConsoleToPC, BenchmarkDirection::PCToConsole };
+        u32 total = 1 + (sizes.size() + (depths.size() * std::size(BenchmarkQueueDepthSizes))) * std::size(directions);
+        u32 done = 0;
+
+        Callback(done, total);
+        R_TRY(MeasureLatency(Out.Latency));
+        Callback(++done, total);
+
+        size_t buf_size = detail::TransferChunkSize;
+        auto buf = AcquireTransferBuffer(buf_size);
+        Result rc = err::result::ResultSuccess;
+        for(auto size: sizes)
+        {
+            for(auto direction: directions)
+            {
+                ThroughputRun run = {};
+                rc = MeasureThroughput(buf, direction, size, detail::MaxTransferQueueDepth, run);
+                if(R_FAILED(rc)) break;
+                Out.SizeSweep.push_back(run);
+                Callback(++done, total);
+            }
+            if(R_FAILED(rc)) break;
+        }
+        if(R_SUCCEEDED(rc))
+        {
+            for(auto size: BenchmarkQueueDepthSizes)
+            {
+                for(auto depth: depths)
+                {
+                    for(auto direction: directions)
+                    {
+                        ThroughputRun run = {};
+                        rc = MeasureThroughput(buf, direction, size, depth, run);
+                        if(R_FAILED(rc)) break;
+                        Out.DepthSweep.push_back(run);
+                        Callback(++done, total);
+                    }
+                    if(R_FAILED(rc)) break;
+                }
+                if(R_FAILED(rc)) break;
+            }
+        }
+        ReleaseTransferBuffer(buf, buf_size);
+        return rc;
+    }
+
+    static JSON ThroughputRunToJSON(const ThroughputRun &Run)
+    {
+        auto json = JSON::object();
+        json["direction"] = GetBenchmarkDirectionName(Run.Direction);
+        json["transferSize"] = Run.TransferSize;
+        json["queueDepth"] = Run.QueueDepth;
+        json["bytes"] = Run.Bytes;
+        json["elapsedUs"] = Run.Ns / 1000;
+        json["bytesPerSec"] = (u64)Run.GetBytesPerSec();
+        return json;
+    }
+
+    void SaveBenchmarkResults(BenchmarkResults &Results, std::string Path)
+    {
+        auto json = JSON::object();
+        json["host"] = JSON::object();
+        json["host"]["protocolVersion"] = Results.Host.protocol_version;
+        json["host"]["features"] = Results.Host.features;
+        json["latency"] = JSON::object();
+        json["latency"]["samples"] = Results.Latency.Samples;
+        json["latency"]["minUs"] = Results.Latency.MinNs / 1000;
+        json["latency"]["p50Us"] = Results.Latency.P50Ns / 1000;
+        json["latency"]["p99Us"] = Results.Latency.P99Ns / 1000;
+        json["latency"]["maxUs"] = Results.Latency.MaxNs / 1000;
+        json["latency"]["histogramBucketUs"] = BenchmarkHistogramBucketNs / 1000;
+        json["latency"]["histogram"] = JSON::array();
+        for(auto count: Results.Latency.Histogram) json["latency"]["histogram"].push_back(count);
+        json["sizeSweep"] = JSON::array();
+        for(auto &run: Results.SizeSweep) json["sizeSweep"].push_back(ThroughputRunToJSON(run));
+        json["queueDepthSweep"] = JSON::array();
+        for(auto &run: Results.DepthSweep) json["queueDepthSweep"].push_back(ThroughputRunToJSON(run));
+        std::ofstream ofs(Path, std::ios::trunc);
+        ofs << std::setw(4) << json;
+        ofs.close();
+    }
+
+    const char *GetBenchmarkDirectionName(BenchmarkDirection Direction)
+    {
+        switch(Direction)
+        {
+            case BenchmarkDirection::ConsoleToPC:
+                return "consoleToPC";
+            case BenchmarkDirection::PCToConsole:
+                return "pcToConsole";
+            default:
+                return "";
+        }
+    }
+}
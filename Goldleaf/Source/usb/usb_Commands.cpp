@@ -21,13 +21,63 @@
 
 #include <usb/usb_Commands.hpp>
 #include <cstring>
+#include <algorithm>
+#include <zstd.h>
 
 namespace usb
 {
-    InCommandBlock::InCommandBlock(CommandId CmdId)
+    // Enough for a full bounce ring and a few command blocks
+    static constexpr size_t MaxPooledSize = detail::TransferChunkSize * detail::MaxTransferQueueDepth + 0x10 * BlockSize;
+
+    static Mutex g_transferPoolLock = {};
+    static std::vector<std::pair<u8*, size_t>> g_transferPool;
+    static size_t g_transferPoolSize = 0;
+
+    u8 *AcquireTransferBuffer(size_t &Size)
+    {
+        Size = (Size + BlockSize - 1) & ~(BlockSize - 1);
+        mutexLock(&g_transferPoolLock);
+        auto best = g_transferPool.end();
+        for(auto it = g_transferPool.begin(); it != g_transferPool.end(); it++)
+        {
+            // Don't hand a whole bounce ring out for a command block
+            if((it->second < Size) || (it->second > (Size * 2))) continue;
+            if((best == g_transferPool.end()) || (it->second < best->second)) best = it;
+        }
+        if(best != g_transferPool.end())
+        {
+            auto buf = best->first;
+            Size = best->second;
+            g_transferPoolSize -= Size;
+            g_transferPool.erase(best);
+            mutexUnlock(&g_transferPoolLock);
+            return buf;
+        }
+        mutexUnlock(&g_transferPoolLock);
+        // No need to clear it, only what gets written to it is ever sent
+        return new(std::align_val_t(0x1000)) u8[Size];
+    }
+
+    void ReleaseTransferBuffer(u8 *Buf, size_t Size)
+    {
+        mutexLock(&g_transferPoolLock);
+        if((g_transferPoolSize + Size) <= MaxPooledSize)
+        {
+            g_transferPool.push_back(std::make_pair(Buf, Size));
+            g_transferPoolSize += Size;
+            mutexUnlock(&g_transferPoolLock);
+            return;
+        }
+        mutexUnlock(&g_transferPoolLock);
+        operator delete[](Buf, std::align_val_t(0x1000));
+    }
+
+    InCommandBlock::InCommandBlock(CommandId CmdId, u32 Interface)
     {
         base.position = 0;
-        base.blockbuf = new(std::align_val_t(0x1000)) u8[BlockSize]();
+        base.bufsize = BlockSize;
+        base.blockbuf = AcquireTransferBuffer(base.bufsize);
+        base.interface = Interface;
         Write32(InputMagic);
         Write32(static_cast<u32>(CmdId));
     }
@@ -56,16 +106,36 @@ namespace usb
 
     Result InCommandBlock::Send()
     {
-        auto rc = detail::Write(this->base.blockbuf, BlockSize);
-        operator delete[](base.blockbuf, std::align_val_t(0x1000));
+        // Pooled blocks still hold whatever the last command wrote
+        memset(base.blockbuf + base.position, 0, BlockSize - base.position);
+        auto rc = detail::Write(this->base.blockbuf, BlockSize, base.interface);
+        ReleaseTransferBuffer(base.blockbuf, base.bufsize);
+        return rc;
+    }
+
+    Result InCommandBlock::Post()
+    {
+        memset(base.blockbuf + base.position, 0, BlockSize - base.position);
+        auto rc = detail::PostWrite(this->base.blockbuf, BlockSize, this->urb_id, base.interface);
+        if(R_FAILED(rc)) ReleaseTransferBuffer(base.blockbuf, base.bufsize);
         return rc;
     }
 
-    OutCommandBlock::OutCommandBlock()
+    Result InCommandBlock::Reap()
+    {
+        auto rc = detail::WaitWrite(this->urb_id, BlockSize, base.interface);
+        ReleaseTransferBuffer(base.blockbuf, base.bufsize);
+        return rc;
+    }
+
+    OutCommandBlock::OutCommandBlock(u32 Interface, u64 Timeout)
     {
         base.position = 0;
-        base.blockbuf = new(std::align_val_t(0x1000)) u8[BlockSize]();
-        res = detail::Read(base.blockbuf, BlockSize);
+        base.bufsize = BlockSize;
+        base.blockbuf = AcquireTransferBuffer(base.bufsize);
+        base.interface = Interface;
+        magic = 0;
+        res = detail::Read(base.blockbuf, BlockSize, Interface, Timeout);
         if(R_SUCCEEDED(res))
         {
             magic = Read32();
@@ -75,7 +145,7 @@ namespace usb
 
     void OutCommandBlock::Cleanup()
     {
-        operator delete[](base.blockbuf, std::align_val_t(0x1000));
+        ReleaseTransferBuffer(base.blockbuf, base.bufsize);
     }
 
     bool OutCommandBlock::IsValid()
@@ -240,20 +310,436 @@ namespace usb
     {
     }
 
-    InBuffer::InBuffer(void *Buf, size_t Sz) : buf(Buf), sz(Sz)
+    BounceBuffer::BounceBuffer(size_t Size)
+    {
+        slot_size = std::min(Size, detail::TransferChunkSize);
+        if(slot_size == 0) slot_size = 1;
+        slot_count = std::min((Size + slot_size - 1) / slot_size, (size_t)detail::MaxTransferQueueDepth);
+        if(slot_count == 0) slot_count = 1;
+        // Keep every slot aligned, as required by usb:ds
+        aligned_slot_size = (slot_size + 0xFFF) & ~0xFFF;
+        buf_size = aligned_slot_size * slot_count;
+        buf = AcquireTransferBuffer(buf_size);
+    }
+
+    BounceBuffer::~BounceBuffer()
+    {
+        ReleaseTransferBuffer(buf, buf_size);
+    }
+
+    u8 *BounceBuffer::GetSlot(size_t Offset)
+    {
+        return buf + ((Offset / slot_size) % slot_count) * aligned_slot_size;
+    }
+
+    static void SendBuffer(void *Buf, size_t Size, u32 Interface)
+    {
+        if(IsTransferAligned(Buf))
+        {
+            // usb:ds maps whole pages, so an aligned buffer (like the work buffer) can be sent as it is
+            detail::Write(Buf, Size, Interface);
+            return;
+        }
+
+        // Chunks are copied into the aligned bounce slots while the previous ones are still being sent
+        BounceBuffer bounce(Size);
+        detail::TransferQueue queue(true, Interface);
+        auto src = reinterpret_cast<u8*>(Buf);
+        for(size_t offset = 0; offset < Size; offset += bounce.slot_size)
+        {
+            if(queue.GetPendingCount() == bounce.slot_count)
+            {
+                if(R_FAILED(queue.WaitNext())) break;
+            }
+            auto slot = bounce.GetSlot(offset);
+            auto size = std::min(bounce.slot_size, Size - offset);
+            memcpy(slot, src + offset, size);
+            if(R_FAILED(queue.Post(slot, size))) break;
+        }
+        queue.WaitAll();
+    }
+
+    static void ReceiveBuffer(void *Buf, size_t Size, u32 Interface)
+    {
+        if(IsTransferAligned(Buf))
+        {
+            // Received in place, except for a partial last page which would make usb:ds write past the end of the buffer
+            auto dst = reinterpret_cast<u8*>(Buf);
+            auto direct_size = Size & ~(BlockSize - 1);
+            auto tail_size = Size - direct_size;
+            size_t tail_bufsize = BlockSize;
+            u8 *tail = (tail_size > 0) ? AcquireTransferBuffer(tail_bufsize) : nullptr;
+            {
+                detail::TransferQueue queue(false, Interface);
+                for(size_t offset = 0; offset < direct_size; offset += detail::TransferChunkSize)
+                {
+                    if(R_FAILED(queue.Post(dst + offset, std::min(detail::TransferChunkSize, direct_size - offset)))) break;
+                }
+                if(tail != nullptr) queue.Post(tail, tail_size);
+                if(R_SUCCEEDED(queue.WaitAll()) && (tail != nullptr)) memcpy(dst + direct_size, tail, tail_size);
+            }
+            if(tail != nullptr) ReleaseTransferBuffer(tail, tail_bufsize);
+            return;
+        }
+
+        // Every slot is queued up front, and each one is copied out and queued again while the others keep receiving
+        BounceBuffer bounce(Size);
+        detail::TransferQueue queue(false, Interface);
+        auto dst = reinterpret_cast<u8*>(Buf);
+        size_t posted = 0;
+        size_t copied = 0;
+        while(copied < Size)
+        {
+            while((posted < Size) && (queue.GetPendingCount() < bounce.slot_count))
+            {
+                if(R_FAILED(queue.Post(bounce.GetSlot(posted), std::min(bounce.slot_size, Size - posted)))) break;
+                posted += bounce.slot_size;
+            }
+            if(R_FAILED(queue.WaitNext())) break;
+            auto size = std::min(bounce.slot_size, Size - copied);
+            memcpy(dst + copied, bounce.GetSlot(copied), size);
+            copied += bounce.slot_size;
+        }
+    }
+
+    // Payloads which can't be taken are still received, otherwise the next command block would be read from the middle of them
+    static void DiscardPayload(u64 WireSize, u32 Interface)
+    {
+        size_t bufsize = detail::TransferChunkSize;
+        auto buf = AcquireTransferBuffer(bufsize);
+        for(u64 offset = 0; offset < WireSize; offset += detail::TransferChunkSize) ReceiveBuffer(buf, std::min((u64)detail::TransferChunkSize, WireSize - offset), Interface);
+        ReleaseTransferBuffer(buf, bufsize);
+    }
+
+    // Compressed payloads are received whole and then decompressed into the destination
+    static bool ReceivePayload(void *Buf, size_t Size, u32 Encoding, u64 WireSize, u32 Interface)
+    {
+        // Nothing valid is ever larger than this, and raw ones are received straight into the destination
+        auto max_wire_size = (Encoding == static_cast<u32>(PayloadEncoding::Raw)) ? Size : ZSTD_compressBound(Size);
+        if(WireSize > max_wire_size)
+        {
+            DiscardPayload(WireSize, Interface);
+            return false;
+        }
+        if(Encoding == static_cast<u32>(PayloadEncoding::Raw))
+        {
+            ReceiveBuffer(Buf, WireSize, Interface);
+            return WireSize == Size;
+        }
+
+        size_t wire_bufsize = WireSize;
+        auto wire_buf = AcquireTransferBuffer(wire_bufsize);
+        ReceiveBuffer(wire_buf, WireSize, Interface);
+        bool ok = false;
+        if(Encoding == static_cast<u32>(PayloadEncoding::Zstd))
+        {
+            auto dec_size = ZSTD_decompress(Buf, Size, wire_buf, WireSize);
+            ok = !ZSTD_isError(dec_size) && (dec_size == Size);
+        }
+        ReleaseTransferBuffer(wire_buf, wire_bufsize);
+        return ok;
+    }
+
+    // Returns the compressed size, or 0 if the payload should be sent raw
+    static u64 CompressPayload(void *Buf, size_t Size, u8 *&Out, size_t &OutBufSize)
+    {
+        auto probe_size = std::min(Size, PayloadCompressionProbeSize);
+        OutBufSize = ZSTD_compressBound(Size);
+        Out = AcquireTransferBuffer(OutBufSize);
+        u64 wire_size = 0;
+        // Anything that doesn't save at least 1/8 isn't worth the time it takes
+        auto probe = ZSTD_compress(Out, OutBufSize, Buf, probe_size, PayloadCompressionLevel);
+        if(!ZSTD_isError(probe) && (probe < (probe_size - (probe_size / 8))))
+        {
+            auto comp = ZSTD_compress(Out, OutBufSize, Buf, Size, PayloadCompressionLevel);
+            if(!ZSTD_isError(comp) && (comp < (Size - (Size / 8)))) wire_size = comp;
+        }
+        if(wire_size == 0)
+        {
+            ReleaseTransferBuffer(Out, OutBufSize);
+            Out = nullptr;
+        }
+        return wire_size;
+    }
+
+    struct FileStreamState
+    {
+        bool active;
+        String path;
+        // Next offset to be read, and where the pushed data ends
+        u64 offset;
+        u64 end;
+        u64 block_size;
+        u64 total_blocks;
+        u64 granted_blocks;
+        u64 received_blocks;
+        // The last credit sent, which the PC only reads once it pushed the blocks granted before it
+        InCommandBlock *credit;
+        u64 credit_from;
+        u32 codecs;
+        // Part of a pushed block which wasn't read yet (when reads don't match the block size)
+        u8 *carry;
+        size_t carry_bufsize;
+        u64 carry_start;
+        u64 carry_size;
+    };
+
+    static FileStreamState g_fileStream = {};
+
+    // Held while a command (or a stream block) is in flight on each interface, a thread may nest commands
+    static RMutex g_commandLocks[detail::UsedInterfaces] = {};
+
+    static bool IsDataCommand(CommandId Id)
+    {
+        switch(Id)
+        {
+            case CommandId::StartFile:
+            case CommandId::ReadFile:
+            case CommandId::WriteFile:
+            case CommandId::EndFile:
+            case CommandId::StreamFile:
+            case CommandId::StreamCredit:
+            case CommandId::StreamCancel:
+            // The control interface can't be used before Hello says so
+            case CommandId::Hello:
+            // The benchmark measures the same pipe file payloads go through
+            case CommandId::Echo:
+            case CommandId::Sink:
+            case CommandId::Source:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    u32 BeginCommand(CommandId Id)
+    {
+        u32 intf = detail::DataInterface;
+        if(!IsDataCommand(Id) && HostSupports(FeatureControlInterface)) intf = detail::ControlInterface;
+        rmutexLock(&g_commandLocks[intf]);
+        // A stream only keeps the data interface busy, listings and stats can go on while it's active
+        if(intf == detail::DataInterface) CancelFileStream();
+        return intf;
+    }
+
+    void EndCommand(u32 Interface)
+    {
+        rmutexUnlock(&g_commandLocks[Interface]);
+    }
+
+    // Each pushed block comes after its own response block with its size, or with an error if the PC couldn't read it
+    static bool ReceiveStreamBlockHeader(u64 &Size, u32 &Encoding, u64 &WireSize)
+    {
+        OutCommandBlock header;
+        if(header.IsValid())
+        {
+            Size = header.Read64();
+            Encoding = static_cast<u32>(PayloadEncoding::Raw);
+            WireSize = Size;
+            if(g_fileStream.codecs != 0)
+            {
+                Encoding = header.Read32();
+                WireSize = header.Read64();
+            }
+        }
+        header.Cleanup();
+        return header.IsValid();
+    }
+
+    static bool ReapStreamCredit()
+    {
+        auto &stream = g_fileStream;
+        if(stream.credit == nullptr) return true;
+        auto rc = stream.credit->Reap();
+        delete stream.credit;
+        stream.credit = nullptr;
+        return R_SUCCEEDED(rc);
+    }
+
+    // Called after each received block, so that the PC always has the next ones it may push
+    static bool GrantStreamCredits()
+    {
+        auto &stream = g_fileStream;
+        if(stream.credit != nullptr)
+        {
+            // Waiting for the PC to read it any earlier would deadlock, it's still pushing blocks nobody is receiving
+            if(stream.received_blocks < stream.credit_from) return true;
+            if(!ReapStreamCredit()) return false;
+        }
+        auto granted = std::min(stream.received_blocks + StreamCredits, stream.total_blocks);
+        if(granted <= stream.granted_blocks) return true;
+
+        stream.credit = new InCommandBlock(CommandId::StreamCredit);
+        stream.credit->Write32(granted - stream.granted_blocks);
+        if(R_FAILED(stream.credit->Post()))
+        {
+            delete stream.credit;
+            stream.credit = nullptr;
+            return false;
+        }
+        stream.credit_from = stream.granted_blocks;
+        stream.granted_blocks = granted;
+        return true;
+    }
+
+    static void EndFileStream()
+    {
+        // After a failed block the PC gets the credit with the next command, which it ignores
+        ReapStreamCredit();
+        if(g_fileStream.carry != nullptr) ReleaseTransferBuffer(g_fileStream.carry, g_fileStream.carry_bufsize);
+        g_fileStream = {};
+    }
+
+    bool StartFileStream(String Path, u64 Offset, u64 BlockSize, u32 Codecs)
+    {
+        rmutexLock(&g_commandLocks[detail::DataInterface]);
+        u64 length = 0;
+        auto rc = ProcessCommand<CommandId::StreamFile>(InString(Path), In64(Offset), In64(BlockSize), In32(StreamCredits), In32(Codecs), Out64(length));
+        if(R_FAILED(rc) || (length == 0))
+        {
+            rmutexUnlock(&g_commandLocks[detail::DataInterface]);
+            return false;
+        }
+
+        auto &stream = g_fileStream;
+        stream.active = true;
+        stream.path = Path;
+        stream.offset = Offset;
+        stream.end = Offset + length;
+        stream.block_size = BlockSize;
+        stream.total_blocks = (length + BlockSize - 1) / BlockSize;
+        stream.granted_blocks = std::min((u64)StreamCredits, stream.total_blocks);
+        stream.received_blocks = 0;
+        stream.credit = nullptr;
+        stream.credit_from = 0;
+        stream.codecs = Codecs;
+        stream.carry_bufsize = BlockSize;
+        stream.carry = AcquireTransferBuffer(stream.carry_bufsize);
+        stream.carry_start = 0;
+        stream.carry_size = 0;
+        rmutexUnlock(&g_commandLocks[detail::DataInterface]);
+        return true;
+    }
+
+    bool IsFileStreamAt(String Path, u64 Offset)
+    {
+        return g_fileStream.active && (g_fileStream.path == Path) && (g_fileStream.offset == Offset);
+    }
+
+    u64 ReadFileStream(void *Out, u64 Size)
+    {
+        rmutexLock(&g_commandLocks[detail::DataInterface]);
+        auto &stream = g_fileStream;
+        auto dst = reinterpret_cast<u8*>(Out);
+        u64 done = 0;
+        while(stream.active && (done < Size) && (stream.offset < stream.end))
+        {
+            if(stream.carry_size > 0)
+            {
+                auto copy_size = std::min(stream.carry_size, Size - done);
+                memcpy(dst + done, stream.carry + stream.carry_start, copy_size);
+                stream.carry_start += copy_size;
+                stream.carry_size -= copy_size;
+                stream.offset += copy_size;
+                done += copy_size;
+                continue;
+            }
+
+            u64 block_size = 0;
+            u32 encoding = 0;
+            u64 wire_size = 0;
+            auto expected_size = std::min(stream.block_size, stream.end - stream.offset);
+            if(!ReceiveStreamBlockHeader(block_size, encoding, wire_size) || (block_size != expected_size))
+            {
+                // The PC ends the stream itself after a failed block
+                EndFileStream();
+                break;
+            }
+            stream.received_blocks++;
+            bool fits = (Size - done) >= block_size;
+            if(!ReceivePayload(fits ? (dst + done) : stream.carry, block_size, encoding, wire_size, detail::DataInterface))
+            {
+                // The stream itself is still in sync, only this block was bad
+                CancelFileStream();
+                break;
+            }
+            if(fits)
+            {
+                stream.offset += block_size;
+                done += block_size;
+            }
+            else
+            {
+                stream.carry_start = 0;
+                stream.carry_size = block_size;
+            }
+            if(!GrantStreamCredits())
+            {
+                EndFileStream();
+                break;
+            }
+        }
+        rmutexUnlock(&g_commandLocks[detail::DataInterface]);
+        return done;
+    }
+
+    void CancelFileStream()
+    {
+        rmutexLock(&g_commandLocks[detail::DataInterface]);
+        auto &stream = g_fileStream;
+        if(!stream.active)
+        {
+            rmutexUnlock(&g_commandLocks[detail::DataInterface]);
+            return;
+        }
+
+        // Blocks the PC was already allowed to push are received and dropped
+        bool stream_ok = true;
+        std::vector<u8> drop;
+        while(stream.received_blocks < stream.granted_blocks)
+        {
+            u64 block_size = 0;
+            u32 encoding = 0;
+            u64 wire_size = 0;
+            if(!ReceiveStreamBlockHeader(block_size, encoding, wire_size))
+            {
+                stream_ok = false;
+                break;
+            }
+            drop.resize(wire_size);
+            ReceiveBuffer(drop.data(), wire_size, detail::DataInterface);
+            stream.received_blocks++;
+        }
+
+        // The PC read the last credit before pushing the blocks it granted
+        if(stream_ok) stream_ok = ReapStreamCredit();
+
+        // After its last block the PC is back to processing commands, there's nothing left to cancel
+        if(stream_ok && (stream.received_blocks < stream.total_blocks))
+        {
+            InCommandBlock cancel(CommandId::StreamCancel);
+            if(R_SUCCEEDED(cancel.Send()))
+            {
+                OutCommandBlock ack;
+                ack.Cleanup();
+            }
+        }
+        EndFileStream();
+        rmutexUnlock(&g_commandLocks[detail::DataInterface]);
+    }
+
+    InBuffer::InBuffer(void *Buf, size_t Sz) : buf(Buf), sz(Sz), interface(detail::DataInterface)
     {
     }
 
     void InBuffer::ProcessIn(InCommandBlock &block)
     {
+        interface = block.base.interface;
     }
 
     void InBuffer::ProcessAfterIn()
     {
-        u8 *alignbuf = new (std::align_val_t(0x1000)) u8[sz]();
-        memcpy(alignbuf, buf, sz);
-        detail::Write(alignbuf, sz);
-        operator delete[](alignbuf, std::align_val_t(0x1000));
+        SendBuffer(buf, sz, interface);
     }
 
     void InBuffer::ProcessOut(OutCommandBlock &block)
@@ -264,12 +750,13 @@ namespace usb
     {
     }
 
-    OutBuffer::OutBuffer(void *Buf, size_t Sz) : buf(Buf), sz(Sz)
+    OutBuffer::OutBuffer(void *Buf, size_t Sz) : buf(Buf), sz(Sz), interface(detail::DataInterface)
     {
     }
 
     void OutBuffer::ProcessIn(InCommandBlock &block)
     {
+        interface = block.base.interface;
     }
 
     void OutBuffer::ProcessAfterIn()
@@ -282,9 +769,123 @@ namespace usb
 
     void OutBuffer::ProcessAfterOut()
     {
-        u8 *alignbuf = new (std::align_val_t(0x1000)) u8[sz]();
-        detail::Read(alignbuf, sz);
-        memcpy(buf, alignbuf, sz);
-        operator delete[](alignbuf, std::align_val_t(0x1000));
+        ReceiveBuffer(buf, sz, interface);
+    }
+
+    OutVariableBuffer::OutVariableBuffer(std::vector<u8> &Buf) : buf(Buf), interface(detail::DataInterface)
+    {
+    }
+
+    void OutVariableBuffer::ProcessIn(InCommandBlock &block)
+    {
+        interface = block.base.interface;
+    }
+
+    void OutVariableBuffer::ProcessAfterIn()
+    {
+    }
+
+    void OutVariableBuffer::ProcessOut(OutCommandBlock &block)
+    {
+        buf.resize(block.Read64());
+    }
+
+    void OutVariableBuffer::ProcessAfterOut()
+    {
+        if(!buf.empty()) ReceiveBuffer(buf.data(), buf.size(), interface);
+    }
+
+    InCompressedBuffer::InCompressedBuffer(void *Buf, size_t Sz, u32 Codecs) : buf(Buf), sz(Sz), codecs(Codecs), wire_buf(nullptr), wire_bufsize(0), wire_size(0), interface(detail::DataInterface)
+    {
+    }
+
+    InCompressedBuffer::~InCompressedBuffer()
+    {
+        // The payload isn't sent if the command block itself failed
+        if(wire_buf != nullptr) ReleaseTransferBuffer(wire_buf, wire_bufsize);
+    }
+
+    void InCompressedBuffer::ProcessIn(InCommandBlock &block)
+    {
+        interface = block.base.interface;
+        // Raw payloads keep the layout older hosts expect
+        if(codecs & CompressionZstd) wire_size = CompressPayload(buf, sz, wire_buf, wire_bufsize);
+        if(wire_size > 0)
+        {
+            block.Write32(static_cast<u32>(PayloadEncoding::Zstd));
+            block.Write64(wire_size);
+        }
+        else block.Write32(static_cast<u32>(PayloadEncoding::Raw));
+    }
+
+    void InCompressedBuffer::ProcessAfterIn()
+    {
+        if(wire_buf != nullptr)
+        {
+            SendBuffer(wire_buf, wire_size, interface);
+            ReleaseTransferBuffer(wire_buf, wire_bufsize);
+            wire_buf = nullptr;
+        }
+        else SendBuffer(buf, sz, interface);
+    }
+
+    void InCompressedBuffer::ProcessOut(OutCommandBlock &block)
+    {
+    }
+
+    void InCompressedBuffer::ProcessAfterOut()
+    {
+    }
+
+    OutCompressedBuffer::OutCompressedBuffer(void *Buf, size_t Sz, u32 Codecs) : buf(Buf), sz(Sz), codecs(Codecs), encoding(static_cast<u32>(PayloadEncoding::Raw)), wire_size(Sz), interface(detail::DataInterface), received(false)
+    {
+    }
+
+    void OutCompressedBuffer::ProcessIn(InCommandBlock &block)
+    {
+        interface = block.base.interface;
+        // Encodings this read can be answered with, none means the usual raw payload
+        block.Write32(codecs);
+    }
+
+    void OutCompressedBuffer::ProcessAfterIn()
+    {
+    }
+
+    void OutCompressedBuffer::ProcessOut(OutCommandBlock &block)
+    {
+        if(codecs != 0)
+        {
+            encoding = block.Read32();
+            wire_size = block.Read64();
+        }
+    }
+
+    void OutCompressedBuffer::ProcessAfterOut()
+    {
+        received = ReceivePayload(buf, sz, encoding, wire_size, interface);
+    }
+
+    bool OutCompressedBuffer::IsReceived()
+    {
+        return received;
+    }
+
+    static HostInfo g_hostInfo = { 1, 0, 0, 0 };
+
+    HostInfo Hello()
+    {
+        HostInfo info = {};
+        auto rc = ProcessCommand<CommandId::Hello>(In32(ProtocolVersion), In32(MaxPayloadSize), In32(SupportedFeatures), In64(PreferredTransferSize), Out32(info.protocol_version), Out32(info.max_payload_size), Out32(info.features), Out64(info.preferred_transfer_size));
+        if(R_FAILED(rc)) info = { 1, 0, 0, 0 };
+        // Whatever the host claims, only what both ends know is ever used
+        info.features &= SupportedFeatures;
+        g_hostInfo = info;
+        return info;
+    }
+
+    HostInfo GetHostInfo()
+    {
+        return g_hostInfo;
     }
 }
\ No newline at end of file
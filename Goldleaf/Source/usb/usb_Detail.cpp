@@ -22,6 +22,7 @@
 #include <string.h>
 #include <malloc.h>
 #include <stdio.h>
+#include <algorithm>
 #include <usb/usb_Detail.hpp>
 
 namespace usb::detail
@@ -169,7 +170,7 @@ namespace usb::detail
 
     Result Initialize(void)
     {
-        return InitializeImpl(1, nullptr);
+        return InitializeImpl(UsedInterfaces, nullptr);
     }
 
     static void _usbCommsInterfaceFree(usbCommsInterface *interface)
@@ -374,44 +375,160 @@ namespace usb::detail
         return rc;
     }
 
-    static inline Result TransferImpl(void *buf, size_t size, UsbDsEndpoint *ep)
+    // Done is only set once the URB finished, successfully or not
+    static Result CheckUrb(UsbDsEndpoint *endpoint, u32 urb_id, size_t size, bool &done)
     {
-        auto state = UsbState_Detached;
-        usbDsGetState(&state);
-        if(state != UsbState_Configured) return MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsRead);
+        UsbDsReportData reportdata;
+        auto rc = usbDsEndpoint_GetReportData(endpoint, &reportdata);
+        if(R_FAILED(rc)) return rc;
+        for(u32 i = 0; i < std::min(reportdata.report_count, (u32)8); i++)
+        {
+            auto &entry = reportdata.report[i];
+            if(entry.id != urb_id) continue;
+            // 3 = done, 4 = cancelled, 5 = failed, anything else is still in progress
+            if(entry.urb_status == 3)
+            {
+                done = true;
+                if(entry.transferredSize != size) rc = 0xDEAD;
+            }
+            else if(entry.urb_status > 3)
+            {
+                done = true;
+                rc = MAKERESULT(Module_Libnx, LibnxError_IoError);
+            }
+            break;
+        }
+        return rc;
+    }
+
+    TransferQueue::TransferQueue(bool Write, u32 Interface, u64 Timeout) : pending_head(0), pending_count(0), timeout(Timeout), rc(0)
+    {
+        auto &intf = g_usbCommsInterfaces[Interface];
+        this->lock = Write ? &intf.lock_in : &intf.lock_out;
+        this->endpoint = Write ? intf.endpoint_in : intf.endpoint_out;
+        rwlockWriteLock(this->lock);
+    }
+
+    TransferQueue::~TransferQueue()
+    {
+        // The buffers of anything still in flight belong to the caller, which is about to free them
+        this->WaitAll();
+        rwlockWriteUnlock(this->lock);
+    }
+
+    Result TransferQueue::Post(void *Buf, size_t Size)
+    {
+        if(R_FAILED(this->rc)) return this->rc;
+        if(!IsStateOk()) return MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsRead);
+        if(this->pending_count == MaxTransferQueueDepth)
+        {
+            auto rc = this->WaitNext();
+            if(R_FAILED(rc)) return rc;
+        }
 
         u32 urbid = 0;
-        auto rc = usbDsEndpoint_PostBufferAsync(ep, buf, size, &urbid);
-        if(R_SUCCEEDED(rc))
+        this->rc = usbDsEndpoint_PostBufferAsync(this->endpoint, Buf, Size, &urbid);
+        if(R_SUCCEEDED(this->rc))
         {
-            rc = eventWait(&ep->CompletionEvent, UINT64_MAX);
-            eventClear(&ep->CompletionEvent);
-            
-            if(R_SUCCEEDED(rc))
+            this->pending[(this->pending_head + this->pending_count) % MaxTransferQueueDepth] = { urbid, Size };
+            this->pending_count++;
+        }
+        return this->rc;
+    }
+
+    Result TransferQueue::WaitNext()
+    {
+        if(this->pending_count == 0) return this->rc;
+        auto &next = this->pending[this->pending_head];
+        bool timed_out = false;
+        while(true)
+        {
+            // Several URBs may complete per signal, so the report is always checked before waiting again
+            bool done = false;
+            auto rc = CheckUrb(this->endpoint, next.urb_id, next.size, done);
+            if(R_SUCCEEDED(rc) && !done)
             {
-                UsbDsReportData reportdata;
-                rc = usbDsEndpoint_GetReportData(ep, &reportdata);
-                u32 gotsize = 0;
-                if(R_SUCCEEDED(rc)) rc = usbDsParseReportData(&reportdata, urbid, nullptr, &gotsize);
-                if(gotsize != size) rc = 0XDEAD;
+                rc = eventWait(&this->endpoint->CompletionEvent, timed_out ? UINT64_MAX : this->timeout);
+                eventClear(&this->endpoint->CompletionEvent);
+                if(R_SUCCEEDED(rc)) continue;
+                if(!timed_out && (R_VALUE(rc) == KERNELRESULT(TimedOut)))
+                {
+                    // The URB still owns its buffer until its cancellation gets reported
+                    usbDsEndpoint_Cancel(this->endpoint);
+                    timed_out = true;
+                    rc = 0;
+                    continue;
+                }
             }
+            // A transfer which got cancelled when it timed out, rather than one which failed
+            if(timed_out && R_FAILED(rc)) rc = KERNELRESULT(TimedOut);
+
+            this->pending_head = (this->pending_head + 1) % MaxTransferQueueDepth;
+            this->pending_count--;
+            if(R_FAILED(rc))
+            {
+                // A short or failed transfer means the rest of the queue won't complete on its own
+                if(R_SUCCEEDED(this->rc) && (this->pending_count > 0)) usbDsEndpoint_Cancel(this->endpoint);
+                if(R_SUCCEEDED(this->rc)) this->rc = rc;
+            }
+            return rc;
         }
-        return rc;
     }
 
-    Result Read(void *buf, size_t size)
+    Result TransferQueue::WaitAll()
     {
-        rwlockWriteLock(&g_usbCommsInterfaces[0].lock_out);
-        auto rc = TransferImpl(buf, size, g_usbCommsInterfaces[0].endpoint_out);
-        rwlockWriteUnlock(&g_usbCommsInterfaces[0].lock_out);
-        return rc;
+        while(this->pending_count > 0) this->WaitNext();
+        return this->rc;
     }
 
-    Result Write(void *buf, size_t size)
+    static Result TransferImpl(void *buf, size_t size, bool write, u32 interface, u64 timeout)
     {
-        rwlockWriteLock(&g_usbCommsInterfaces[0].lock_in);
-        auto rc = TransferImpl(buf, size, g_usbCommsInterfaces[0].endpoint_in);
-        rwlockWriteUnlock(&g_usbCommsInterfaces[0].lock_in);
+        TransferQueue queue(write, interface, timeout);
+        auto ptr = reinterpret_cast<u8*>(buf);
+        for(size_t offset = 0; offset < size; offset += TransferChunkSize)
+        {
+            auto rc = queue.Post(ptr + offset, std::min(TransferChunkSize, size - offset));
+            if(R_FAILED(rc)) break;
+        }
+        return queue.WaitAll();
+    }
+
+    Result Read(void *buf, size_t size, u32 interface, u64 timeout)
+    {
+        return TransferImpl(buf, size, false, interface, timeout);
+    }
+
+    Result Write(void *buf, size_t size, u32 interface)
+    {
+        return TransferImpl(buf, size, true, interface, UINT64_MAX);
+    }
+
+    Result PostWrite(void *buf, size_t size, u32 &urb_id, u32 interface)
+    {
+        if(!IsStateOk()) return MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsWrite);
+        auto &intf = g_usbCommsInterfaces[interface];
+        rwlockWriteLock(&intf.lock_in);
+        auto rc = usbDsEndpoint_PostBufferAsync(intf.endpoint_in, buf, size, &urb_id);
+        rwlockWriteUnlock(&intf.lock_in);
         return rc;
     }
+
+    Result WaitWrite(u32 urb_id, size_t size, u32 interface)
+    {
+        auto &intf = g_usbCommsInterfaces[interface];
+        rwlockWriteLock(&intf.lock_in);
+        while(true)
+        {
+            bool done = false;
+            auto rc = CheckUrb(intf.endpoint_in, urb_id, size, done);
+            if(R_SUCCEEDED(rc) && !done)
+            {
+                rc = eventWait(&intf.endpoint_in->CompletionEvent, UINT64_MAX);
+                eventClear(&intf.endpoint_in->CompletionEvent);
+                if(R_SUCCEEDED(rc)) continue;
+            }
+            rwlockWriteUnlock(&intf.lock_in);
+            return rc;
+        }
+    }
 }
\ No newline at end of file
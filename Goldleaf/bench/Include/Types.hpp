@@ -0,0 +1,59 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+// Bench stand-in for Goldleaf's Types.hpp: no Plutonium, String is a plain std::string with the few pu::String calls the install path makes
+
+#pragma once
+#include <string>
+#include <switch.h>
+#include <ByteBuffer.hpp>
+#include <json.hpp>
+
+using JSON = nlohmann::json;
+
+class String : public std::string
+{
+    public:
+        String()
+        {
+        }
+
+        String(const char *Str) : std::string(Str)
+        {
+        }
+
+        String(const std::string &Str) : std::string(Str)
+        {
+        }
+
+        std::string AsUTF8() const
+        {
+            return *this;
+        }
+};
+
+enum class Storage
+{
+    GameCart = 2,
+    NANDSystem,
+    NANDUser,
+    SdCard,
+};
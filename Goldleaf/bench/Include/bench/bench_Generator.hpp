@@ -0,0 +1,80 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+// Synthetic packages for the bench: standard crypto NCAs encrypted with the keys the spl stand-ins derive, their NCZ versions and the PFS0s holding them
+
+#pragma once
+#include <switch.h>
+#include <string>
+#include <vector>
+
+namespace bench
+{
+    enum class PayloadKind
+    {
+        // Incompressible, like already compressed assets
+        Random,
+        // Zeroed pages, repeated records and some noise, compresses to about a third like typical game data
+        Compressible,
+    };
+
+    struct NcaSpec
+    {
+        // Whole NCA including the header, a multiple of 0x200
+        u64 Size;
+        // 1 to 4 CTR sections evenly splitting the body
+        u32 SectionCount;
+        PayloadKind Payload;
+        u64 Seed;
+        u8 ContentType;
+        u64 ApplicationId;
+        // Optional PFS0 placed at the start of the first section (a meta NCA's CNMT), Size must leave room for it
+        std::vector<u8> SectionPFS0;
+    };
+
+    struct PackageFile
+    {
+        std::string Name;
+        std::vector<u8> Data;
+    };
+
+    std::vector<u8> GenerateNca(const NcaSpec &Spec);
+
+    // Exported with the exporter's own NczCompressor, either as one solid stream or as 1MB blocks
+    std::vector<u8> CompressNca(const std::vector<u8> &Nca, bool Solid);
+
+    // NCZ whose body is split into SectionCount evenly spaced CTR sections, each covering the first half of its share with plain data in between
+    // NcaReader only knows the 4 sections of an NCA header, so it's written directly instead of through NczCompressor; OutNca is what it has to install as
+    void GenerateSparseNcz(u64 Size, u32 SectionCount, u64 Seed, std::vector<u8> &OutNcz, std::vector<u8> &OutNca);
+
+    // Like real contents, the ID is the start of the SHA-256 of the NCA
+    void ComputeContentHash(const std::vector<u8> &Data, u8 *OutHash);
+    NcmContentId GetContentId(const std::vector<u8> &Nca);
+    std::string FormatContentId(const NcmContentId &Id);
+
+    // Application CNMT listing every content (NCAs, not their NCZ versions) as program data
+    std::vector<u8> GenerateContentMeta(u64 ApplicationId, const std::vector<const std::vector<u8>*> &Contents);
+
+    // Meta NCA holding the CNMT in a PFS0 section
+    std::vector<u8> GenerateMetaNca(u64 ApplicationId, const std::vector<u8> &ContentMeta);
+
+    std::vector<u8> BuildPFS0(const std::vector<PackageFile> &Files);
+}
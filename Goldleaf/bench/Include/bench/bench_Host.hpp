@@ -0,0 +1,49 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+// Host-side helpers of the bench: allocation counters, the crypto the generator shares with the spl stand-ins, and the console's core count
+
+#pragma once
+#include <switch.h>
+
+namespace bench
+{
+    struct MemoryStats
+    {
+        u64 Allocations;
+        u64 CurrentBytes;
+        u64 PeakBytes;
+    };
+
+    // Every operator new goes through the counters, so anything the installer code allocates is included
+    MemoryStats GetMemoryStats();
+    // Starts a new measurement: the peak drops to what is allocated right now
+    void ResetPeakMemory();
+
+    void AesEcbEncrypt(const void *Key, const void *Src, void *Dst, size_t Size);
+    void AesEcbDecrypt(const void *Key, const void *Src, void *Dst, size_t Size);
+
+    // Cores reported through svcGetInfo, 3 like what applications get on the console
+    void SetCoreCount(u32 Count);
+    u32 GetCoreCount();
+
+    u64 GetTimeNs();
+}
@@ -0,0 +1,67 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+// Bench stand-in for fs::Explorer: files are kept in memory, with the calls PFS0 and FileStorage make
+
+#pragma once
+#include <Types.hpp>
+#include <map>
+
+namespace fs
+{
+    enum class FileMode : u32
+    {
+        Read = 1,
+        Write,
+        Append,
+    };
+
+    constexpr u64 WorkBufferSize = 0x800000; // 8MB
+
+    u8 *GetWorkBuffer();
+
+    class Explorer
+    {
+        private:
+            std::map<std::string, std::vector<u8>> files;
+            u64 read_count;
+
+        public:
+            Explorer();
+
+            // Generated packages are moved in, so that they aren't copied again
+            void AddFile(String Path, std::vector<u8> Data);
+            std::vector<u8> &GetFileData(String Path);
+            // Reads since the last reset, each one is a round trip over USB on the console
+            u64 GetReadCount();
+            void ResetReadCount();
+
+            u64 ReadFileBlockShared(String Path, u64 Offset, u64 Size, void *Out);
+            u64 GetFileSizeShared(String Path);
+            void EndFileShared();
+
+            void CreateFile(String Path);
+            void DeleteFile(String Path);
+            void StartFile(String Path, FileMode Mode);
+            u64 WriteFileBlock(String Path, void *Data, u64 Size);
+            void EndFile(FileMode Mode);
+    };
+}
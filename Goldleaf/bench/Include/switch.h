@@ -0,0 +1,235 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+// Host stand-ins for the parts of libnx the install path uses, see bench_Switch.cpp
+// Only what the sources built by the bench need is here, with the same names and signatures as libnx
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <pthread.h>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef u32 Result;
+typedef u32 Handle;
+
+#define BIT(n) (1ULL << (n))
+#define PACKED __attribute__((packed))
+#define NX_CONSTEXPR static constexpr inline
+#define NX_INLINE static inline
+
+#define R_SUCCEEDED(res) ((res) == 0)
+#define R_FAILED(res) ((res) != 0)
+#define R_MODULE(res) ((res) & 0x1FF)
+#define R_DESCRIPTION(res) (((res) >> 9) & 0x1FFF)
+#define R_VALUE(res) ((res) & 0x3FFFFF)
+#define MAKERESULT(module, description) ((((module) & 0x1FF)) | ((description) & 0x1FFF) << 9)
+
+enum
+{
+    Module_Kernel = 1,
+    Module_Libnx = 345,
+};
+
+enum
+{
+    LibnxError_BadInput = 1,
+    LibnxError_OutOfMemory,
+    LibnxError_IoError,
+};
+
+#define CUR_PROCESS_HANDLE 0xFFFF8001
+
+typedef enum
+{
+    InfoType_CoreMask = 0,
+} InfoType;
+
+Result svcGetInfo(u64 *out, u32 id0, Handle handle, u64 id1);
+u32 svcGetCurrentProcessorNumber(void);
+
+// Ticks run at the console's 19.2MHz, so that anything converting them works as it does there
+u64 armGetSystemTick(void);
+u64 armTicksToNs(u64 tick);
+
+typedef pthread_mutex_t Mutex;
+
+void mutexInit(Mutex *m);
+void mutexLock(Mutex *m);
+void mutexUnlock(Mutex *m);
+
+typedef pthread_cond_t CondVar;
+
+void condvarInit(CondVar *c);
+Result condvarWait(CondVar *c, Mutex *m);
+Result condvarWakeAll(CondVar *c);
+
+typedef void (*ThreadFunc)(void *);
+
+typedef struct
+{
+    pthread_t handle;
+    ThreadFunc entry;
+    void *arg;
+} Thread;
+
+// Priority and core are ignored, the host scheduler places the threads
+Result threadCreate(Thread *t, ThreadFunc entry, void *arg, void *stack_mem, size_t stack_sz, int prio, int cpuid);
+Result threadStart(Thread *t);
+Result threadWaitForExit(Thread *t);
+Result threadClose(Thread *t);
+
+typedef struct
+{
+    u8 key[0x10];
+    u8 ctr[0x10];
+    u8 keystream[0x10];
+    size_t keystream_offset;
+} Aes128CtrContext;
+
+void aes128CtrContextCreate(Aes128CtrContext *out, const void *key, const void *ctr);
+void aes128CtrContextResetCtr(Aes128CtrContext *ctx, const void *ctr);
+void aes128CtrCrypt(Aes128CtrContext *ctx, void *dst, const void *src, size_t size);
+
+typedef struct
+{
+    u8 keys[0x20];
+    u8 tweak[0x10];
+    bool is_encryptor;
+} Aes128XtsContext;
+
+void aes128XtsContextCreate(Aes128XtsContext *out, const void *key0, const void *key1, bool is_encryptor);
+void aes128XtsContextResetSector(Aes128XtsContext *ctx, uint64_t sector, bool is_nintendo);
+size_t aes128XtsEncrypt(Aes128XtsContext *ctx, void *dst, const void *src, size_t size);
+size_t aes128XtsDecrypt(Aes128XtsContext *ctx, void *dst, const void *src, size_t size);
+
+#define SHA256_HASH_SIZE 0x20
+
+typedef struct
+{
+    void *md_ctx;
+} Sha256Context;
+
+void sha256ContextCreate(Sha256Context *out);
+void sha256ContextUpdate(Sha256Context *ctx, const void *src, size_t size);
+void sha256ContextGetHash(Sha256Context *ctx, void *dst);
+
+// Keys come from a fixed bench master key instead of the console's keyslots, generated content uses the same derivation
+Result splCryptoGenerateAesKek(const void *wrapped_kek, u32 key_generation, u32 option, void *out_sealed_kek);
+Result splCryptoGenerateAesKey(const void *sealed_kek, const void *wrapped_key, void *out_sealed_key);
+
+typedef struct
+{
+    u8 c[0x10];
+} NcmContentId;
+
+typedef struct
+{
+    union
+    {
+        u8 uuid[0x10];
+        u64 uuid_u64[2];
+    } uuid;
+} NcmPlaceHolderId;
+
+typedef struct
+{
+    u64 id;
+    u32 version;
+    u8 type;
+    u8 install_type;
+    u8 padding[2];
+} NcmContentMetaKey;
+
+typedef enum
+{
+    NcmStorageId_None = 0,
+    NcmStorageId_BuiltInUser = 4,
+    NcmStorageId_SdCard = 5,
+} NcmStorageId;
+
+// Content data stands in for the SD card, so it's allocated outside the bench's allocation counters
+template<typename T>
+struct NcmStorageAllocator
+{
+    typedef T value_type;
+
+    NcmStorageAllocator() = default;
+
+    template<typename U>
+    NcmStorageAllocator(const NcmStorageAllocator<U>&)
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        auto ptr = reinterpret_cast<T*>(malloc(n * sizeof(T)));
+        if(ptr == nullptr) throw std::bad_alloc();
+        return ptr;
+    }
+
+    void deallocate(T *ptr, size_t n)
+    {
+        free(ptr);
+    }
+
+    template<typename U>
+    bool operator==(const NcmStorageAllocator<U>&) const
+    {
+        return true;
+    }
+
+    template<typename U>
+    bool operator!=(const NcmStorageAllocator<U>&) const
+    {
+        return false;
+    }
+};
+
+typedef std::vector<u8, NcmStorageAllocator<u8>> NcmStorageData;
+
+// Placeholders and registered contents live in memory, so that what the writers produced can be checked afterwards
+typedef struct
+{
+    std::map<std::string, NcmStorageData> placeholders;
+    std::map<std::string, NcmStorageData> contents;
+    u64 written_size;
+} NcmContentStorage;
+
+Result ncmContentStorageCreatePlaceHolder(NcmContentStorage *cs, const NcmContentId *content_id, const NcmPlaceHolderId *placeholder_id, s64 size);
+Result ncmContentStorageDeletePlaceHolder(NcmContentStorage *cs, const NcmPlaceHolderId *placeholder_id);
+Result ncmContentStorageWritePlaceHolder(NcmContentStorage *cs, const NcmPlaceHolderId *placeholder_id, u64 offset, const void *data, size_t data_size);
+Result ncmContentStorageRegister(NcmContentStorage *cs, const NcmContentId *content_id, const NcmPlaceHolderId *placeholder_id);
+Result ncmContentStorageGetSizeFromContentId(NcmContentStorage *cs, s64 *out_size, const NcmContentId *content_id);
+Result ncmContentStorageReadContentIdFile(NcmContentStorage *cs, void *out_data, size_t out_data_size, const NcmContentId *content_id, s64 offset);
@@ -0,0 +1,393 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <bench/bench_Generator.hpp>
+#include <bench/bench_Host.hpp>
+#include <nsp/nca_Writer.hpp>
+#include <nsp/nsp_Types.hpp>
+#include <ncm/ncm_Types.hpp>
+#include <openssl/evp.h>
+#include <zstd.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace bench
+{
+    namespace
+    {
+        constexpr u64 MediaUnitSize = 0x200;
+
+        // Same sources nca_Writer.cpp derives the header and key area keys from
+        constexpr u8 HeaderKekSource[0x10] = { 0x1F, 0x12, 0x91, 0x3A, 0x4A, 0xCB, 0xF0, 0x0D, 0x4C, 0xDE, 0x3A, 0xF6, 0xD5, 0x23, 0x88, 0x2A };
+        constexpr u8 HeaderKeySource[0x20] = { 0x5A, 0x3E, 0xD8, 0x4F, 0xDE, 0xC0, 0xD8, 0x26, 0x31, 0xF7, 0xE2, 0x5D, 0x19, 0x7B, 0xF5, 0xD0, 0x1C, 0x9B, 0x7B, 0xFA, 0xF6, 0x28, 0x18, 0x3D, 0x71, 0xF6, 0x4D, 0x73, 0xF1, 0x50, 0xB9, 0xD2 };
+        constexpr u8 ApplicationKeyAreaKeySource[0x10] = { 0x7F, 0x59, 0x97, 0x1E, 0x62, 0x9F, 0x36, 0xA1, 0x30, 0x98, 0x06, 0x6F, 0x21, 0x44, 0xC3, 0x0D };
+
+        // xorshift64*, so that every run generates the same packages
+        class Random
+        {
+            private:
+                u64 state;
+
+            public:
+                Random(u64 Seed) : state(Seed ? Seed : 0x9E3779B97F4A7C15)
+                {
+                }
+
+                u64 Next()
+                {
+                    this->state ^= this->state >> 12;
+                    this->state ^= this->state << 25;
+                    this->state ^= this->state >> 27;
+                    return this->state * 0x2545F4914F6CDD1D;
+                }
+
+                void Fill(u8 *Out, u64 Size)
+                {
+                    while(Size >= sizeof(u64))
+                    {
+                        auto value = this->Next();
+                        memcpy(Out, &value, sizeof(value));
+                        Out += sizeof(value);
+                        Size -= sizeof(value);
+                    }
+                    if(Size > 0)
+                    {
+                        auto value = this->Next();
+                        memcpy(Out, &value, Size);
+                    }
+                }
+        };
+
+        void FillPayload(u8 *Out, u64 Size, PayloadKind Kind, Random &Rng)
+        {
+            if(Kind == PayloadKind::Random)
+            {
+                Rng.Fill(Out, Size);
+                return;
+            }
+
+            constexpr u64 PageSize = 0x1000;
+            constexpr u64 RecordSize = 0x40;
+            u8 records[8][RecordSize];
+            Rng.Fill(&records[0][0], sizeof(records));
+            u32 counter = 0;
+            for(u64 offset = 0; offset < Size; offset += PageSize)
+            {
+                auto page = Out + offset;
+                auto page_size = std::min(PageSize, Size - offset);
+                auto kind = Rng.Next() % 10;
+                if(kind < 3) memset(page, 0, page_size);
+                else if(kind < 7)
+                {
+                    auto &record = records[Rng.Next() % 8];
+                    for(u64 i = 0; i < page_size; i += RecordSize)
+                    {
+                        memcpy(page + i, record, std::min(RecordSize, page_size - i));
+                        if((i + sizeof(counter)) <= page_size) memcpy(page + i, &counter, sizeof(counter));
+                        counter++;
+                    }
+                }
+                else Rng.Fill(page, page_size);
+            }
+        }
+
+        void GetHeaderKey(u8 *OutKey)
+        {
+            u8 kek[0x10] = {};
+            splCryptoGenerateAesKek(HeaderKekSource, 0, 0, kek);
+            splCryptoGenerateAesKey(kek, HeaderKeySource, OutKey);
+            splCryptoGenerateAesKey(kek, HeaderKeySource + 0x10, OutKey + 0x10);
+        }
+
+        // Section counters are the upper half of the IV, the lower half is the offset in 16-byte blocks, both big-endian
+        void CtrCrypt(const u8 *Key, u64 Ctr, u64 Offset, u8 *Data, u64 Size)
+        {
+            u8 iv[0x10] = {};
+            for(u32 i = 0; i < 8; i++)
+            {
+                iv[7 - i] = static_cast<u8>(Ctr >> (i * 8));
+                iv[0xF - i] = static_cast<u8>((Offset >> 4) >> (i * 8));
+            }
+            Aes128CtrContext ctx;
+            aes128CtrContextCreate(&ctx, Key, iv);
+            aes128CtrCrypt(&ctx, Data, Data, Size);
+        }
+
+        u64 AlignUp(u64 Value, u64 Align)
+        {
+            return (Value + Align - 1) / Align * Align;
+        }
+
+        void EncryptNcaHeader(const NcaHeader &Header, u8 *Out)
+        {
+            u8 header_key[0x20] = {};
+            GetHeaderKey(header_key);
+            Aes128XtsContext xts;
+            aes128XtsContextCreate(&xts, header_key, header_key + 0x10, true);
+            auto header_data = reinterpret_cast<const u8*>(&Header);
+            for(u64 i = 0; i < (sizeof(Header) / MediaUnitSize); i++)
+            {
+                aes128XtsContextResetSector(&xts, i, true);
+                aes128XtsEncrypt(&xts, Out + (i * MediaUnitSize), header_data + (i * MediaUnitSize), MediaUnitSize);
+            }
+        }
+
+        // NCZ section table entry, as NczBodyWriter reads it
+        struct NczSection
+        {
+            u64 Offset;
+            u64 Size;
+            u8 CryptoType;
+            u8 Pad[0xF];
+            u8 CryptoKey[0x10];
+            u8 CryptoCounter[0x10];
+        } PACKED;
+
+        constexpr u64 NczSectionMagic = 0x4E544345535A434E;
+        constexpr int SparseNczCompressionLevel = 3;
+    }
+
+    std::vector<u8> GenerateNca(const NcaSpec &Spec)
+    {
+        if((Spec.Size <= NCA_HEADER_SIZE) || ((Spec.Size % MediaUnitSize) != 0) || ((NCA_HEADER_SIZE + Spec.SectionPFS0.size()) > Spec.Size)) throw std::invalid_argument("invalid NCA size");
+
+        std::vector<u8> nca(Spec.Size, 0);
+        Random rng(Spec.Seed);
+        FillPayload(nca.data() + NCA_HEADER_SIZE, Spec.Size - NCA_HEADER_SIZE, Spec.Payload, rng);
+        if(!Spec.SectionPFS0.empty()) memcpy(nca.data() + NCA_HEADER_SIZE, Spec.SectionPFS0.data(), Spec.SectionPFS0.size());
+
+        u8 body_key[0x10] = {};
+        rng.Fill(body_key, sizeof(body_key));
+
+        NcaHeader header = {};
+        header.magic = MAGIC_NCA3;
+        header.content_type = Spec.ContentType;
+        header.nca_size = Spec.Size;
+        header.m_titleId = Spec.ApplicationId;
+        header.sdk_version = 0x000C1100;
+
+        // The key area holds the body key wrapped with the application key area key, which is what NcaReader unwraps through spl
+        u8 kek[0x10] = {};
+        splCryptoGenerateAesKek(ApplicationKeyAreaKeySource, 0, 0, kek);
+        AesEcbEncrypt(kek, body_key, header.m_keys + (2 * 0x10), sizeof(body_key));
+
+        const u32 section_count = std::max(1u, std::min(Spec.SectionCount, 4u));
+        const u64 first_unit = NCA_HEADER_SIZE / MediaUnitSize;
+        const u64 unit_count = (Spec.Size - NCA_HEADER_SIZE) / MediaUnitSize;
+        for(u32 i = 0; i < section_count; i++)
+        {
+            auto start = first_unit + (unit_count * i) / section_count;
+            auto end = first_unit + (unit_count * (i + 1)) / section_count;
+            if(end <= start) continue;
+
+            header.section_entries[i].media_start_offset = start;
+            header.section_entries[i].media_end_offset = end;
+
+            auto &fs_header = header.fs_headers[i];
+            fs_header._0x0 = 2;
+            fs_header.crypt_type = 3;
+            fs_header.section_ctr = static_cast<u64>(i + 1) << 32;
+            if((i == 0) && !Spec.SectionPFS0.empty())
+            {
+                // PFS0 superblock, the PFS0 itself starts right at the section
+                fs_header.fs_type = 2;
+                u64 pfs0_offset = 0;
+                memcpy(fs_header.superblock_data + 0x38, &pfs0_offset, sizeof(pfs0_offset));
+            }
+
+            CtrCrypt(body_key, fs_header.section_ctr, start * MediaUnitSize, nca.data() + (start * MediaUnitSize), (end - start) * MediaUnitSize);
+        }
+
+        EncryptNcaHeader(header, nca.data());
+        return nca;
+    }
+
+    void GenerateSparseNcz(u64 Size, u32 SectionCount, u64 Seed, std::vector<u8> &OutNcz, std::vector<u8> &OutNca)
+    {
+        const u64 body_size = Size - NCA_HEADER_SIZE;
+        const u64 share = (body_size / std::max(SectionCount, 1u)) / (2 * MediaUnitSize) * (2 * MediaUnitSize);
+        if((Size <= NCA_HEADER_SIZE) || ((Size % MediaUnitSize) != 0) || (share == 0)) throw std::invalid_argument("invalid sparse NCZ layout");
+
+        OutNca.assign(Size, 0);
+        Random rng(Seed);
+        FillPayload(OutNca.data() + NCA_HEADER_SIZE, body_size, PayloadKind::Compressible, rng);
+        u8 key[0x10] = {};
+        rng.Fill(key, sizeof(key));
+
+        NcaHeader header = {};
+        header.magic = MAGIC_NCA3;
+        header.nca_size = Size;
+        EncryptNcaHeader(header, OutNca.data());
+
+        // Everything past the header is compressed before the sections get encrypted, NCZ bodies are plain
+        OutNcz.assign(OutNca.begin(), OutNca.begin() + NCA_HEADER_SIZE);
+        u64 table_header[2] = { NczSectionMagic, SectionCount };
+        OutNcz.insert(OutNcz.end(), reinterpret_cast<const u8*>(table_header), reinterpret_cast<const u8*>(table_header) + sizeof(table_header));
+        for(u32 i = 0; i < SectionCount; i++)
+        {
+            NczSection section = {};
+            section.Offset = NCA_HEADER_SIZE + (i * share);
+            section.Size = share / 2;
+            section.CryptoType = 3;
+            memcpy(section.CryptoKey, key, sizeof(key));
+            u64 ctr = static_cast<u64>(i + 1) << 32;
+            for(u32 j = 0; j < 8; j++) section.CryptoCounter[7 - j] = static_cast<u8>(ctr >> (j * 8));
+            OutNcz.insert(OutNcz.end(), reinterpret_cast<const u8*>(&section), reinterpret_cast<const u8*>(&section) + sizeof(section));
+        }
+
+        auto body_offset = OutNcz.size();
+        OutNcz.resize(body_offset + ZSTD_compressBound(body_size));
+        auto compressed_size = ZSTD_compress(OutNcz.data() + body_offset, OutNcz.size() - body_offset, OutNca.data() + NCA_HEADER_SIZE, body_size, SparseNczCompressionLevel);
+        if(ZSTD_isError(compressed_size)) throw std::runtime_error("sparse NCZ compression failed");
+        OutNcz.resize(body_offset + compressed_size);
+
+        for(u32 i = 0; i < SectionCount; i++)
+        {
+            u64 offset = NCA_HEADER_SIZE + (i * share);
+            CtrCrypt(key, static_cast<u64>(i + 1) << 32, offset, OutNca.data() + offset, share / 2);
+        }
+    }
+
+    std::vector<u8> CompressNca(const std::vector<u8> &Nca, bool Solid)
+    {
+        std::vector<u8> ncz;
+        auto read = [&](u64 Offset, u64 Size, u8 *Out) -> u64
+        {
+            if(Offset >= Nca.size()) return 0;
+            auto read_size = std::min(Size, Nca.size() - Offset);
+            memcpy(Out, Nca.data() + Offset, read_size);
+            return read_size;
+        };
+        auto write = [&](u64 Offset, const u8 *Data, u64 Size)
+        {
+            if(ncz.size() < (Offset + Size)) ncz.resize(Offset + Size);
+            memcpy(ncz.data() + Offset, Data, Size);
+        };
+
+        NczCompressor compressor(read, Nca.size(), write, Solid);
+        if(!compressor.compress([](u64 Done, u64 Total) {})) throw std::runtime_error("NCZ compression failed");
+        return ncz;
+    }
+
+    void ComputeContentHash(const std::vector<u8> &Data, u8 *OutHash)
+    {
+        EVP_Digest(Data.data(), Data.size(), OutHash, nullptr, EVP_sha256(), nullptr);
+    }
+
+    NcmContentId GetContentId(const std::vector<u8> &Nca)
+    {
+        u8 hash[0x20] = {};
+        ComputeContentHash(Nca, hash);
+        NcmContentId id = {};
+        memcpy(id.c, hash, sizeof(id.c));
+        return id;
+    }
+
+    std::string FormatContentId(const NcmContentId &Id)
+    {
+        char id[0x21] = {};
+        for(u32 i = 0; i < sizeof(Id.c); i++) snprintf(id + (i * 2), 3, "%02x", Id.c[i]);
+        return id;
+    }
+
+    std::vector<u8> GenerateContentMeta(u64 ApplicationId, const std::vector<const std::vector<u8>*> &Contents)
+    {
+        ncm::ContentMetaHeader header = {};
+        header.ApplicationId = ApplicationId;
+        header.Type = ncm::ContentMetaType::Application;
+        header.ExtendedHeaderSize = sizeof(ncm::ApplicationMetaExtendedHeader);
+        header.ContentCount = Contents.size();
+
+        ncm::ApplicationMetaExtendedHeader ext_header = {};
+        ext_header.PatchApplicationId = ApplicationId + 0x800;
+
+        std::vector<u8> cnmt(sizeof(header) + sizeof(ext_header) + (sizeof(ncm::HashedContentRecord) * Contents.size()) + 0x20, 0);
+        memcpy(cnmt.data(), &header, sizeof(header));
+        memcpy(cnmt.data() + sizeof(header), &ext_header, sizeof(ext_header));
+        auto records = reinterpret_cast<ncm::HashedContentRecord*>(cnmt.data() + sizeof(header) + sizeof(ext_header));
+        for(size_t i = 0; i < Contents.size(); i++)
+        {
+            auto &content = *Contents[i];
+            ComputeContentHash(content, records[i].Hash);
+            memcpy(records[i].Record.ContentId.c, records[i].Hash, sizeof(records[i].Record.ContentId.c));
+            u64 size = content.size();
+            memcpy(records[i].Record.Size, &size, sizeof(records[i].Record.Size));
+            records[i].Record.Type = (i == 0) ? ncm::ContentType::Program : ncm::ContentType::Data;
+        }
+        return cnmt;
+    }
+
+    std::vector<u8> GenerateMetaNca(u64 ApplicationId, const std::vector<u8> &ContentMeta)
+    {
+        char name[0x40] = {};
+        snprintf(name, sizeof(name), "Application_%016lx.cnmt", ApplicationId);
+
+        NcaSpec spec = {};
+        spec.SectionPFS0 = BuildPFS0({ { name, ContentMeta } });
+        spec.Size = NCA_HEADER_SIZE + AlignUp(spec.SectionPFS0.size(), MediaUnitSize);
+        spec.SectionCount = 1;
+        spec.Payload = PayloadKind::Compressible;
+        spec.Seed = ApplicationId;
+        spec.ContentType = 1;
+        spec.ApplicationId = ApplicationId;
+        return GenerateNca(spec);
+    }
+
+    std::vector<u8> BuildPFS0(const std::vector<PackageFile> &Files)
+    {
+        std::vector<nsp::PFS0FileEntry> entries;
+        std::string strings;
+        u64 data_size = 0;
+        for(auto &file: Files)
+        {
+            nsp::PFS0FileEntry entry = {};
+            entry.Offset = data_size;
+            entry.Size = file.Data.size();
+            entry.StringTableOffset = strings.size();
+            entries.push_back(entry);
+            strings.append(file.Name);
+            strings.push_back('\0');
+            data_size += file.Data.size();
+        }
+
+        // Padded like the tools building NSPs do, so that the file data starts 0x20-aligned
+        auto tables_size = sizeof(nsp::PFS0Header) + (sizeof(nsp::PFS0FileEntry) * entries.size()) + strings.size();
+        strings.resize(strings.size() + (AlignUp(tables_size, 0x20) - tables_size), '\0');
+
+        nsp::PFS0Header header = {};
+        header.Magic = nsp::Magic;
+        header.FileCount = entries.size();
+        header.StringTableSize = strings.size();
+
+        std::vector<u8> pfs0;
+        pfs0.reserve(sizeof(header) + (sizeof(nsp::PFS0FileEntry) * entries.size()) + strings.size() + data_size);
+        auto append = [&](const void *Data, u64 Size)
+        {
+            auto ptr = reinterpret_cast<const u8*>(Data);
+            pfs0.insert(pfs0.end(), ptr, ptr + Size);
+        };
+        append(&header, sizeof(header));
+        append(entries.data(), sizeof(nsp::PFS0FileEntry) * entries.size());
+        append(strings.data(), strings.size());
+        for(auto &file: Files) append(file.Data.data(), file.Data.size());
+        return pfs0;
+    }
+}
@@ -0,0 +1,223 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <bench/bench_Host.hpp>
+#include <fs/fs_Explorer.hpp>
+#include <hos/hos_Titles.hpp>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+namespace
+{
+    std::atomic<u64> g_Allocations(0);
+    std::atomic<u64> g_CurrentBytes(0);
+    std::atomic<u64> g_PeakBytes(0);
+
+    void *TrackAllocation(void *Ptr)
+    {
+        if(Ptr == nullptr) throw std::bad_alloc();
+        auto cur = g_CurrentBytes.fetch_add(malloc_usable_size(Ptr)) + malloc_usable_size(Ptr);
+        auto peak = g_PeakBytes.load();
+        while((cur > peak) && !g_PeakBytes.compare_exchange_weak(peak, cur));
+        g_Allocations++;
+        return Ptr;
+    }
+
+    void TrackFree(void *Ptr)
+    {
+        if(Ptr == nullptr) return;
+        g_CurrentBytes -= malloc_usable_size(Ptr);
+        free(Ptr);
+    }
+
+    void *AlignedAlloc(size_t Size, std::align_val_t Align)
+    {
+        auto align = static_cast<size_t>(Align);
+        return aligned_alloc(align, ((Size + align - 1) / align) * align);
+    }
+}
+
+void *operator new(size_t Size)
+{
+    return TrackAllocation(malloc(Size));
+}
+
+void *operator new[](size_t Size)
+{
+    return TrackAllocation(malloc(Size));
+}
+
+void *operator new(size_t Size, std::align_val_t Align)
+{
+    return TrackAllocation(AlignedAlloc(Size, Align));
+}
+
+void *operator new[](size_t Size, std::align_val_t Align)
+{
+    return TrackAllocation(AlignedAlloc(Size, Align));
+}
+
+void operator delete(void *Ptr) noexcept
+{
+    TrackFree(Ptr);
+}
+
+void operator delete[](void *Ptr) noexcept
+{
+    TrackFree(Ptr);
+}
+
+void operator delete(void *Ptr, size_t Size) noexcept
+{
+    TrackFree(Ptr);
+}
+
+void operator delete[](void *Ptr, size_t Size) noexcept
+{
+    TrackFree(Ptr);
+}
+
+void operator delete(void *Ptr, std::align_val_t Align) noexcept
+{
+    TrackFree(Ptr);
+}
+
+void operator delete[](void *Ptr, std::align_val_t Align) noexcept
+{
+    TrackFree(Ptr);
+}
+
+void operator delete(void *Ptr, size_t Size, std::align_val_t Align) noexcept
+{
+    TrackFree(Ptr);
+}
+
+void operator delete[](void *Ptr, size_t Size, std::align_val_t Align) noexcept
+{
+    TrackFree(Ptr);
+}
+
+namespace bench
+{
+    MemoryStats GetMemoryStats()
+    {
+        return { g_Allocations.load(), g_CurrentBytes.load(), g_PeakBytes.load() };
+    }
+
+    void ResetPeakMemory()
+    {
+        g_PeakBytes = g_CurrentBytes.load();
+    }
+}
+
+namespace hos
+{
+    std::string FormatApplicationId(u64 ApplicationId)
+    {
+        char id[0x20] = {};
+        snprintf(id, sizeof(id), "%016lX", ApplicationId);
+        return id;
+    }
+}
+
+namespace fs
+{
+    u8 *GetWorkBuffer()
+    {
+        static u8 *work_buf = new (std::align_val_t(0x1000)) u8[WorkBufferSize]();
+        return work_buf;
+    }
+
+    Explorer::Explorer() : read_count(0)
+    {
+    }
+
+    void Explorer::AddFile(String Path, std::vector<u8> Data)
+    {
+        this->files[Path] = std::move(Data);
+    }
+
+    std::vector<u8> &Explorer::GetFileData(String Path)
+    {
+        return this->files[Path];
+    }
+
+    u64 Explorer::GetReadCount()
+    {
+        return this->read_count;
+    }
+
+    void Explorer::ResetReadCount()
+    {
+        this->read_count = 0;
+    }
+
+    u64 Explorer::ReadFileBlockShared(String Path, u64 Offset, u64 Size, void *Out)
+    {
+        auto it = this->files.find(Path);
+        if((it == this->files.end()) || (Offset >= it->second.size())) return 0;
+        auto read_size = std::min(Size, it->second.size() - Offset);
+        memcpy(Out, it->second.data() + Offset, read_size);
+        this->read_count++;
+        return read_size;
+    }
+
+    u64 Explorer::GetFileSizeShared(String Path)
+    {
+        auto it = this->files.find(Path);
+        if(it == this->files.end()) return 0;
+        return it->second.size();
+    }
+
+    void Explorer::EndFileShared()
+    {
+    }
+
+    void Explorer::CreateFile(String Path)
+    {
+        this->files[Path].clear();
+    }
+
+    void Explorer::DeleteFile(String Path)
+    {
+        this->files.erase(Path);
+    }
+
+    void Explorer::StartFile(String Path, FileMode Mode)
+    {
+        if(Mode == FileMode::Write) this->files[Path].clear();
+    }
+
+    u64 Explorer::WriteFileBlock(String Path, void *Data, u64 Size)
+    {
+        auto &file = this->files[Path];
+        auto ptr = reinterpret_cast<const u8*>(Data);
+        file.insert(file.end(), ptr, ptr + Size);
+        return Size;
+    }
+
+    void Explorer::EndFile(FileMode Mode)
+    {
+    }
+}
@@ -0,0 +1,456 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+// Host benchmark of the install path: the real PFS0/CNMT parsers, NcaWriter and install pipeline run over synthetic packages, with libnx replaced by bench_Switch.cpp
+// Throughput is per scenario, allocations and peak memory are whatever the installer code allocated while it ran (placeholders and pipeline rings are not included)
+
+#include <bench/bench_Generator.hpp>
+#include <bench/bench_Host.hpp>
+#include <err/err_Result.hpp>
+#include <fs/fs_FileSystem.hpp>
+#include <nsp/nca_Writer.hpp>
+#include <nsp/nsp_PFS0.hpp>
+#include <nsp/nsp_Pipeline.hpp>
+#include <ncm/ncm_ContentMeta.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <stdexcept>
+
+namespace
+{
+    constexpr u64 ApplicationId = 0x0100000000010000;
+    constexpr u64 MB = 0x100000;
+
+    struct Options
+    {
+        u64 SizeMB = 64;
+        u32 Cores = 3;
+        std::string Filter;
+    };
+
+    Options g_Options;
+
+    struct Measurement
+    {
+        std::string Name;
+        u64 Bytes;
+        u64 Ns;
+        // Only set for NCZ installs, time spent re-encrypting out of the total
+        u64 EncryptBytes;
+        u64 EncryptNs;
+        u64 Allocations;
+        u64 PeakBytes;
+        bool Ok;
+        std::string Note;
+    };
+
+    bool IsEnabled(const std::string &Name)
+    {
+        return g_Options.Filter.empty() || (Name.find(g_Options.Filter) != std::string::npos);
+    }
+
+    std::string FormatRate(u64 Bytes, u64 Ns)
+    {
+        if(Ns == 0) return "-";
+        char rate[0x20] = {};
+        snprintf(rate, sizeof(rate), "%.1f", ((double)Bytes / (double)MB) / ((double)Ns / 1000000000.0));
+        return rate;
+    }
+
+    std::string FormatMemory(u64 Bytes)
+    {
+        char size[0x20] = {};
+        if(Bytes >= MB) snprintf(size, sizeof(size), "%.1fM", (double)Bytes / (double)MB);
+        else snprintf(size, sizeof(size), "%.1fK", (double)Bytes / 1024.0);
+        return size;
+    }
+
+    void PrintHeader()
+    {
+        printf("\n%-36s %9s %9s %9s %9s %9s %9s  %s\n", "scenario", "size MB", "MB/s", "decode", "encrypt", "allocs", "peak", "check");
+    }
+
+    void Print(const Measurement &M)
+    {
+        static bool header_printed = false;
+        if(!header_printed)
+        {
+            PrintHeader();
+            header_printed = true;
+        }
+
+        auto decode = M.EncryptBytes ? FormatRate(M.Bytes, M.Ns - std::min(M.Ns, M.EncryptNs)) : std::string("-");
+        auto encrypt = M.EncryptBytes ? FormatRate(M.EncryptBytes, M.EncryptNs) : std::string("-");
+        printf("%-36s %9.1f %9s %9s %9s %9lu %9s  %s%s%s\n", M.Name.c_str(), (double)M.Bytes / (double)MB, FormatRate(M.Bytes, M.Ns).c_str(), decode.c_str(), encrypt.c_str(), M.Allocations, FormatMemory(M.PeakBytes).c_str(), M.Ok ? "ok" : "FAILED", M.Note.empty() ? "" : ", ", M.Note.c_str());
+        fflush(stdout);
+    }
+
+    // Times Run, counting only the allocations made while it runs; errors thrown by the installer code fail the measurement
+    Measurement Measure(const std::string &Name, u64 Bytes, const std::function<void()> &Run)
+    {
+        Measurement m = {};
+        m.Name = Name;
+        m.Bytes = Bytes;
+        m.Ok = true;
+
+        bench::ResetPeakMemory();
+        auto before = bench::GetMemoryStats();
+        auto start = bench::GetTimeNs();
+        try
+        {
+            Run();
+        }
+        catch(const char *err)
+        {
+            m.Ok = false;
+            m.Note = err;
+        }
+        catch(std::exception &e)
+        {
+            m.Ok = false;
+            m.Note = e.what();
+        }
+        m.Ns = bench::GetTimeNs() - start;
+        auto after = bench::GetMemoryStats();
+        m.Allocations = after.Allocations - before.Allocations;
+        m.PeakBytes = after.PeakBytes - before.CurrentBytes;
+        return m;
+    }
+
+    // Feeds Source (a plain NCA or an NCZ) through the install pipeline and NcaWriter like an install does, the placeholder has to end up as Nca
+    Measurement InstallContent(const std::string &Name, const std::vector<u8> &Source, const std::vector<u8> &Nca)
+    {
+        NcmContentStorage storage = {};
+        auto content_id = bench::GetContentId(Nca);
+        NcmPlaceHolderId placeholder_id = {};
+        memcpy(placeholder_id.uuid.uuid, content_id.c, sizeof(placeholder_id.uuid.uuid));
+
+        nsp::InstallTelemetry telemetry;
+        // The installer reuses it for every content
+        nsp::ContentPipeline pipeline(&storage, &telemetry);
+        auto m = Measure(Name, Nca.size(), [&]()
+        {
+            NcaWriter writer(content_id, placeholder_id, &storage, [&](u64 Offset, const u8 *Data, u64 Size)
+            {
+                pipeline.Write(Offset, Data, Size);
+            });
+            writer.setTelemetry(&telemetry);
+            writer.setOutput([&](u64 Offset, u64 MinSize, u64 &Size) -> u8*
+            {
+                return pipeline.AcquireOutput(Offset, MinSize, Size);
+            });
+            telemetry.Start();
+            auto rc = pipeline.Start(placeholder_id, 0, Source.size(), [&](u64 Offset, u64 Size, u8 *Out) -> u64
+            {
+                memcpy(Out, Source.data() + Offset, Size);
+                return Size;
+            });
+            if(R_FAILED(rc)) throw "failed to start the install pipeline";
+            try
+            {
+                while(true)
+                {
+                    auto block = pipeline.ReadBlock();
+                    if(block == nullptr) break;
+                    writer.write(block->Data, block->Size);
+                    pipeline.ReleaseBlock();
+                }
+                writer.close();
+            }
+            catch(...)
+            {
+                pipeline.Abort(err::result::ResultInvalidNSP);
+                pipeline.Finish();
+                throw;
+            }
+            rc = pipeline.Finish();
+            telemetry.Stop();
+            if(R_FAILED(rc)) throw "install pipeline failed";
+        });
+
+        auto encrypt = telemetry.GetStats(nsp::InstallStage::Encrypt);
+        m.EncryptBytes = encrypt.Bytes;
+        m.EncryptNs = encrypt.BusyNs;
+        auto &placeholder = storage.placeholders[std::string(reinterpret_cast<const char*>(placeholder_id.uuid.uuid), sizeof(placeholder_id.uuid.uuid))];
+        if(m.Ok && ((placeholder.size() != Nca.size()) || (memcmp(placeholder.data(), Nca.data(), Nca.size()) != 0)))
+        {
+            m.Ok = false;
+            m.Note = "placeholder differs from the original NCA";
+        }
+        if(Source.size() != Nca.size())
+        {
+            char ratio[0x40] = {};
+            snprintf(ratio, sizeof(ratio), "NCZ is %.0f%% of the NCA", (double)Source.size() * 100.0 / (double)Nca.size());
+            m.Note += (m.Note.empty() ? "" : ", ") + std::string(ratio);
+        }
+        return m;
+    }
+
+    void ParsePFS0(const std::string &Name, fs::Explorer &Exp, const std::string &Path, u32 Iterations)
+    {
+        auto &data = Exp.GetFileData(Path);
+        nsp::PFS0 reference(&Exp, Path);
+        auto header_size = reference.GetFileOffset(0);
+        auto last_file = reference.GetFile(reference.GetCount() - 1);
+        bool ok = true;
+
+        Exp.ResetReadCount();
+        auto m = Measure(Name, header_size * Iterations, [&]()
+        {
+            for(u32 i = 0; i < Iterations; i++)
+            {
+                nsp::PFS0 pfs0(&Exp, Path);
+                ok &= pfs0.IsOk() && (pfs0.GetCount() == reference.GetCount()) && (pfs0.GetFileIndexByName(last_file) == (reference.GetCount() - 1));
+            }
+        });
+        m.Ok &= ok;
+
+        char note[0x80] = {};
+        snprintf(note, sizeof(note), "%u files, %.1f reads per parse", reference.GetCount(), (double)Exp.GetReadCount() / (double)Iterations);
+        m.Note += (m.Note.empty() ? "" : ", ") + std::string(note);
+
+        // Nested containers are views of a storage which may already be in memory, those get parsed in place
+        auto nested = Measure(Name + " (in memory)", header_size * Iterations, [&]()
+        {
+            auto storage = std::make_shared<fs::MemoryStorage>(data.data(), data.size());
+            for(u32 i = 0; i < Iterations; i++)
+            {
+                nsp::PFS0 pfs0(storage);
+                ok &= pfs0.IsOk() && (pfs0.GetCount() == reference.GetCount());
+            }
+        });
+        nested.Ok &= ok;
+        Print(m);
+        Print(nested);
+    }
+
+    // What the installer does with the meta NCA: buffer it, read the CNMT out of it and build the install content meta
+    Measurement ParseContentMeta(const std::string &Name, fs::Explorer &Exp, const std::string &Path, u32 Iterations)
+    {
+        nsp::PFS0 pfs0(&Exp, Path);
+        u32 meta_idx = nsp::PFS0::InvalidFileIndex;
+        for(u32 i = 0; i < pfs0.GetCount(); i++)
+        {
+            if(pfs0.GetFile(i).find(".cnmt.nca") != std::string::npos) meta_idx = i;
+        }
+        if(nsp::PFS0::IsInvalidFileIndex(meta_idx))
+        {
+            Measurement m = {};
+            m.Name = Name;
+            m.Note = "no meta NCA";
+            return m;
+        }
+
+        auto meta_size = pfs0.GetFileSize(meta_idx);
+        u32 content_count = 0;
+        auto m = Measure(Name, meta_size * Iterations, [&]()
+        {
+            for(u32 i = 0; i < Iterations; i++)
+            {
+                std::vector<u8> meta_nca(meta_size);
+                pfs0.ReadFromFile(meta_idx, 0, meta_size, meta_nca.data());
+                auto storage = std::make_shared<fs::MemoryStorage>(std::move(meta_nca));
+                NcaReader reader([&](u64 Offset, u64 Size, u8 *Out) -> u64
+                {
+                    return storage->Read(Offset, Size, Out);
+                });
+                auto files = reader.files();
+                if(files.empty()) throw "no CNMT in the meta NCA";
+
+                std::vector<u8> cnmt_data;
+                if(!reader.readFile(files.front(), cnmt_data)) throw "failed to read the CNMT";
+                ncm::ContentMeta cnmt(cnmt_data.data(), cnmt_data.size());
+                auto key = cnmt.GetContentMetaKey();
+                if(key.id != ApplicationId) throw "wrong application ID in the CNMT";
+
+                ByteBuffer install_meta;
+                ncm::ContentRecord meta_record = {};
+                cnmt.GetInstallContentMeta(install_meta, meta_record, false);
+                content_count = cnmt.GetContentRecords().size();
+            }
+        });
+        Exp.EndFileShared();
+
+        char note[0x40] = {};
+        snprintf(note, sizeof(note), "%u contents", content_count);
+        m.Note += (m.Note.empty() ? "" : ", ") + std::string(note);
+        return m;
+    }
+
+    const char *GetPayloadName(bench::PayloadKind Kind)
+    {
+        return (Kind == bench::PayloadKind::Random) ? "random" : "compressible";
+    }
+
+    // Plain NCA writes (just placeholder writes), then the same NCA from a solid and from a block compressed NCZ
+    void RunInstallScenarios()
+    {
+        std::vector<u64> sizes = { std::max(g_Options.SizeMB / 8, (u64)1), g_Options.SizeMB };
+        for(auto payload: { bench::PayloadKind::Random, bench::PayloadKind::Compressible })
+        {
+            for(auto size: sizes)
+            {
+                for(u32 sections: { 1u, 4u })
+                {
+                    char suffix[0x40] = {};
+                    snprintf(suffix, sizeof(suffix), "/%s/%lluM/%us", GetPayloadName(payload), (unsigned long long)size, sections);
+                    std::string placeholder_name = std::string("placeholder") + suffix;
+                    std::string solid_name = std::string("ncz-solid") + suffix;
+                    std::string block_name = std::string("ncz-block") + suffix;
+                    if(!IsEnabled(placeholder_name) && !IsEnabled(solid_name) && !IsEnabled(block_name)) continue;
+
+                    bench::NcaSpec spec = {};
+                    spec.Size = size * MB;
+                    spec.SectionCount = sections;
+                    spec.Payload = payload;
+                    spec.Seed = size * 16 + sections;
+                    spec.ApplicationId = ApplicationId;
+                    auto nca = bench::GenerateNca(spec);
+
+                    if(IsEnabled(placeholder_name)) Print(InstallContent(placeholder_name, nca, nca));
+                    if(IsEnabled(solid_name)) Print(InstallContent(solid_name, bench::CompressNca(nca, true), nca));
+                    if(IsEnabled(block_name)) Print(InstallContent(block_name, bench::CompressNca(nca, false), nca));
+                }
+            }
+        }
+    }
+
+    // An NSP and its NSZ with a program NCA, a couple of small data NCAs and the meta NCA, plus a PFS0 with many small files like a DLC bundle
+    void RunPFS0Scenarios()
+    {
+        if(!IsEnabled("pfs0") && !IsEnabled("cnmt")) return;
+
+        fs::Explorer exp;
+        std::vector<std::vector<u8>> ncas;
+        for(u32 i = 0; i < 3; i++)
+        {
+            bench::NcaSpec spec = {};
+            spec.Size = (i == 0) ? (8 * MB) : (MB / 2);
+            spec.SectionCount = (i == 0) ? 4 : 1;
+            spec.Payload = bench::PayloadKind::Compressible;
+            spec.Seed = 100 + i;
+            spec.ContentType = (i == 0) ? 0 : 2;
+            spec.ApplicationId = ApplicationId;
+            ncas.push_back(bench::GenerateNca(spec));
+        }
+
+        std::vector<const std::vector<u8>*> contents;
+        for(auto &nca: ncas) contents.push_back(&nca);
+        auto meta_nca = bench::GenerateMetaNca(ApplicationId, bench::GenerateContentMeta(ApplicationId, contents));
+        auto meta_name = bench::FormatContentId(bench::GetContentId(meta_nca)) + ".cnmt.nca";
+
+        std::vector<bench::PackageFile> nsp_files;
+        std::vector<bench::PackageFile> nsz_files;
+        for(auto &nca: ncas)
+        {
+            auto id = bench::FormatContentId(bench::GetContentId(nca));
+            nsp_files.push_back({ id + ".nca", nca });
+            nsz_files.push_back({ id + ".ncz", bench::CompressNca(nca, false) });
+        }
+        nsp_files.push_back({ meta_name, meta_nca });
+        nsz_files.push_back({ meta_name, meta_nca });
+        exp.AddFile("bench.nsp", bench::BuildPFS0(nsp_files));
+        exp.AddFile("bench.nsz", bench::BuildPFS0(nsz_files));
+
+        std::vector<bench::PackageFile> many_files;
+        for(u32 i = 0; i < 2000; i++)
+        {
+            char name[0x40] = {};
+            snprintf(name, sizeof(name), "%032x.nca", i * 0x9E3779B9u);
+            many_files.push_back({ name, std::vector<u8>(0x40, static_cast<u8>(i)) });
+        }
+        exp.AddFile("many.nsp", bench::BuildPFS0(many_files));
+
+        if(IsEnabled("pfs0/nsp")) ParsePFS0("pfs0/nsp", exp, "bench.nsp", 20000);
+        if(IsEnabled("pfs0/nsz")) ParsePFS0("pfs0/nsz", exp, "bench.nsz", 20000);
+        if(IsEnabled("pfs0/2000-files")) ParsePFS0("pfs0/2000-files", exp, "many.nsp", 200);
+        if(IsEnabled("cnmt/nsp")) Print(ParseContentMeta("cnmt/nsp", exp, "bench.nsp", 2000));
+    }
+
+    // NczCtrEngine on its own: the same compressible body split into more and more sections, every layout encrypting the same half of it,
+    // so that the cost of finding the sections shows up against AES itself (the rate is over all the bytes the engine went through)
+    void RunCtrScenarios()
+    {
+        if(!IsEnabled("ctr")) return;
+
+        printf("\n%-36s %9s %9s %12s %9s %9s %9s  %s\n", "scenario", "size MB", "sections", "encrypt GB/s", "MB/s", "allocs", "peak", "check");
+        for(u32 sections: { 1u, 4u, 64u, 1024u, 16384u })
+        {
+            char name[0x40] = {};
+            snprintf(name, sizeof(name), "ctr/%llu-sections", (unsigned long long)sections);
+            if(!IsEnabled(name)) continue;
+
+            // Every section needs at least a media unit, plus a gap of the same size
+            std::vector<u8> ncz;
+            std::vector<u8> nca;
+            try
+            {
+                bench::GenerateSparseNcz(g_Options.SizeMB * MB, sections, sections, ncz, nca);
+            }
+            catch(std::invalid_argument&)
+            {
+                printf("%-36s %9.1f %9u  skipped, too many sections for this size\n", name, (double)g_Options.SizeMB, sections);
+                continue;
+            }
+            auto m = InstallContent(name, ncz, nca);
+            char encrypt[0x20] = "-";
+            if(m.EncryptNs > 0) snprintf(encrypt, sizeof(encrypt), "%.2f", (double)m.EncryptBytes / (double)m.EncryptNs);
+            printf("%-36s %9.1f %9u %12s %9s %9lu %9s  %s%s%s\n", m.Name.c_str(), (double)m.Bytes / (double)MB, sections, encrypt, FormatRate(m.Bytes, m.Ns).c_str(), m.Allocations, FormatMemory(m.PeakBytes).c_str(), m.Ok ? "ok" : "FAILED", m.Note.empty() ? "" : ", ", m.Note.c_str());
+            fflush(stdout);
+        }
+    }
+
+    void PrintUsage(const char *Name)
+    {
+        printf("Usage: %s [--size <MB>] [--cores <count>] [--filter <text>]\n", Name);
+        printf("  --size    size of the bigger generated NCAs, the smaller ones are 1/8 of it (default 64)\n");
+        printf("  --cores   cores the installer code sees, like the 3 applications get on the console (default 3)\n");
+        printf("  --filter  only run scenarios whose name contains this\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(((arg == "--size") || (arg == "--cores") || (arg == "--filter")) && ((i + 1) < argc))
+        {
+            std::string value = argv[++i];
+            if(arg == "--size") g_Options.SizeMB = std::max(strtoull(value.c_str(), nullptr, 10), 1ull);
+            else if(arg == "--cores") g_Options.Cores = strtoul(value.c_str(), nullptr, 10);
+            else g_Options.Filter = value;
+        }
+        else
+        {
+            PrintUsage(argv[0]);
+            return (arg == "--help") ? 0 : 1;
+        }
+    }
+
+    bench::SetCoreCount(g_Options.Cores);
+    printf("Goldleaf install bench: %u cores, %llu MB contents\n", bench::GetCoreCount(), (unsigned long long)g_Options.SizeMB);
+    RunPFS0Scenarios();
+    RunInstallScenarios();
+    RunCtrScenarios();
+    return 0;
+}
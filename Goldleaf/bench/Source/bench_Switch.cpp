@@ -0,0 +1,364 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <switch.h>
+#include <bench/bench_Host.hpp>
+#include <openssl/evp.h>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace
+{
+    // Stands in for the console's master key, every key the bench uses is derived from it
+    constexpr u8 BenchMasterKey[0x10] = { 0x47, 0x6F, 0x6C, 0x64, 0x6C, 0x65, 0x61, 0x66, 0x20, 0x62, 0x65, 0x6E, 0x63, 0x68, 0x00, 0x00 };
+
+    u32 g_CoreCount = 3;
+
+    struct CipherContext
+    {
+        EVP_CIPHER_CTX *ctx;
+
+        CipherContext() : ctx(EVP_CIPHER_CTX_new())
+        {
+        }
+
+        ~CipherContext()
+        {
+            EVP_CIPHER_CTX_free(ctx);
+        }
+    };
+
+    void EcbCrypt(const void *Key, const void *Src, void *Dst, size_t Size, bool Encrypt)
+    {
+        thread_local CipherContext cipher;
+        int out_size = 0;
+        if((EVP_CipherInit_ex(cipher.ctx, EVP_aes_128_ecb(), nullptr, reinterpret_cast<const u8*>(Key), nullptr, Encrypt ? 1 : 0) != 1) || (EVP_CIPHER_CTX_set_padding(cipher.ctx, 0) != 1) || (EVP_CipherUpdate(cipher.ctx, reinterpret_cast<u8*>(Dst), &out_size, reinterpret_cast<const u8*>(Src), Size) != 1)) throw std::runtime_error("AES-ECB failed");
+    }
+
+    void IncrementCounter(u8 *Ctr, u64 Blocks)
+    {
+        for(int i = 0xF; (i >= 0) && (Blocks != 0); i--)
+        {
+            Blocks += Ctr[i];
+            Ctr[i] = static_cast<u8>(Blocks);
+            Blocks >>= 8;
+        }
+    }
+}
+
+namespace bench
+{
+    void AesEcbEncrypt(const void *Key, const void *Src, void *Dst, size_t Size)
+    {
+        EcbCrypt(Key, Src, Dst, Size, true);
+    }
+
+    void AesEcbDecrypt(const void *Key, const void *Src, void *Dst, size_t Size)
+    {
+        EcbCrypt(Key, Src, Dst, Size, false);
+    }
+
+    void SetCoreCount(u32 Count)
+    {
+        g_CoreCount = std::max(1u, std::min(Count, 64u));
+    }
+
+    u32 GetCoreCount()
+    {
+        return g_CoreCount;
+    }
+
+    u64 GetTimeNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+Result svcGetInfo(u64 *out, u32 id0, Handle handle, u64 id1)
+{
+    if(id0 != InfoType_CoreMask) return MAKERESULT(Module_Kernel, 120);
+    *out = (g_CoreCount >= 64) ? UINT64_MAX : (BIT(g_CoreCount) - 1);
+    return 0;
+}
+
+u32 svcGetCurrentProcessorNumber(void)
+{
+    return 0;
+}
+
+u64 armGetSystemTick(void)
+{
+    // 19.2 ticks per microsecond
+    return bench::GetTimeNs() * 12 / 625;
+}
+
+u64 armTicksToNs(u64 tick)
+{
+    return (tick * 625) / 12;
+}
+
+void mutexInit(Mutex *m)
+{
+    pthread_mutex_init(m, nullptr);
+}
+
+void mutexLock(Mutex *m)
+{
+    pthread_mutex_lock(m);
+}
+
+void mutexUnlock(Mutex *m)
+{
+    pthread_mutex_unlock(m);
+}
+
+void condvarInit(CondVar *c)
+{
+    pthread_cond_init(c, nullptr);
+}
+
+Result condvarWait(CondVar *c, Mutex *m)
+{
+    pthread_cond_wait(c, m);
+    return 0;
+}
+
+Result condvarWakeAll(CondVar *c)
+{
+    pthread_cond_broadcast(c);
+    return 0;
+}
+
+static void *ThreadTrampoline(void *arg)
+{
+    auto t = reinterpret_cast<Thread*>(arg);
+    t->entry(t->arg);
+    return nullptr;
+}
+
+Result threadCreate(Thread *t, ThreadFunc entry, void *arg, void *stack_mem, size_t stack_sz, int prio, int cpuid)
+{
+    t->entry = entry;
+    t->arg = arg;
+    return 0;
+}
+
+Result threadStart(Thread *t)
+{
+    if(pthread_create(&t->handle, nullptr, &ThreadTrampoline, t) != 0) return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    return 0;
+}
+
+Result threadWaitForExit(Thread *t)
+{
+    pthread_join(t->handle, nullptr);
+    return 0;
+}
+
+Result threadClose(Thread *t)
+{
+    return 0;
+}
+
+// The context is only freed once the hash is taken, which is always the case in the install path
+void sha256ContextCreate(Sha256Context *out)
+{
+    auto md_ctx = EVP_MD_CTX_new();
+    if((md_ctx == nullptr) || (EVP_DigestInit_ex(md_ctx, EVP_sha256(), nullptr) != 1)) throw std::runtime_error("SHA-256 failed");
+    out->md_ctx = md_ctx;
+}
+
+void sha256ContextUpdate(Sha256Context *ctx, const void *src, size_t size)
+{
+    if(EVP_DigestUpdate(reinterpret_cast<EVP_MD_CTX*>(ctx->md_ctx), src, size) != 1) throw std::runtime_error("SHA-256 failed");
+}
+
+void sha256ContextGetHash(Sha256Context *ctx, void *dst)
+{
+    auto md_ctx = reinterpret_cast<EVP_MD_CTX*>(ctx->md_ctx);
+    EVP_DigestFinal_ex(md_ctx, reinterpret_cast<u8*>(dst), nullptr);
+    EVP_MD_CTX_free(md_ctx);
+    ctx->md_ctx = nullptr;
+}
+
+void aes128CtrContextCreate(Aes128CtrContext *out, const void *key, const void *ctr)
+{
+    memcpy(out->key, key, sizeof(out->key));
+    aes128CtrContextResetCtr(out, ctr);
+}
+
+void aes128CtrContextResetCtr(Aes128CtrContext *ctx, const void *ctr)
+{
+    memcpy(ctx->ctr, ctr, sizeof(ctx->ctr));
+    ctx->keystream_offset = sizeof(ctx->keystream);
+}
+
+void aes128CtrCrypt(Aes128CtrContext *ctx, void *dst, const void *src, size_t size)
+{
+    auto out = reinterpret_cast<u8*>(dst);
+    auto in = reinterpret_cast<const u8*>(src);
+
+    // Whatever is left of the last partial block first
+    while((ctx->keystream_offset < sizeof(ctx->keystream)) && (size > 0))
+    {
+        *out++ = *in++ ^ ctx->keystream[ctx->keystream_offset++];
+        size--;
+    }
+
+    // Whole blocks through OpenSSL, which only needs the key schedule redone when the key changes
+    const size_t blocks_size = size & ~static_cast<size_t>(0xF);
+    if(blocks_size > 0)
+    {
+        thread_local CipherContext cipher;
+        thread_local u8 cipher_key[0x10];
+        thread_local bool has_key = false;
+        bool same_key = has_key && (memcmp(cipher_key, ctx->key, sizeof(cipher_key)) == 0);
+        int out_size = 0;
+        if((EVP_EncryptInit_ex(cipher.ctx, same_key ? nullptr : EVP_aes_128_ctr(), nullptr, same_key ? nullptr : ctx->key, ctx->ctr) != 1) || (EVP_EncryptUpdate(cipher.ctx, out, &out_size, in, blocks_size) != 1)) throw std::runtime_error("AES-CTR failed");
+        memcpy(cipher_key, ctx->key, sizeof(cipher_key));
+        has_key = true;
+        IncrementCounter(ctx->ctr, blocks_size / 0x10);
+        out += blocks_size;
+        in += blocks_size;
+        size -= blocks_size;
+    }
+
+    if(size > 0)
+    {
+        EcbCrypt(ctx->key, ctx->ctr, ctx->keystream, sizeof(ctx->keystream), true);
+        IncrementCounter(ctx->ctr, 1);
+        ctx->keystream_offset = 0;
+        while(size > 0)
+        {
+            *out++ = *in++ ^ ctx->keystream[ctx->keystream_offset++];
+            size--;
+        }
+    }
+}
+
+void aes128XtsContextCreate(Aes128XtsContext *out, const void *key0, const void *key1, bool is_encryptor)
+{
+    memcpy(out->keys, key0, 0x10);
+    memcpy(out->keys + 0x10, key1, 0x10);
+    memset(out->tweak, 0, sizeof(out->tweak));
+    out->is_encryptor = is_encryptor;
+}
+
+void aes128XtsContextResetSector(Aes128XtsContext *ctx, uint64_t sector, bool is_nintendo)
+{
+    // Nintendo's tweak is the sector number as a big-endian 128-bit integer, standard XTS uses little-endian
+    memset(ctx->tweak, 0, sizeof(ctx->tweak));
+    for(u32 i = 0; i < 8; i++)
+    {
+        if(is_nintendo) ctx->tweak[0xF - i] = static_cast<u8>(sector >> (i * 8));
+        else ctx->tweak[i] = static_cast<u8>(sector >> (i * 8));
+    }
+}
+
+static size_t XtsCrypt(Aes128XtsContext *ctx, void *dst, const void *src, size_t size, bool encrypt)
+{
+    thread_local CipherContext cipher;
+    int out_size = 0;
+    if((EVP_CipherInit_ex(cipher.ctx, EVP_aes_128_xts(), nullptr, ctx->keys, ctx->tweak, encrypt ? 1 : 0) != 1) || (EVP_CipherUpdate(cipher.ctx, reinterpret_cast<u8*>(dst), &out_size, reinterpret_cast<const u8*>(src), size) != 1)) throw std::runtime_error("AES-XTS failed");
+    return size;
+}
+
+size_t aes128XtsEncrypt(Aes128XtsContext *ctx, void *dst, const void *src, size_t size)
+{
+    return XtsCrypt(ctx, dst, src, size, true);
+}
+
+size_t aes128XtsDecrypt(Aes128XtsContext *ctx, void *dst, const void *src, size_t size)
+{
+    return XtsCrypt(ctx, dst, src, size, false);
+}
+
+Result splCryptoGenerateAesKek(const void *wrapped_kek, u32 key_generation, u32 option, void *out_sealed_kek)
+{
+    u8 master_key[0x10];
+    memcpy(master_key, BenchMasterKey, sizeof(master_key));
+    master_key[0xF] = static_cast<u8>(key_generation);
+    bench::AesEcbDecrypt(master_key, wrapped_kek, out_sealed_kek, 0x10);
+    return 0;
+}
+
+Result splCryptoGenerateAesKey(const void *sealed_kek, const void *wrapped_key, void *out_sealed_key)
+{
+    bench::AesEcbDecrypt(sealed_kek, wrapped_key, out_sealed_key, 0x10);
+    return 0;
+}
+
+static std::string MakeIdKey(const void *Id)
+{
+    return std::string(reinterpret_cast<const char*>(Id), 0x10);
+}
+
+static constexpr Result ResultBadInput = MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+Result ncmContentStorageCreatePlaceHolder(NcmContentStorage *cs, const NcmContentId *content_id, const NcmPlaceHolderId *placeholder_id, s64 size)
+{
+    auto &data = cs->placeholders[MakeIdKey(placeholder_id)];
+    data.clear();
+    data.resize(size);
+    return 0;
+}
+
+Result ncmContentStorageDeletePlaceHolder(NcmContentStorage *cs, const NcmPlaceHolderId *placeholder_id)
+{
+    if(cs->placeholders.erase(MakeIdKey(placeholder_id)) == 0) return ResultBadInput;
+    return 0;
+}
+
+Result ncmContentStorageWritePlaceHolder(NcmContentStorage *cs, const NcmPlaceHolderId *placeholder_id, u64 offset, const void *data, size_t data_size)
+{
+    auto it = cs->placeholders.find(MakeIdKey(placeholder_id));
+    if(it == cs->placeholders.end()) return ResultBadInput;
+    if((offset + data_size) > it->second.size()) return ResultBadInput;
+    memcpy(it->second.data() + offset, data, data_size);
+    cs->written_size += data_size;
+    return 0;
+}
+
+Result ncmContentStorageRegister(NcmContentStorage *cs, const NcmContentId *content_id, const NcmPlaceHolderId *placeholder_id)
+{
+    auto it = cs->placeholders.find(MakeIdKey(placeholder_id));
+    if(it == cs->placeholders.end()) return ResultBadInput;
+    cs->contents[MakeIdKey(content_id)] = std::move(it->second);
+    cs->placeholders.erase(it);
+    return 0;
+}
+
+Result ncmContentStorageGetSizeFromContentId(NcmContentStorage *cs, s64 *out_size, const NcmContentId *content_id)
+{
+    auto it = cs->contents.find(MakeIdKey(content_id));
+    if(it == cs->contents.end()) return ResultBadInput;
+    *out_size = it->second.size();
+    return 0;
+}
+
+Result ncmContentStorageReadContentIdFile(NcmContentStorage *cs, void *out_data, size_t out_data_size, const NcmContentId *content_id, s64 offset)
+{
+    auto it = cs->contents.find(MakeIdKey(content_id));
+    if((it == cs->contents.end()) || ((offset + out_data_size) > it->second.size())) return ResultBadInput;
+    memcpy(out_data, it->second.data() + offset, out_data_size);
+    return 0;
+}
@@ -27,6 +27,7 @@ import java.nio.file.FileSystems;
 import java.nio.file.Files;
 import java.nio.file.Path;
 import java.nio.file.Paths;
+import java.util.Arrays;
 import java.util.Vector;
 
 public class FileSystem
@@ -104,6 +105,14 @@ public class FileSystem
         return files;
     }
 
+    // Sorted by name, so that a listing requested in several pages is always in the same order
+    public static File[] listEntries(String path)
+    {
+        File[] all = new File(path).listFiles();
+        if(all != null) Arrays.sort(all);
+        return all;
+    }
+
     public static String normalizePath(String path)
     {
         String normalized = path.replace('\\', '/').replace("//", "/");
@@ -23,7 +23,12 @@ package xorTroll.goldleaf.quark.ui;
 
 import java.io.File;
 import java.io.RandomAccessFile;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.charset.Charset;
+import java.util.Arrays;
 import java.util.Enumeration;
+import java.util.concurrent.CompletableFuture;
 import java.util.Optional;
 import java.util.Vector;
 
@@ -51,6 +56,7 @@ import xorTroll.goldleaf.quark.Logging;
 import xorTroll.goldleaf.quark.Version;
 import xorTroll.goldleaf.quark.fs.FileSystem;
 import xorTroll.goldleaf.quark.usb.Command;
+import xorTroll.goldleaf.quark.usb.Compression;
 import xorTroll.goldleaf.quark.usb.USBInterface;
 
 public class MainApplication extends Application
@@ -58,6 +64,9 @@ public class MainApplication extends Application
     public static final Version QuarkVersion = new Version(0, 4, 0);
     public static final Version MinimumGoldleafVersion = new Version(0, 8, 0);
 
+    // Maximum size of the entries sent after each ListDirectory response
+    private static final int ListingPageSize = 0x100000;
+
     private static final int WIDTH = 900;
     private static final int HEIGHT = 400;
 
@@ -65,11 +74,21 @@ public class MainApplication extends Application
     public Stage stage;
     public Scene scene;
     
+    // What the connected Goldleaf told in its Hello, older ones don't send it at all
+    public int goldleafProtocolVersion = 1;
+    public int goldleafMaxPayloadSize = 0;
+    public int goldleafFeatures = 0;
+    public long goldleafPreferredTransferSize = 0;
+
     public RandomAccessFile readfile = null;
     public RandomAccessFile writefile = null;
 
     public USBInterface usbInterface = null;
+    // Null if the connected Goldleaf only has the data interface
+    public USBInterface controlInterface = null;
+    private Thread controlThread = null;
     public String openedpath = null;
+    public Vector<String> drives = null;
 
     public Object selectlock = new Object();
     public boolean selected = false;
@@ -81,8 +100,621 @@ public class MainApplication extends Application
     public Object cfglock = new Object();
     public Config cfg;
 
+    private static class StreamBlock
+    {
+        public int size;
+        public int encoding;
+        public byte[] payload;
+    }
+
+    // Null if the file couldn't be read
+    private static CompletableFuture<StreamBlock> prepareStreamBlock(RandomAccessFile file, long offset, int size, int codecs)
+    {
+        return CompletableFuture.supplyAsync(() ->
+        {
+            try
+            {
+                StreamBlock block = new StreamBlock();
+                byte[] data = new byte[size];
+                file.seek(offset);
+                file.readFully(data);
+                block.size = size;
+                block.encoding = Compression.EncodingRaw;
+                block.payload = data;
+                byte[] compressed = ((codecs & Compression.CodecZstd) != 0) ? Compression.compress(data) : null;
+                if(compressed != null)
+                {
+                    block.encoding = Compression.EncodingZstd;
+                    block.payload = compressed;
+                }
+                return block;
+            }
+            catch(Exception e)
+            {
+                return null;
+            }
+        });
+    }
+
+    // Pushes consecutive blocks while Goldleaf has granted credits, and only reads commands (more credits or a cancel) after using them all
+    // Goldleaf grants a credit back as it receives each block, so the next one is normally already queued and reading it doesn't wait
+    // The next block is read (and compressed) on another thread while the current one is sent, so Goldleaf rarely has to wait for the disk
+    private void streamFile(RandomAccessFile file, long offset, long length, int blocksize, int credits, int codecs)
+    {
+        long pos = offset;
+        long end = offset + length;
+        CompletableFuture<StreamBlock> next = prepareStreamBlock(file, pos, (int)Math.min(blocksize, end - pos), codecs);
+        try
+        {
+            while(pos < end)
+            {
+                if(credits == 0)
+                {
+                    Command msg = new Command(usbInterface);
+                    if(!msg.isValid()) return;
+                    if(msg.read32() != Command.GLCI) return;
+                    int msgid = msg.read32();
+                    if(Command.Id.StreamCredit.compare(msgid))
+                    {
+                        credits += msg.read32();
+                        continue;
+                    }
+                    // A cancel, or anything else which can't be sent while streaming, ends the stream
+                    if(Command.Id.StreamCancel.compare(msgid)) msg.respondEmpty();
+                    else msg.respondFailure(0xDEAD);
+                    return;
+                }
+                StreamBlock block = next.join();
+                if(block == null)
+                {
+                    // Goldleaf stops at the failed block, it doesn't send anything else for this stream
+                    Command.sendStreamBlockHeader(usbInterface, 0xDEAD, 0, codecs, Compression.EncodingRaw, 0);
+                    return;
+                }
+                pos += block.size;
+                if(pos < end) next = prepareStreamBlock(file, pos, (int)Math.min(blocksize, end - pos), codecs);
+                if(!Command.sendStreamBlockHeader(usbInterface, 0, block.size, codecs, block.encoding, block.payload.length)) return;
+                if(!usbInterface.writeBytes(block.payload)) return;
+                credits--;
+            }
+        }
+        finally
+        {
+            // The file might be used (or closed) by other commands right after this
+            next.join();
+        }
+    }
+
+    private int getSupportedFeatures()
+    {
+        if(controlInterface != null) return Command.SupportedFeatures;
+        return Command.SupportedFeatures & ~Command.FeatureControlInterface;
+    }
+
+    // Goldleaf only sends commands through it once Hello told it that Quark listens there, listings and stats then don't wait behind file transfers
+    private void startControlInterface()
+    {
+        Optional<USBInterface> intf = usbInterface.openSibling(USBInterface.ControlInterface);
+        if(!intf.isPresent())
+        {
+            Logging.log("No control interface, every command goes through the data interface");
+            return;
+        }
+        USBInterface ctrl = intf.get();
+        controlInterface = ctrl;
+        controlThread = new Thread(() ->
+        {
+            while(true)
+            {
+                Command c = new Command(ctrl);
+                // Reconnecting is up to the data interface loop
+                if(!c.isValid()) break;
+                if(c.read32() == Command.GLCI) processCommand(c);
+            }
+        });
+        controlThread.setDaemon(true);
+        controlThread.start();
+    }
+
+    private void stopControlInterface()
+    {
+        if(controlInterface != null)
+        {
+            // The thread may be waiting on a read, the shared handle can only be closed once it's gone
+            controlInterface.stop();
+            try
+            {
+                controlThread.join();
+            }
+            catch(InterruptedException e)
+            {
+                Thread.currentThread().interrupt();
+            }
+            controlInterface.finalize();
+            controlInterface = null;
+            controlThread = null;
+        }
+    }
+
+    // Commands from both interfaces end up here, each interface from its own thread
+    private void processCommand(Command c)
+    {
+        int cmdid = c.read32();
+        Command.Id id = Command.Id.from32(cmdid);
+        Logging.log("Command: " + id.toString());
+        switch(id)
+        {
+            case GetDriveCount:
+            {
+                drives = FileSystem.listDrives();
+                c.responseStart();
+                c.write32(drives.size());
+                c.responseEnd();
+                break;
+            }
+            case GetDriveInfo:
+            {
+                if(drives == null) drives = FileSystem.listDrives();
+                int idx = c.read32();
+                if(idx < drives.size())
+                {
+                    String drive = drives.elementAt(idx);
+                    c.responseStart();
+                    c.writeString(FileSystem.getDriveLabel(drive));
+                    c.writeString(drive);
+                    c.write32(0);
+                    c.write32(0);
+                    c.responseEnd();
+                }
+                else c.respondFailure(0xDEAD);
+                break;
+            }
+            case StatPath:
+            {
+                String path = FileSystem.denormalizePath(c.readString());
+                try
+                {
+                    File f = new File(path);
+                    int type = 0;
+                    long filesz = 0;
+                    if(f.isFile())
+                    {
+                        type = 1;
+                        filesz = f.length();
+                    }
+                    if(f.isDirectory()) type = 2;
+                    if(type == 0) c.respondFailure(0xDEAD);
+                    else
+                    {
+                        c.responseStart();
+                        c.write32(type);
+                        c.write64(filesz);
+                        c.responseEnd();
+                    }
+                }
+                catch(Exception e)
+                {
+                    c.respondFailure(0xDEAD);
+                }
+                break;
+            }
+            case GetFileCount:
+            {
+                String path = FileSystem.denormalizePath(c.readString());
+                int count = FileSystem.getFilesIn(path).size();
+                c.responseStart();
+                c.write32(count);
+                c.responseEnd();
+                break;
+            }
+            case GetFile:
+            {
+                String path = FileSystem.denormalizePath(c.readString());
+                int idx = c.read32();
+                Vector<String> files = FileSystem.getFilesIn(path);
+                if(idx < files.size())
+                {
+                    c.responseStart();
+                    c.writeString(files.elementAt(idx));
+                    c.responseEnd();
+                }
+                else c.respondFailure(0xDEAD);
+                break;
+            }
+            case GetDirectoryCount:
+            {
+                String path = FileSystem.denormalizePath(c.readString());
+                int count = FileSystem.getDirectoriesIn(path).size();
+                c.responseStart();
+                c.write32(count);
+                c.responseEnd();
+                break;
+            }
+            case GetDirectory:
+            {
+                String path = FileSystem.denormalizePath(c.readString());
+                int idx = c.read32();
+                Vector<String> dirs = FileSystem.getDirectoriesIn(path);
+                if(idx < dirs.size())
+                {
+                    c.responseStart();
+                    c.writeString(dirs.elementAt(idx));
+                    c.responseEnd();
+                }
+                else c.respondFailure(0xDEAD);
+                break;
+            }
+            case StartFile:
+            {
+                String path = FileSystem.denormalizePath(c.readString());
+                int mode = c.read32();
+                if(mode == 1)
+                {
+                    if(readfile != null) readfile.close();
+                    readfile = new RandomAccessFile(path, "r");
+                }
+                else
+                {
+                    if(writefile != null) writefile.close();
+                    writefile = new RandomAccessFile(path, "rw");
+                    if(mode == 3) writefile.seek(writefile.length());
+                }
+                c.respondEmpty();
+
+                break;
+            }
+            case ReadFile:
+            {
+                String path = FileSystem.denormalizePath(c.readString());
+                long offset = c.read64();
+                long size = c.read64();
+                int codecs = c.read32();
+                try
+                {
+                    byte[] block = new byte[(int)size];
+                    int read = 0;
+                    if(readfile != null)
+                    {
+                        readfile.seek(offset);
+                        read = readfile.read(block, 0, (int)size);
+                    }
+                    else
+                    {
+                        RandomAccessFile raf = new RandomAccessFile(path, "r");
+                        raf.seek(offset);
+                        read = raf.read(block, 0, (int)size);
+                        raf.close();
+                    }
+                    c.responseStart();
+                    c.write64((long)read);
+                    byte[] payload = block;
+                    if(codecs != 0)
+                    {
+                        // Older Goldleafs don't send any codecs, and get the raw payload without its encoding
+                        byte[] compressed = ((codecs & Compression.CodecZstd) != 0) ? Compression.compress(block) : null;
+                        if(compressed != null) payload = compressed;
+                        c.write32((compressed != null) ? Compression.EncodingZstd : Compression.EncodingRaw);
+                        c.write64(payload.length);
+                    }
+                    c.responseEnd();
+                    c.sendBuffer(payload);
+                }
+                catch(Exception e)
+                {
+                    c.respondFailure(0xDEAD);
+                }
+                break;
+            }
+            case WriteFile:
+            {
+                String path = FileSystem.denormalizePath(c.readString());
+                long size = c.read64();
+                int encoding = c.read32();
+                long wiresize = (encoding != Compression.EncodingRaw) ? c.read64() : size;
+                byte[] data = c.getBuffer((int)wiresize);
+                try
+                {
+                    if(encoding == Compression.EncodingZstd) data = Compression.decompress(data, (int)size);
+                    else if(encoding != Compression.EncodingRaw) throw new Exception("Unknown encoding");
+                    if(writefile != null)
+                    {
+                        writefile.write(data);
+                        c.respondEmpty();
+                    }
+                    else
+                    {
+                        RandomAccessFile raf = new RandomAccessFile(path, "rw");
+                        raf.write(data);
+                        raf.close();
+                        c.respondEmpty();
+                    }
+                }
+                catch(Exception e)
+                {
+                    c.respondFailure(0xDEAD);
+                }
+                break;
+            }
+            case EndFile:
+            {
+                int mode = c.read32();
+                if(mode == 1)
+                {
+                    if(readfile != null)
+                    {
+                        readfile.close();
+                        readfile = null;
+                    }
+                }
+                else
+                {
+                    if(writefile != null)
+                    {
+                        writefile.close();
+                        writefile = null;
+                    }
+                }
+                c.respondEmpty();
+
+                break;
+            }
+            case Create:
+            {
+                int type = c.read32();
+                String path = FileSystem.denormalizePath(c.readString());
+                try
+                {
+                    if(type == 1) new File(path).createNewFile();
+                    else if(type == 2) new File(path).mkdir();
+                    c.respondEmpty();
+                }
+                catch(Exception e)
+                {
+                    c.respondFailure(0xDEAD);
+                }
+                break;
+            }
+            case Delete:
+            {
+                int type = c.read32();
+                String path = FileSystem.denormalizePath(c.readString());
+                try
+                {
+                    if((type == 1) || (type == 2)) FileSystem.deletePath(new File(path));
+                    c.respondEmpty();
+                }
+                catch(Exception e)
+                {
+                    c.respondFailure(0xDEAD);
+                }
+                break;
+            }
+            case Rename:
+            {
+                int type = c.read32();
+                String path = FileSystem.denormalizePath(c.readString());
+                String newpath = FileSystem.denormalizePath(c.readString());
+                if((type != 1) && (type != 2)) c.respondFailure(0xDEAD);
+                else
+                {
+                    try
+                    {
+                        File p = new File(path);
+                        p.renameTo(new File(p.getParent(), newpath));
+                        c.respondEmpty();
+                    }
+                    catch(Exception e)
+                    {
+                        c.respondFailure(0xDEAD);
+                    }
+                }
+                break;
+            }
+            case GetSpecialPathCount:
+            {
+                c.responseStart();
+                synchronized(cfglock)
+                {
+                    c.write32(cfg.data.size());
+                }
+                c.responseEnd();
+                break;
+            }
+            case GetSpecialPath:
+            {
+                int idx = c.read32();
+                synchronized(cfglock)
+                {
+                    if(idx < cfg.data.size())
+                    {
+                        int tmpidx = 0;
+                        Enumeration<?> enums = cfg.data.propertyNames();
+                        while(enums.hasMoreElements())
+                        {
+                            String key = (String)enums.nextElement();
+                            String value = cfg.data.getProperty(key);
+                            if(tmpidx == idx)
+                            {
+                                c.responseStart();
+                                c.writeString(key);
+                                c.writeString(FileSystem.normalizePath(value));
+                                c.responseEnd();
+                                break;
+                            }
+                            tmpidx++;
+                        }
+                    }
+                    else c.respondFailure(0xDEAD);
+                }
+                break;
+            }
+            case SelectFile:
+            {
+                selected = false;
+                Platform.runLater(() ->
+                {
+                    synchronized(selectlock)
+                    {
+                        File tmpfile = new FileChooser().showOpenDialog(primaryStage);
+                        if(tmpfile != null) selectedfile = tmpfile.toString();
+                        selected = true;
+                    }
+                });
+                while(true)
+                {
+                    synchronized(selectlock)
+                    {
+                        if(selected) break;
+                    }
+                }
+                if(selectedfile != null)
+                {
+                    c.responseStart();
+                    c.writeString(FileSystem.normalizePath(selectedfile));
+                    c.responseEnd();
+                }
+                else c.respondFailure(0xDEAD);
+                break;
+            }
+            case ListDirectory:
+            {
+                String path = FileSystem.denormalizePath(c.readString());
+                int offset = c.read32();
+                File[] entries = FileSystem.listEntries(path);
+                if(entries == null) c.respondFailure(0xDEAD);
+                else
+                {
+                    // Type, size, modification time and name of as many entries as fit in a page
+                    int pagesize = (goldleafMaxPayloadSize > 0) ? Math.min(ListingPageSize, goldleafMaxPayloadSize) : ListingPageSize;
+                    ByteBuffer page = ByteBuffer.allocate(pagesize);
+                    page.order(ByteOrder.LITTLE_ENDIAN);
+                    int count = 0;
+                    for(int i = offset; i < entries.length; i++)
+                    {
+                        File f = entries[i];
+                        String name = f.getName();
+                        byte[] rawname = name.getBytes(Charset.forName("UTF_16LE"));
+                        if(page.remaining() < (24 + rawname.length)) break;
+                        boolean isdir = f.isDirectory();
+                        page.putInt(isdir ? 2 : 1);
+                        page.putLong(isdir ? 0 : f.length());
+                        page.putLong(f.lastModified() / 1000);
+                        page.putInt(rawname.length / 2);
+                        page.put(rawname);
+                        count++;
+                    }
+                    c.responseStart();
+                    c.write32(entries.length);
+                    c.write32(count);
+                    c.write64(page.position());
+                    c.responseEnd();
+                    if(page.position() > 0) c.sendBuffer(Arrays.copyOf(page.array(), page.position()));
+                }
+                break;
+            }
+            case StreamFile:
+            {
+                String path = FileSystem.denormalizePath(c.readString());
+                long offset = c.read64();
+                long blocksize = c.read64();
+                int credits = c.read32();
+                int codecs = c.read32();
+                RandomAccessFile raf = null;
+                long length = 0;
+                try
+                {
+                    raf = (readfile != null) ? readfile : new RandomAccessFile(path, "r");
+                    length = Math.max(0, raf.length() - offset);
+                }
+                catch(Exception e)
+                {
+                    raf = null;
+                }
+                if((raf == null) || (blocksize <= 0) || (blocksize > Integer.MAX_VALUE)) c.respondFailure(0xDEAD);
+                else
+                {
+                    c.responseStart();
+                    c.write64(length);
+                    c.responseEnd();
+                    if(length > 0) streamFile(raf, offset, length, (int)blocksize, credits, codecs);
+                }
+                if((raf != null) && (raf != readfile))
+                {
+                    try
+                    {
+                        raf.close();
+                    }
+                    catch(Exception e)
+                    {
+                    }
+                }
+                break;
+            }
+            case Hello:
+            {
+                goldleafProtocolVersion = c.read32();
+                goldleafMaxPayloadSize = c.read32();
+                goldleafFeatures = c.read32() & getSupportedFeatures();
+                goldleafPreferredTransferSize = c.read64();
+                Logging.log("Goldleaf protocol version " + goldleafProtocolVersion + ", features 0x" + Integer.toHexString(goldleafFeatures));
+                c.responseStart();
+                c.write32(Command.ProtocolVersion);
+                c.write32(Command.MaxPayloadSize);
+                c.write32(getSupportedFeatures());
+                c.write64(Command.PreferredTransferSize);
+                c.responseEnd();
+                break;
+            }
+            case Echo:
+            {
+                int value = c.read32();
+                c.responseStart();
+                c.write32(value);
+                c.responseEnd();
+                break;
+            }
+            case Sink:
+            {
+                // Goldleaf sends the data right after the command, and only waits for the response after all of it
+                long total = c.read64();
+                int chunk = c.read32();
+                if(usbInterface.sinkBytes(total, chunk)) c.respondEmpty();
+                else c.respondFailure(0xDEAD);
+                break;
+            }
+            case Source:
+            {
+                // Goldleaf only starts receiving once it gets the response
+                long total = c.read64();
+                int chunk = c.read32();
+                c.respondEmpty();
+                usbInterface.sourceBytes(total, chunk);
+                break;
+            }
+            case StreamCredit:
+            {
+                // Credits are only meaningful while streaming (one sent just before a failed block ends up here), and they never get a response
+                break;
+            }
+            case StreamCancel:
+            {
+                // The stream already ended by itself
+                c.respondEmpty();
+                break;
+            }
+            default:
+            {
+                // Goldleaf falls back to older commands when a newer one fails, so it must always get a response
+                Logging.log("Unknown Id: " + cmdid);
+                c.respondFailure(0xDEAD);
+                break;
+            }
+        }
+    }
+
     public void die()
     {
+        stopControlInterface();
         if(usbInterface != null) usbInterface.finalize();
         Platform.exit();
         System.exit(0);
@@ -162,12 +794,13 @@ public class MainApplication extends Application
                 if(usbInterface.productVersion.olderThan(MinimumGoldleafVersion)) showDialog("Outdated Goldleaf", "The Goldleaf Quark connected to is outdated.\nPlease update to v0.8 or higher.", "Ok", true);
                 if(usbInterface.isDevVersion) showDialog("Development version", "The connected Goldleaf (v" + usbInterface.productVersion.toString() + ") is a development build.\nThis build might be unstable. Use it at your own risk!", "Ok", false);
                 updateMessage("Connected to Goldleaf v" + usbInterface.productVersion.toString() + (usbInterface.isDevVersion ? " (dev build)" : "") + " - Processing USB input...");
-                Vector<String> drives = null;
+                startControlInterface();
                 while(true)
                 {
                     Command c = new Command(usbInterface);
                     if(!c.isValid())
                     {
+                        stopControlInterface();
                         usbInterface.finalize();
                         usbInterface = null;
                         showDialog("Bad USB response", "USB isn't responding corrently (Goldleaf has been closed?, USB cable stopped working?)\n\n - If you want to reconnect, close this dialog and Quark will attempt to do so.\n - If no connection is found again Quark will close.\n\n - If you want to exit Quark, close this dialog.", "Ok", false);
@@ -176,6 +809,13 @@ public class MainApplication extends Application
                         {
                             updateMessage("Reconnected! Processing USB input from Goldleaf...");
                             usbInterface = intf2.get();
+                            // It might be a different Goldleaf, which will send its own Hello (or none at all)
+                            goldleafProtocolVersion = 1;
+                            goldleafMaxPayloadSize = 0;
+                            goldleafFeatures = 0;
+                            goldleafPreferredTransferSize = 0;
+                            drives = null;
+                            startControlInterface();
                             continue;
                         }
                         else
@@ -186,339 +826,7 @@ public class MainApplication extends Application
                     int magic = c.read32();
                     if(magic == Command.GLCI)
                     {
-                        int cmdid = c.read32();
-                        Command.Id id = Command.Id.from32(cmdid);
-                        Logging.log("Command: " + id.toString());
-                        switch(id)
-                        {
-                            case GetDriveCount:
-                            {
-                                drives = FileSystem.listDrives();
-                                c.responseStart();
-                                c.write32(drives.size());
-                                c.responseEnd();
-                                break;
-                            }
-                            case GetDriveInfo:
-                            {
-                                if(drives == null) drives = FileSystem.listDrives();
-                                int idx = c.read32();
-                                if(idx < drives.size())
-                                {
-                                    String drive = drives.elementAt(idx);
-                                    c.responseStart();
-                                    c.writeString(FileSystem.getDriveLabel(drive));
-                                    c.writeString(drive);
-                                    c.write32(0);
-                                    c.write32(0);
-                                    c.responseEnd();
-                                }
-                                else c.respondFailure(0xDEAD);
-                                break;
-                            }
-                            case StatPath:
-                            {
-                                String path = FileSystem.denormalizePath(c.readString());
-                                try
-                                {
-                                    File f = new File(path);
-                                    int type = 0;
-                                    long filesz = 0;
-                                    if(f.isFile())
-                                    {
-                                        type = 1;
-                                        filesz = f.length();
-                                    }
-                                    if(f.isDirectory()) type = 2;
-                                    if(type == 0) c.respondFailure(0xDEAD);
-                                    else
-                                    {
-                                        c.responseStart();
-                                        c.write32(type);
-                                        c.write64(filesz);
-                                        c.responseEnd();
-                                    }
-                                }
-                                catch(Exception e)
-                                {
-                                    c.respondFailure(0xDEAD);
-                                }
-                                break;
-                            }
-                            case GetFileCount:
-                            {
-                                String path = FileSystem.denormalizePath(c.readString());
-                                int count = FileSystem.getFilesIn(path).size();
-                                c.responseStart();
-                                c.write32(count);
-                                c.responseEnd();
-                                break;
-                            }
-                            case GetFile:
-                            {
-                                String path = FileSystem.denormalizePath(c.readString());
-                                int idx = c.read32();
-                                Vector<String> files = FileSystem.getFilesIn(path);
-                                if(idx < files.size())
-                                {
-                                    c.responseStart();
-                                    c.writeString(files.elementAt(idx));
-                                    c.responseEnd();
-                                }
-                                else c.respondFailure(0xDEAD);
-                                break;
-                            }
-                            case GetDirectoryCount:
-                            {
-                                String path = FileSystem.denormalizePath(c.readString());
-                                int count = FileSystem.getDirectoriesIn(path).size();
-                                c.responseStart();
-                                c.write32(count);
-                                c.responseEnd();
-                                break;
-                            }
-                            case GetDirectory:
-                            {
-                                String path = FileSystem.denormalizePath(c.readString());
-                                int idx = c.read32();
-                                Vector<String> dirs = FileSystem.getDirectoriesIn(path);
-                                if(idx < dirs.size())
-                                {
-                                    c.responseStart();
-                                    c.writeString(dirs.elementAt(idx));
-                                    c.responseEnd();
-                                }
-                                else c.respondFailure(0xDEAD);
-                                break;
-                            }
-                            case StartFile:
-                            {
-                                String path = FileSystem.denormalizePath(c.readString());
-                                int mode = c.read32();
-                                if(mode == 1)
-                                {
-                                    if(readfile != null) readfile.close();
-                                    readfile = new RandomAccessFile(path, "r");
-                                }
-                                else
-                                {
-                                    if(writefile != null) writefile.close();
-                                    writefile = new RandomAccessFile(path, "rw");
-                                    if(mode == 3) writefile.seek(writefile.length());
-                                }
-                                c.respondEmpty();
-
-                                break;
-                            }
-                            case ReadFile:
-                            {
-                                String path = FileSystem.denormalizePath(c.readString());
-                                long offset = c.read64();
-                                long size = c.read64();
-                                try
-                                {
-                                    if(readfile != null)
-                                    {
-                                        byte[] block = new byte[(int)size];
-                                        readfile.seek(offset);
-                                        int read = readfile.read(block, 0, (int)size);
-                                        c.responseStart();
-                                        c.write64((long)read);
-                                        c.responseEnd();
-                                        c.sendBuffer(block);
-                                    }
-                                    else
-                                    {
-                                        RandomAccessFile raf = new RandomAccessFile(path, "r");
-                                        byte[] block = new byte[(int)size];
-                                        raf.seek(offset);
-                                        int read = raf.read(block, 0, (int)size);
-                                        raf.close();
-                                        c.responseStart();
-                                        c.write64((long)read);
-                                        c.responseEnd();
-                                        c.sendBuffer(block);
-                                    }
-                                }
-                                catch(Exception e)
-                                {
-                                    c.respondFailure(0xDEAD);
-                                }
-                                break;
-                            }
-                            case WriteFile:
-                            {
-                                String path = FileSystem.denormalizePath(c.readString());
-                                long size = c.read64();
-                                byte[] data = c.getBuffer((int)size);
-                                try
-                                {
-                                    if(writefile != null)
-                                    {
-                                        writefile.write(data);
-                                        c.respondEmpty();
-                                    }
-                                    else
-                                    {
-                                        RandomAccessFile raf = new RandomAccessFile(path, "rw");
-                                        raf.write(data);
-                                        raf.close();
-                                        c.respondEmpty();
-                                    }
-                                }
-                                catch(Exception e)
-                                {
-                                    c.respondFailure(0xDEAD);
-                                }
-                                break;
-                            }
-                            case EndFile:
-                            {
-                                int mode = c.read32();
-                                if(mode == 1)
-                                {
-                                    if(readfile != null)
-                                    {
-                                        readfile.close();
-                                        readfile = null;
-                                    }
-                                }
-                                else
-                                {
-                                    if(writefile != null)
-                                    {
-                                        writefile.close();
-                                        writefile = null;
-                                    }
-                                }
-                                c.respondEmpty();
-
-                                break;
-                            }
-                            case Create:
-                            {
-                                int type = c.read32();
-                                String path = FileSystem.denormalizePath(c.readString());
-                                try
-                                {
-                                    if(type == 1) new File(path).createNewFile();
-                                    else if(type == 2) new File(path).mkdir();
-                                    c.respondEmpty();
-                                }
-                                catch(Exception e)
-                                {
-                                    c.respondFailure(0xDEAD);
-                                }
-                                break;
-                            }
-                            case Delete:
-                            {
-                                int type = c.read32();
-                                String path = FileSystem.denormalizePath(c.readString());
-                                try
-                                {
-                                    if((type == 1) || (type == 2)) FileSystem.deletePath(new File(path));
-                                    c.respondEmpty();
-                                }
-                                catch(Exception e)
-                                {
-                                    c.respondFailure(0xDEAD);
-                                }
-                                break;
-                            }
-                            case Rename:
-                            {
-                                int type = c.read32();
-                                String path = FileSystem.denormalizePath(c.readString());
-                                String newpath = FileSystem.denormalizePath(c.readString());
-                                if((type != 1) && (type != 2)) c.respondFailure(0xDEAD);
-                                else
-                                {
-                                    try
-                                    {
-                                        File p = new File(path);
-                                        p.renameTo(new File(p.getParent(), newpath));
-                                        c.respondEmpty();
-                                    }
-                                    catch(Exception e)
-                                    {
-                                        c.respondFailure(0xDEAD);
-                                    }
-                                }
-                                break;
-                            }
-                            case GetSpecialPathCount:
-                            {
-                                c.responseStart();
-                                synchronized(cfglock)
-                                {
-                                    c.write32(cfg.data.size());
-                                }
-                                c.responseEnd();
-                                break;
-                            }
-                            case GetSpecialPath:
-                            {
-                                int idx = c.read32();
-                                synchronized(cfglock)
-                                {
-                                    if(idx < cfg.data.size())
-                                    {
-                                        int tmpidx = 0;
-                                        Enumeration<?> enums = cfg.data.propertyNames();
-                                        while(enums.hasMoreElements())
-                                        {
-                                            String key = (String)enums.nextElement();
-                                            String value = cfg.data.getProperty(key);
-                                            if(tmpidx == idx)
-                                            {
-                                                c.responseStart();
-                                                c.writeString(key);
-                                                c.writeString(FileSystem.normalizePath(value));
-                                                c.responseEnd();
-                                                break;
-                                            }
-                                            tmpidx++;
-                                        }
-                                    }
-                                    else c.respondFailure(0xDEAD);
-                                }
-                                break;
-                            }
-                            case SelectFile:
-                            {
-                                selected = false;
-                                Platform.runLater(() ->
-                                {
-                                    synchronized(selectlock)
-                                    {
-                                        File tmpfile = new FileChooser().showOpenDialog(primaryStage);
-                                        if(tmpfile != null) selectedfile = tmpfile.toString();
-                                        selected = true;
-                                    }
-                                });
-                                while(true)
-                                {
-                                    synchronized(selectlock)
-                                    {
-                                        if(selected) break;
-                                    }
-                                }
-                                if(selectedfile != null)
-                                {
-                                    c.responseStart();
-                                    c.writeString(FileSystem.normalizePath(selectedfile));
-                                    c.responseEnd();
-                                }
-                                else c.respondFailure(0xDEAD);
-                                break;
-                            }
-                            default:
-                            {
-                                Logging.log("Unknown Id: " + cmdid);
-                                break;
-                            }
-                        }
+                        processCommand(c);
                     }
                 }
                 die();
@@ -47,7 +47,15 @@ public class Command
         Rename(14),
         GetSpecialPathCount(15),
         GetSpecialPath(16),
-        SelectFile(17);
+        SelectFile(17),
+        ListDirectory(18),
+        StreamFile(19),
+        StreamCredit(20),
+        StreamCancel(21),
+        Hello(22),
+        Echo(23),
+        Sink(24),
+        Source(25);
 
         private int id;
 
@@ -79,6 +87,20 @@ public class Command
 
     public static final int BlockSize = 0x1000;
 
+    // Revision of the command set, exchanged with Hello
+    public static final int ProtocolVersion = 2;
+    public static final int MaxPayloadSize = 0x1000000;
+    public static final long PreferredTransferSize = 0x800000;
+
+    // Optional parts of the protocol, only used when both ends support them
+    public static final int FeatureBulkListing = 1 << 0;
+    public static final int FeatureStreaming = 1 << 1;
+    public static final int FeatureCompression = 1 << 2;
+    public static final int FeatureHandles = 1 << 3; // Reserved, not used yet
+    public static final int FeatureControlInterface = 1 << 4; // Only offered when the control interface could be claimed
+    public static final int FeatureBenchmark = 1 << 5; // Echo, Sink, Source
+    public static final int SupportedFeatures = FeatureBulkListing | FeatureStreaming | FeatureCompression | FeatureControlInterface | FeatureBenchmark;
+
     public static final int GLCI = 0x49434C47;
     public static final int GLCO = 0x4F434C47;
 
@@ -155,6 +177,23 @@ public class Command
         usbInterface.writeBytes(resp_block);
     }
 
+    // Sent before every pushed block of a stream: a regular response block with the size of the block
+    // If Goldleaf accepts compressed payloads, followed by the encoding and the size on the wire
+    public static boolean sendStreamBlockHeader(USBInterface intf, int result, long size, int codecs, int encoding, long wiresize)
+    {
+        byte[] block = new byte[BlockSize];
+        Buffer buf = new Buffer(block);
+        buf.write32(GLCO);
+        buf.write32(result);
+        buf.write64(size);
+        if(codecs != 0)
+        {
+            buf.write32(encoding);
+            buf.write64(wiresize);
+        }
+        return intf.writeBytes(block);
+    }
+
     public void respondFailure(int result)
     {
         resp_buf.write32(GLCO);
@@ -0,0 +1,70 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright (C) 2018-2020  XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+package xorTroll.goldleaf.quark.usb;
+
+import java.util.Arrays;
+
+import com.github.luben.zstd.Zstd;
+
+public class Compression
+{
+    public static final int EncodingRaw = 0;
+    public static final int EncodingZstd = 1;
+
+    // Encodings Quark supports, as reported to Goldleaf
+    public static final int CodecZstd = 1;
+
+    private static final int Level = 1;
+    private static final int ProbeSize = 0x10000;
+
+    private static boolean isWorthIt(int compressed, int raw)
+    {
+        // Anything that doesn't save at least 1/8 isn't worth the decompression on the console
+        return compressed < (raw - (raw / 8));
+    }
+
+    // Returns null if the data doesn't compress well, in which case it's sent raw
+    // The start is tried first, so that data which won't compress (like encrypted NCAs) is detected right away
+    public static byte[] compress(byte[] data)
+    {
+        try
+        {
+            int probesize = Math.min(data.length, ProbeSize);
+            byte[] probe = Zstd.compress(Arrays.copyOf(data, probesize), Level);
+            if(!isWorthIt(probe.length, probesize)) return null;
+            byte[] compressed = Zstd.compress(data, Level);
+            if(!isWorthIt(compressed.length, data.length)) return null;
+            return compressed;
+        }
+        catch(Exception e)
+        {
+            return null;
+        }
+    }
+
+    public static byte[] decompress(byte[] data, int size)
+    {
+        byte[] decompressed = Zstd.decompress(data, size);
+        if(decompressed.length != size) throw new RuntimeException("Bad decompressed size");
+        return decompressed;
+    }
+}
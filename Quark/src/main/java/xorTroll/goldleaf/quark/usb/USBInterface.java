@@ -39,12 +39,22 @@ public class USBInterface
     public int usbInterface;
     public boolean isDevVersion;
     public Version productVersion;
+    public byte writeEndpoint;
+    public byte readEndpoint;
+    // Siblings share the device handle, only the interface which opened it closes it
+    private boolean ownsHandle;
+    // Reads on siblings give up every so often to check whether they got stopped, so that their thread can be joined before the handle is closed
+    private int readTimeout;
+    private volatile boolean stopped;
+
+    private static final int SiblingReadTimeout = 500; // ms
 
     public static final short VendorId = 0x057E;
     public static final short ProductId = 0x3000;
 
-    public static final byte WriteEndpoint = (byte)0x1;
-    public static final byte ReadEndpoint = (byte)0x81;
+    // Payloads (and every command for older Goldleaf versions) go through the data interface, other commands through the control one
+    public static final int DataInterface = 0;
+    public static final int ControlInterface = 1;
 
     private USBInterface(int iface)
     {
@@ -52,13 +62,64 @@ public class USBInterface
         usbContext = new Context();
         usbDeviceHandle = null;
         usbDevice = null;
+        writeEndpoint = (byte)(iface + 1);
+        readEndpoint = (byte)(0x80 | (iface + 1));
+        ownsHandle = true;
+        readTimeout = 0;
+        stopped = false;
+    }
+
+    private USBInterface(int iface, USBInterface parent)
+    {
+        usbInterface = iface;
+        usbContext = parent.usbContext;
+        usbDevice = parent.usbDevice;
+        usbDeviceHandle = parent.usbDeviceHandle;
+        isDevVersion = parent.isDevVersion;
+        productVersion = parent.productVersion;
+        writeEndpoint = (byte)(iface + 1);
+        readEndpoint = (byte)(0x80 | (iface + 1));
+        ownsHandle = false;
+        readTimeout = SiblingReadTimeout;
+        stopped = false;
+    }
+
+    // Endpoint addresses as the device describes them, in case they aren't the usual ones
+    private void findEndpoints()
+    {
+        ConfigDescriptor cfg = new ConfigDescriptor();
+        if(LibUsb.getActiveConfigDescriptor(this.usbDevice, cfg) != LibUsb.SUCCESS) return;
+        try
+        {
+            for(Interface iface: cfg.iface())
+            {
+                for(InterfaceDescriptor alt: iface.altsetting())
+                {
+                    if(alt.bInterfaceNumber() != this.usbInterface) continue;
+                    for(EndpointDescriptor ep: alt.endpoint())
+                    {
+                        byte addr = ep.bEndpointAddress();
+                        if((addr & LibUsb.ENDPOINT_IN) != 0) this.readEndpoint = addr;
+                        else this.writeEndpoint = addr;
+                    }
+                }
+            }
+        }
+        finally
+        {
+            LibUsb.freeConfigDescriptor(cfg);
+        }
     }
 
     public synchronized byte[] readBytes(int length)
     {
         ByteBuffer buf = ByteBuffer.allocateDirect(length);
         IntBuffer outlen = IntBuffer.allocate(1);
-        int res = LibUsb.bulkTransfer(this.usbDeviceHandle, ReadEndpoint, buf, outlen, 0);
+        int res;
+        do
+        {
+            res = LibUsb.bulkTransfer(this.usbDeviceHandle, this.readEndpoint, buf, outlen, this.readTimeout);
+        } while((res == LibUsb.ERROR_TIMEOUT) && !this.stopped);
         if(res == LibUsb.SUCCESS)
         {
             int gotlen = outlen.get();
@@ -77,11 +138,40 @@ public class USBInterface
         ByteBuffer buf = ByteBuffer.allocateDirect(data.length);
         buf.put(data);
         IntBuffer outlen = IntBuffer.allocate(1);
-        int res = LibUsb.bulkTransfer(this.usbDeviceHandle, WriteEndpoint, buf, outlen, 0);
+        int res = LibUsb.bulkTransfer(this.usbDeviceHandle, this.writeEndpoint, buf, outlen, 0);
         if(res == LibUsb.SUCCESS) return (outlen.get() == data.length);
         return false;
     }
 
+    // Used by the benchmark: one buffer is reused for every transfer and the data is never looked at
+    public synchronized boolean sinkBytes(long total, int chunk)
+    {
+        ByteBuffer buf = ByteBuffer.allocateDirect(chunk);
+        IntBuffer outlen = IntBuffer.allocate(1);
+        for(long done = 0; done < total; done += chunk)
+        {
+            buf.clear();
+            outlen.clear();
+            int res = LibUsb.bulkTransfer(this.usbDeviceHandle, this.readEndpoint, buf, outlen, 0);
+            if((res != LibUsb.SUCCESS) || (outlen.get() != chunk)) return false;
+        }
+        return true;
+    }
+
+    public synchronized boolean sourceBytes(long total, int chunk)
+    {
+        ByteBuffer buf = ByteBuffer.allocateDirect(chunk);
+        IntBuffer outlen = IntBuffer.allocate(1);
+        for(long done = 0; done < total; done += chunk)
+        {
+            buf.clear();
+            outlen.clear();
+            int res = LibUsb.bulkTransfer(this.usbDeviceHandle, this.writeEndpoint, buf, outlen, 0);
+            if((res != LibUsb.SUCCESS) || (outlen.get() != chunk)) return false;
+        }
+        return true;
+    }
+
     public static Optional<USBInterface> createInterface(int iface)
     {
         USBInterface intf = new USBInterface(iface);
@@ -154,7 +244,11 @@ public class USBInterface
                             }
 
                             res = LibUsb.claimInterface(intf.usbDeviceHandle, intf.usbInterface);
-                            if(res == LibUsb.SUCCESS) return Optional.of(intf);
+                            if(res == LibUsb.SUCCESS)
+                            {
+                                intf.findEndpoints();
+                                return Optional.of(intf);
+                            }
                         }
                     }
                 }
@@ -163,13 +257,38 @@ public class USBInterface
         return Optional.empty();
     }
 
+    // Another interface of the same device, which fails with Goldleaf versions exposing a single one
+    public Optional<USBInterface> openSibling(int iface)
+    {
+        USBInterface intf = new USBInterface(iface, this);
+        int res = LibUsb.claimInterface(intf.usbDeviceHandle, intf.usbInterface);
+        if(res == LibUsb.SUCCESS)
+        {
+            intf.findEndpoints();
+            return Optional.of(intf);
+        }
+        // Nothing to release when it's collected
+        intf.usbDeviceHandle = null;
+        return Optional.empty();
+    }
+
+    // Pending and further reads fail (within SiblingReadTimeout for siblings), the handle stays open until finalize()
+    public void stop()
+    {
+        this.stopped = true;
+    }
+
     public void finalize()
     {
         if(this.usbDeviceHandle != null)
         {
             LibUsb.releaseInterface(this.usbDeviceHandle, this.usbInterface);
-            LibUsb.close(this.usbDeviceHandle);
-            LibUsb.exit(this.usbContext);
+            if(this.ownsHandle)
+            {
+                LibUsb.close(this.usbDeviceHandle);
+                LibUsb.exit(this.usbContext);
+            }
+            this.usbDeviceHandle = null;
         }
     }
 }
\ No newline at end of file